@@ -20,11 +20,6 @@
 
 #include "globals.h"
 
-/**
-* An array of input ports that are requesting the output port under arbitration.
-*/
-static bool_t * candidates;
-
 /**
 * Used when in_transit_priority is ON. It limits how often an injection port is assigned to an output port.
 * When using timeout-based congestion detection ipr_l[0] is the value of ipr when the router is not congested and
@@ -41,7 +36,6 @@ port_type last_port_arb_con;
 * Initialization of the structures needed to perform arbitration.
 */
 void arbitrate_init(void) {
-	candidates = alloc(sizeof(bool_t) * n_ports);
 	ipr_l[1] = (long) (intransit_pr * RAND_MAX);
 
 	if (timeout_upper_limit>0)
@@ -56,9 +50,79 @@ void arbitrate_init(void) {
 }
 
 void arbitrate_finish(void) {
+}
 
-    free(candidates);
+/**
+* Gets the time of the request of an input port for an output port.
+*
+* @param i The node in which the arbitration is performed.
+* @param d_p The requested output port.
+* @param s_p The input port.
+* @return The time of the request, or 0 if s_p has not requested d_p in this cycle.
+*/
+static CLOCK_TYPE request_time(long i, port_type d_p, port_type s_p) {
+	port *o = &network[i].p[d_p];
+
+	if (o->req_gen != network[i].req_gen ||
+			!(o->reqm[s_p / WORD_BITS] & (1UL << (s_p % WORD_BITS))))
+		return 0;
+	return o->req[s_p];
 }
+
+/**
+* Looks for the next input port requesting an output port in this cycle.
+*
+* @param i The node in which the arbitration is performed.
+* @param d_p The requested output port.
+* @param s_p The first input port to look at.
+* @param last The next port after the range to look at.
+* @return The first requesting port in [s_p, last), or NULL_PORT if there is none.
+*/
+static port_type next_request(long i, port_type d_p, port_type s_p, port_type last) {
+	port *o = &network[i].p[d_p];
+	long k;
+	unsigned long w;
+
+	if (s_p >= last || o->req_gen != network[i].req_gen)
+		return NULL_PORT;	// Empty range or requests from older cycles.
+	k = s_p / WORD_BITS;
+	w = o->reqm[k] & (~0UL << (s_p % WORD_BITS));
+	while (!w) {
+		if ((port_type)(++k * WORD_BITS) >= last)
+			return NULL_PORT;
+		w = o->reqm[k];
+	}
+	s_p = (k * WORD_BITS) + __builtin_ctzl(w);
+	return (s_p < last) ? s_p : NULL_PORT;
+}
+
+/**
+* Counts the input ports requesting an output port in this cycle.
+*
+* @param i The node in which the arbitration is performed.
+* @param d_p The requested output port.
+* @param first The first port of the range.
+* @param last The next port after the range.
+* @return The number of requesting ports in [first, last).
+*/
+static long count_requests(long i, port_type d_p, port_type first, port_type last) {
+	port *o = &network[i].p[d_p];
+	long k, n = 0;
+	unsigned long w;
+
+	if (first >= last || o->req_gen != network[i].req_gen)
+		return 0;
+	for (k = first / WORD_BITS; (port_type)(k * WORD_BITS) < last; k++) {
+		w = o->reqm[k];
+		if (k == first / WORD_BITS)
+			w &= ~0UL << (first % WORD_BITS);
+		if ((port_type)((k + 1) * WORD_BITS) > last)
+			w &= ~(~0UL << (last % WORD_BITS));
+		n += __builtin_popcountl(w);
+	}
+	return n;
+}
+
 /**
 * Tries to reserve an output port.
 *
@@ -68,9 +132,9 @@ void arbitrate_finish(void) {
 * @param s_p The source port which is reserving.
 */
 void reserve(long i, port_type d_p, port_type s_p) {
-	network[i].p[s_p].aop = d_p;				// Annotation at input port
-	network[i].p[s_p].bet = B_TRIAL_0;		// Success reserving!! Reset my next bet
-	network[i].p[d_p].sip = s_p;				// Annotation of source input port
+	network[i].aop[s_p] = d_p;				// Annotation at input port
+	network[i].bet[s_p] = B_TRIAL_0;		// Success reserving!! Reset my next bet
+	network[i].sip[d_p] = s_p;				// Annotation of source input port
 	network[i].p[d_p].ri = s_p;				// Annotation of last used input
 }
 
@@ -94,18 +158,16 @@ void arbitrate_cons_single(long i) {
 void arbitrate_cons_multiple(long i) {
 	port_type s_p;
 
-	for (s_p=0; s_p<last_port_arb_con; s_p++) {
-		if (network[i].p[p_con].req[s_p]) {
-			// Has input port "s_p" requested consumption port?
-			if (!queue_len(&network[i].p[s_p].q))
-			{
-				printf("node %ld, p_con %ld, s_p %ld\n",i,p_con,s_p);
-				panic("Trying to assign consumption port to empty input queue - multiple");
-			}
-			network[i].p[s_p].aop = p_con;
-			network[i].p[s_p].bet = B_TRIAL_0; // Success reserving!! Reset my next bet -- Only for adaptive
-			continue;
+	// Input ports that have requested the consumption port.
+	for (s_p=next_request(i, p_con, 0, last_port_arb_con); s_p!=NULL_PORT;
+			s_p=next_request(i, p_con, s_p+1, last_port_arb_con)) {
+		if (!queue_len(&network[i].p[s_p].q))
+		{
+			printf("node %ld, p_con %ld, s_p %ld\n",i,p_con,s_p);
+			panic("Trying to assign consumption port to empty input queue - multiple");
 		}
+		network[i].aop[s_p] = p_con;
+		network[i].bet[s_p] = B_TRIAL_0; // Success reserving!! Reset my next bet -- Only for adaptive
 	}
 }
 
@@ -135,12 +197,12 @@ void arbitrate_cons_multiple(long i) {
 void arbitrate_direct(long i, port_type d_p) {
 	port_type s_p, firstlimit, lastlimit;
 
-	if (network[i].p[d_p].sip != P_NULL)
+	if (network[i].sip[d_p] != P_NULL)
 		return;  // Cannot arbitrate twice
 
 	firstlimit = 0;
 
-	if (ipr_l[network[i].congested] && (rand() <= ipr_l[network[i].congested]))
+	if (network[i].pcount && ipr_l[network[i].congested] && (sim_rand() <= ipr_l[network[i].congested]))
 		lastlimit = p_inj_first;	// If priority is ON for in_transit traffic, injection ports
 									// are not included in the arbitration process
 	else
@@ -178,7 +240,7 @@ void arbitrate_direct(long i, port_type d_p) {
 void arbitrate_icube(long i, port_type d_p) {
 	port_type s_p, firstlimit, lastlimit;
 
-	if (network[i].p[d_p].sip != P_NULL)
+	if (network[i].sip[d_p] != P_NULL)
 		return;  // Cannot arbitrate twice
 
 	if (i<nprocs)   // In a leaf node
@@ -196,7 +258,7 @@ void arbitrate_icube(long i, port_type d_p) {
 		else return; //Should not be checking this
 	}
 	else    // switches do not have injection ports.
-		if (ipr_l[network[i].congested] && (rand() <= ipr_l[network[i].congested])) // Checking IPR...
+		if (network[i].pcount && ipr_l[network[i].congested] && (sim_rand() <= ipr_l[network[i].congested])) // Checking IPR...
 		{
 			firstlimit=nodes_per_switch*nchan;
 			lastlimit=p_inj_first;
@@ -239,7 +301,7 @@ void arbitrate_icube(long i, port_type d_p) {
 void arbitrate_arbitrary (long i, port_type d_p) {
 	port_type s_p, firstlimit, lastlimit;
 
-	if (network[i].p[d_p].sip != P_NULL)
+	if (network[i].sip[d_p] != P_NULL)
 		return;  // Cannot arbitrate twice
 
 	if (i<nprocs)   // In a leaf node.
@@ -258,7 +320,7 @@ void arbitrate_arbitrary (long i, port_type d_p) {
 	else    // switches do not have injection ports.
 	{
 		lastlimit = p_inj_first;
-		if (ipr_l[network[i].congested] && (rand() <= ipr_l[network[i].congested]))
+		if (network[i].pcount && ipr_l[network[i].congested] && (sim_rand() <= ipr_l[network[i].congested]))
 			firstlimit = stDown * nchan;	// If priority is ON for in_transit traffic, ports connected to servers
 											// are not included in the arbitration process
 		else
@@ -277,7 +339,7 @@ void arbitrate_arbitrary (long i, port_type d_p) {
 * Select the port that requested the port first of all the given ports.
 *
 * Given a range of input-injection ports, select the one that requested the output port first
-* Time of request is stored in network[i].p[d_p].req[s_p].
+* Time of request is stored in network[i].p[d_p].req[s_p], for the ports set in network[i].p[d_p].reqm.
 *
 * @param i The node in which the arbitration is performed.
 * @param d_p The destination port for wich the arbitration is performed.
@@ -294,13 +356,11 @@ port_type arbitrate_select_fifo(long i, port_type d_p, port_type first, port_typ
 
 	time_of_selected = CLOCK_MAX;
 
-	for (s_p=first; s_p<last; s_p++) {
+	for (s_p=next_request(i, d_p, first, last); s_p!=NULL_PORT; s_p=next_request(i, d_p, s_p+1, last)) {
 		min = network[i].p[d_p].req[s_p];
-		if (min!=0) {
-			if (min < time_of_selected) {
-				time_of_selected = min;
-				selected_port = s_p;
-			}
+		if (min < time_of_selected) {
+			time_of_selected = min;
+			selected_port = s_p;
 		}
 	}
 
@@ -328,7 +388,7 @@ port_type arbitrate_select_fifo(long i, port_type d_p, port_type first, port_typ
 * @see arbitrate_select
 */
 port_type arbitrate_select_longest(long i, port_type d_p, port_type first, port_type last) {
-	port_type s_p, selected_port=NULL_PORT, visited;
+	port_type s_p, selected_port=NULL_PORT, visited, start, end;
 	long len_of_selected, pl;
 	long dif=last-first;
 
@@ -336,8 +396,25 @@ port_type arbitrate_select_longest(long i, port_type d_p, port_type first, port_
 	if (s_p >= last) s_p = first;
 	len_of_selected = -1;
 
-	for (visited=first; visited<last; visited++) {
-		if (network[i].p[d_p].req[s_p]) {
+	if (first % dif == 0) {
+		// The visiting order is a rotation of the range: the requesting ports from s_p
+		// to the end of the range, then the ones from the beginning.
+		start = s_p;
+		end = last;
+		for (visited=0; visited<2; visited++) {
+			for (s_p=next_request(i, d_p, start, end); s_p!=NULL_PORT; s_p=next_request(i, d_p, s_p+1, end)) {
+				pl = queue_len(&network[i].p[s_p].q);
+				if (pl > len_of_selected) {
+					len_of_selected = pl;
+					selected_port = s_p;
+				}
+			}
+			end = start;
+			start = first;
+		}
+	}
+	else for (visited=first; visited<last; visited++) {
+		if (request_time(i, d_p, s_p)) {
 			pl = queue_len(&network[i].p[s_p].q);
 			if (pl > len_of_selected) {
 				len_of_selected = pl;
@@ -378,8 +455,10 @@ port_type arbitrate_select_highest(long i, port_type d_p, port_type first, port_
 		s_p = first;
 	cv_of_selected = -1;
 
+	if (next_request(i, d_p, 0, p_con+1) == NULL_PORT)
+		return(NULL_PORT);
 	for (visited=first; visited<last; visited++) {
-		if (network[i].p[d_p].req[s_p]) {
+		if (request_time(i, d_p, s_p)) {
 			pl = s_p%nchan;
 			if (pl > cv_of_selected) {
 				cv_of_selected = pl;
@@ -410,12 +489,20 @@ port_type arbitrate_select_highest(long i, port_type d_p, port_type first, port_
 * @see arbitrate_select
 */
 port_type arbitrate_select_round_robin(long i, port_type d_p, port_type first, port_type last) {
-	port_type s_p, visited;
+	port_type s_p, visited, selected_port;
 	long dif=last - first;
 	s_p = first + ((network[i].p[d_p].ri + 1) % dif);
 	if (s_p >= last) s_p = first;
+	if (first % dif == 0) {
+		// The visiting order is a rotation of the range: the first requesting port
+		// from s_p on, or else the first one of the range.
+		selected_port = next_request(i, d_p, s_p, last);
+		if (selected_port == NULL_PORT)
+			selected_port = next_request(i, d_p, first, s_p);
+		return(selected_port);
+	}
 	for (visited=first; visited<last; visited++) {
-		if (network[i].p[d_p].req[s_p])
+		if (request_time(i, d_p, s_p))
 			return(s_p);
 		s_p = first + ((s_p + 1) % dif);
 		if (s_p >= last) s_p = first;
@@ -440,22 +527,14 @@ port_type arbitrate_select_random(long i, port_type d_p, port_type first, port_t
 	long rp, ncand;
 
 	// First we calculate the number of input ports requesting this output
-	ncand = 0;
-	for(s_p=first; s_p<last; s_p++) {
-		if (!network[i].p[d_p].req[s_p])
-			candidates[s_p] = B_FALSE; // s_p is not requesting
-		else {
-			candidates[s_p] = B_TRUE;
-			ncand++;
-		}
-	}
+	ncand = count_requests(i, d_p, first, last);
+	if (ncand == 0)
+		return(NULL_PORT);	// No dice thrown: an idle router leaves its random stream untouched
 	// Now throw the dice and select the lucky one
 	rp = ztm(ncand);
- 	for (s_p=first; s_p<last; s_p++) {
-		if (!candidates[s_p]) continue;
+	for (s_p=next_request(i, d_p, first, last); s_p!=NULL_PORT; s_p=next_request(i, d_p, s_p+1, last))
 		if (rp-- == 0)
 			return(s_p);
-	}
 	return(NULL_PORT);
 }
 
@@ -473,15 +552,13 @@ port_type arbitrate_select_random(long i, port_type d_p, port_type first, port_t
 * @see arbitrate
 */
 port_type arbitrate_select_age(long i, port_type d_p, port_type first, port_type last) {
-	port_type s_p, selected_port;
+	port_type s_p, selected_port=NULL_PORT;
 	CLOCK_TYPE time_of_selected, min;
 	phit *p;
 
 	time_of_selected = CLOCK_MAX;
 
-	for (s_p=first; s_p<last; s_p++) {
-		if (!network[i].p[d_p].req[s_p])
-			continue;
+	for (s_p=next_request(i, d_p, first, last); s_p!=NULL_PORT; s_p=next_request(i, d_p, s_p+1, last)) {
 		p = head_queue(&network[i].p[s_p].q);
 		min = pkt_space[p->packet].inj_time;
 		if (min < time_of_selected) {
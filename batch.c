@@ -23,7 +23,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "globals.h"
 
 /** Current Consumed Load. */
-double cons_load;
+extern double cons_load;
 
 /** Current Average Latency. */
 double latency;
@@ -146,6 +146,7 @@ void warm_up(void){
 			global_q_u = global_q_u_current;
 			global_q_u_current = injected_count - rcvd_count - transit_dropped_count;
 		}
+		checkpoint_cycle();
 	}
 }
 
@@ -178,12 +179,13 @@ bool_t system_converges(void){
 * than #max_conv_time cycles without reach the stationary state.
 * A message stating the reason of leaving this phase is printed.
 *
+* #go_on is TRUE while estimating, and it is FALSE while adjusting the clock for the
+* samples, so the phase can be resumed from a checkpoint.
+*
 * @see system_converges()
 * @see run_network_batch()
 */
 void convergency(void){
-	long converged=B_FALSE;
-	go_on=B_TRUE;
 	while (go_on && !interrupted  && !aborted){
 		data_movement(B_TRUE);
 		sim_clock++;
@@ -195,10 +197,8 @@ void convergency(void){
 			else
 				convergence=0;
 
-			if (convergence==3){
+			if (convergence==3)
 				go_on=B_FALSE;
-				converged=B_TRUE;
-			}
 			prev_cons_load = cons_load;
 			prev_latency = latency;
 			reset_stats();
@@ -209,6 +209,7 @@ void convergency(void){
 		}
 		if (sim_clock - warm_up_period >= max_conv_time)
 			go_on=B_FALSE;
+		checkpoint_cycle();
 	}
 
 	// Adjust for equal sample adquiring
@@ -222,13 +223,15 @@ void convergency(void){
 			global_q_u = global_q_u_current;
 			global_q_u_current = injected_count - rcvd_count - transit_dropped_count;
 		}
+		checkpoint_cycle();
 	}
 	warmed_up = sim_clock;
 	reseted=-1;
 	reset_stats();
+	go_on=B_TRUE;
 
     if (!interrupted && !aborted){
-        if (converged){
+        if (convergence==3){
             printf("\n ---------------------------------------------\n");
             printf("                Warmed Up !!!!!!               \n");
             printf(" ---------------------------------------------\n\n");
@@ -251,7 +254,6 @@ void convergency(void){
 * @see run_network_batch()
 */
 void stationary(void){
-	go_on=B_TRUE;
 	while (go_on && !interrupted  && !aborted){
 		data_movement(B_TRUE);
 		sim_clock++;
@@ -272,6 +274,7 @@ void stationary(void){
 			if (reseted == samples)
 				go_on=B_FALSE;
 		}
+		checkpoint_cycle();
 	}
 }
 
@@ -281,16 +284,40 @@ void stationary(void){
 * The simulation are split in three phases:
 * Warm-up, Convergency assurement & Stationary state.
 *
+* When resuming from a checkpoint, the phases already done are skipped. Unless there is a
+* #checkpoint_period, a snapshot is taken at the end of the warm-up.
+*
 * @see warm_up()
 * @see convergency()
 * @see stationary()
 */
 void run_network_batch(void){
+	if (restore_file[0] != '\0')
+		restore_checkpoint();
 	warm_up();
-	convergency();
+	if (checkpoint_period == 0 && sim_clock == warm_up_period)
+		take_checkpoint();
+	if (!warmed_up)
+		convergency();
 	stationary();
 }
 
+/**
+* Writes the state of the convergency and the batches taken in a checkpoint, or reads them.
+*
+* @param f The checkpoint.
+* @param save TRUE to write them, FALSE to read them.
+*/
+void batch_checkpoint(FILE *f, bool_t save){
+	ckp_var(f, convergence, save);
+	ckp_var(f, prev_cons_load, save);
+	ckp_var(f, prev_latency, save);
+	if (reseted > samples)
+		panic("Checkpoint taken with more samples");
+	if (reseted > 0)
+		ckp_data(f, batch, sizeof(batch_t) * reseted, save);
+}
+
 /**
 * Run the simulation in shotmode.
 *
@@ -310,7 +337,9 @@ void run_network_shotmode(void) {
 				global_q_u = global_q_u_current;
 				global_q_u_current = injected_count - rcvd_count - transit_dropped_count;
 			}
+			prof_phase(PROF_GENERATION);
 			datagen_oneshot(B_FALSE);
+			prof_phase(PROF_INJECTION);
 			for (i=0; i<nprocs; i++) data_injection(i);
 			data_movement(B_FALSE);
 			sim_clock++;
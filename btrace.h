@@ -0,0 +1,71 @@
+/**
+* @file
+* @brief	Definition of the FSIN binary trace format.
+*
+* A binary trace holds the events of a trc, dimemas or alog trace already parsed and grouped
+* by task, so the simulator maps it in memory and takes the events of each task straight from
+* it, when they are needed. The file contains:
+* - A #btr_header.
+* - The index: ntasks+1 int64_t with the position of the first record of each task. The last
+*   one is the number of records.
+* - The records (#btr_record). The records of a task keep the order of the original trace.
+*
+* All the fields are written in the byte order of the machine, which is checked with
+* #btr_header.order. Traces are converted to this format with tools/trc2bin.
+
+FSIN Functional Simulator of Interconnection Networks
+Copyright (2003-2011) J. Miguel-Alonso, J. Navaridas
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _btrace
+#define _btrace
+
+#include <stdint.h>
+
+#define BTR_MAGIC "FSINBTR"		///< First bytes of a binary trace (8, with the '\0').
+#define BTR_VERSION 2			///< Version of the format. Version 1 has no collectives.
+#define BTR_ORDER 0x0102030405060708LL	///< Written in #btr_header.order to check the byte order.
+#define BTR_UNITS_OPTION -1		///< The computations are in the units given by the cpu_units option.
+
+/**
+* Header of a binary trace.
+*/
+typedef struct btr_header {
+	char magic[8];		///< #BTR_MAGIC.
+	int64_t order;		///< #BTR_ORDER.
+	int32_t version;	///< #BTR_VERSION.
+	int32_t units;		///< Units of the computations: a cpu_units_t or #BTR_UNITS_OPTION.
+	int64_t ntasks;		///< Number of tasks.
+	int64_t nrecords;	///< Number of records.
+} btr_header;
+
+#define BTR_ALLREDUCE 'A'	///< Type of an allreduce record.
+#define BTR_ALLTOALL 'T'	///< Type of an alltoall record.
+#define BTR_BCAST 'B'		///< Type of a broadcast record.
+#define BTR_BARRIER 'W'		///< Type of a barrier record.
+
+/**
+* An event of a binary trace.
+*
+* Collectives involve all the tasks, and every task has its own record of each one.
+*/
+typedef struct btr_record {
+	int32_t type;	///< 'c' for computation, 's' for sending, 'r' for reception or a collective (BTR_ALLREDUCE...).
+	int32_t peer;	///< The other task: destination when sending, source when receiving. Root of a broadcast.
+	int64_t tag;	///< Tag of the message.
+	int64_t value;	///< Size of the message in bytes (sent to each task in an alltoall). Length of the computation.
+} btr_record;
+
+#endif /* _btrace */
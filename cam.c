@@ -18,46 +18,581 @@
  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <stdio.h>
+#include <string.h>
 #include "globals.h"
 #include "cam.h"
 #include "graph.h"
 
-void init_cams_rr(){
+#if (THREADS != 0)
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
-    long i, switch_id, size;
+#define CAM_ROUND 4	///< Switches taken by each thread in a round of fill_cams().
 
-    size = cam_policy_params[0];
+/**
+ * The paths found from a switch by a thread of fill_cams(), kept until they are set in the CAMs.
+ */
+typedef struct cam_found_t {
+    long diam;          ///< Distance to the farthest switch.
+    long n;             ///< Number of sets of paths.
+    long *n_paths;      ///< Number of paths in each set.
+    path_t ***paths;    ///< The sets of paths, one per destination, in the order they were found.
+} cam_found_t;
 
-    if(size <= 0)
-        size = 1;
+static THREAD_LOCAL cam_found_t *found = NULL; ///< Where a thread of fill_cams() keeps the paths it finds. NULL sets them in the CAMs at once.
 
-    for(switch_id = nprocs; switch_id < NUMNODES; switch_id++){
-        network[switch_id].cam = alloc(nswitches * sizeof(cam_t));
-        for(i = 0; i < nswitches; i++){
-            network[switch_id].cam[i].n_paths = 0; 
-            network[switch_id].cam[i].l_path = 0;
-            network[switch_id].cam[i].ports = alloc(size * sizeof(long*));
+/**
+ * The CAM table of a switch while it is being filled, before packing it in its cam_t.
+ *
+ * With static port selection, each pair of switches is set once, so the paths are just
+ * appended: for each destination, its number, the number of paths and their lengths
+ * in #rec, and the ports of the paths in #ports. With adaptive port selection there
+ * is room for #stUp ports to each destination, used in order, and #rec has the number
+ * of ports used.
+ */
+typedef struct cam_build_t {
+    uint32_t *rec;      ///< The destinations & paths, or the ports used to each destination.
+    long n_rec;         ///< Used length of #rec.
+    long cap_rec;       ///< Allocated length of #rec.
+    cam_port_t *ports;  ///< The ports.
+    long n_ports;       ///< Used length of #ports.
+    long cap_ports;     ///< Allocated length of #ports.
+    cam_port_t *dist;   ///< Distance through each port. Adaptive only.
+} cam_build_t;
+
+static cam_build_t *build;  ///< The CAM tables being filled, one per switch.
+
+/**
+ * Makes room in an array that grows.
+ *
+ * @param a The array.
+ * @param cap Its allocated length, updated.
+ * @param need The length needed.
+ * @param size The size of an element.
+ * @return The array, maybe moved.
+ */
+static void *grow(void *a, long *cap, long need, size_t size){
+
+    if(need <= *cap)
+        return a;
+    *cap = max(need, (2 * (*cap)) + 16);
+    if((a = realloc(a, *cap * size)) == NULL)
+        panic("grow: Unable to allocate memory");
+    return a;
+}
+
+/**
+ * Prepares the CAM tables of all the switches to be filled.
+ */
+static void start_build(){
+
+    long i, s;
+
+    build = alloc(nswitches * sizeof(cam_build_t));
+    for(s = 0; s < nswitches; s++){
+        build[s].rec = NULL;
+        build[s].n_rec = build[s].cap_rec = 0;
+        build[s].ports = NULL;
+        build[s].n_ports = build[s].cap_ports = 0;
+        build[s].dist = NULL;
+        if(cam_ports == CAM_ADAPTIVE){
+            build[s].rec = alloc(nswitches * sizeof(uint32_t));
+            build[s].ports = alloc(nswitches * stUp * sizeof(cam_port_t));
+            build[s].dist = alloc(nswitches * stUp * sizeof(cam_port_t));
+            for(i = 0; i < nswitches; i++)
+                build[s].rec[i] = 0;
         }
     }
 }
 
-void init_cams_adaptive(){
+/**
+ * Packs the CAM tables that have been filled, and frees what was used to fill them.
+ */
+static void pack_build(){
+
+    long i, j, s, d, n, e, q, len, *at, *port_at;
+    cam_build_t *b;
+    cam_t *c;
+
+    at = alloc(nswitches * sizeof(long));
+    port_at = alloc(nswitches * sizeof(long));
+    for(s = 0; s < nswitches; s++){
+        b = &build[s];
+        c = network[s + nprocs].cam;
+        c->dst = alloc((nswitches + 1) * sizeof(uint32_t));
+        e = 0;
+        if(cam_ports == CAM_ADAPTIVE){
+            for(d = 0; d < nswitches; d++)
+                e += b->rec[d];
+            c->ports = alloc(max(e, 1) * sizeof(cam_port_t));
+            c->dist = alloc(max(e, 1) * sizeof(cam_port_t));
+            e = 0;
+            for(d = 0; d < nswitches; d++){
+                c->dst[d] = e;
+                for(i = 0; i < (long)b->rec[d]; i++, e++){
+                    c->ports[e] = b->ports[(d * stUp) + i];
+                    c->dist[e] = b->dist[(d * stUp) + i];
+                }
+            }
+            c->dst[nswitches] = e;
+            free(b->dist);
+        }
+        else{
+            // Where the paths to each destination are in the records.
+            for(d = 0; d < nswitches; d++)
+                at[d] = -1;
+            for(i = 0, q = 0; i < b->n_rec; i += 2 + n){
+                d = b->rec[i];
+                n = b->rec[i + 1];
+                at[d] = i;
+                port_at[d] = q;
+                e += n;
+                for(j = 0; j < n; j++)
+                    q += b->rec[i + 2 + j];
+            }
+            c->hop = alloc((e + 1) * sizeof(uint32_t));
+            c->ports = alloc(max(b->n_ports, 1) * sizeof(cam_port_t));
+            e = 0;
+            q = 0;
+            for(d = 0; d < nswitches; d++){
+                c->dst[d] = e;
+                if(at[d] < 0)
+                    continue;
+                n = b->rec[at[d] + 1];
+                for(j = 0; j < n; j++){
+                    len = b->rec[at[d] + 2 + j];
+                    c->hop[e++] = q;
+                    memcpy(&c->ports[q], &b->ports[port_at[d]], len * sizeof(cam_port_t));
+                    port_at[d] += len;
+                    q += len;
+                }
+            }
+            c->dst[nswitches] = e;
+            c->hop[e] = q;
+        }
+        free(b->rec);
+        free(b->ports);
+    }
+    free(at);
+    free(port_at);
+    free(build);
+}
 
-    long i, switch_id, k;
+/**
+ * Records the diameter of the graph seen from a switch.
+ *
+ * @param diam The distance to the farthest switch.
+ */
+static void cam_diameter(long diam){
 
-    for(switch_id = nprocs; switch_id < NUMNODES; switch_id++){
-        network[switch_id].cam = alloc(nswitches * sizeof(cam_t));
-        for(i = 0; i < nswitches; i++){
-            network[switch_id].cam[i].n_paths = 0; 
-            network[switch_id].cam[i].l_path = 0;
-            network[switch_id].cam[i].ports = alloc( 2 * sizeof(long*));
-            network[switch_id].cam[i].ports[0] = alloc(stUp * sizeof(long));
-            network[switch_id].cam[i].ports[1] = alloc(stUp * sizeof(long));
-            for(k = 0; k < stUp; k++){
-                network[switch_id].cam[i].ports[0][k] = -1; // Next port
-                network[switch_id].cam[i].ports[1][k] = -1; // Distances
+    if(found != NULL)
+        found->diam = diam;
+    else if(diam > diameter_t)
+        diameter_t = diam;
+}
+
+/**
+ * Sets the paths from a switch to a destination in the CAMs of both ends.
+ *
+ * In a thread of fill_cams() they are copied instead, to be set later. Anyway,
+ * the paths still belong to the caller.
+ *
+ * @param k_paths The paths.
+ * @param n_paths The number of paths.
+ */
+static void cam_set_paths(path_t **k_paths, long n_paths){
+
+    long i;
+
+    if(found == NULL){
+        set_mpaths(k_paths, n_paths);
+        set_mpaths_reverse(k_paths, n_paths);
+        return;
+    }
+    found->n_paths[found->n] = n_paths;
+    found->paths[found->n] = alloc(n_paths * sizeof(path_t*));
+    for(i = 0; i < n_paths; i++)
+        found->paths[found->n][i] = copy_path(k_paths[i]);
+    found->n++;
+}
+
+#if (THREADS != 0)
+/**
+ * One of the threads of fill_cams().
+ */
+typedef struct cam_worker_t {
+    pthread_t th;       ///< The thread.
+    graph_t *graph;     ///< Its own graph, as finding the paths removes edges & nodes for a while.
+} cam_worker_t;
+
+static cam_found_t *round_found;    ///< The paths found from each switch of the round.
+static long round_first;            ///< First switch of the round.
+static long round_next;             ///< Next switch of the round to be taken by a thread.
+static long round_end;              ///< Switch after the last one of the round.
+static pthread_mutex_t round_lock = PTHREAD_MUTEX_INITIALIZER; ///< Protects #round_next.
+static pthread_barrier_t round_start;   ///< Waits for the round to be set.
+static pthread_barrier_t round_done;    ///< Waits for all the switches of the round to be done.
+static bool_t rounds_over;              ///< Tells the threads that there are no more rounds.
+
+/**
+ * Finds the paths from the switches of the round, taking them one by one until none is left.
+ *
+ * @param arg The cam_worker_t of the thread.
+ * @return NULL.
+ */
+static void *fill_round(void *arg){
+
+    cam_worker_t *w = arg;
+    long s;
+
+    for(;;){
+        pthread_mutex_lock(&round_lock);
+        s = round_next++;
+        pthread_mutex_unlock(&round_lock);
+        if(s >= round_end)
+            break;
+        found = &round_found[s - round_first];
+        fill_cam(s, w->graph);
+    }
+    found = NULL;
+    return NULL;
+}
+
+/**
+ * Main loop of the threads of fill_cams(), but the main one: a round each time it is set,
+ * until there are no more. Their scratch space is kept for all the rounds.
+ *
+ * @param arg The cam_worker_t of the thread.
+ * @return NULL.
+ */
+static void *run_rounds(void *arg){
+
+    for(;;){
+        pthread_barrier_wait(&round_start);
+        if(rounds_over)
+            break;
+        fill_round(arg);
+        pthread_barrier_wait(&round_done);
+    }
+    ksp_finish();
+    return NULL;
+}
+
+/**
+ * Sets in the CAMs the paths found from a switch by a thread, and frees them.
+ *
+ * @param f The paths found.
+ */
+static void merge_found(cam_found_t *f){
+
+    long i, j;
+
+    cam_diameter(f->diam);
+    for(i = 0; i < f->n; i++){
+        set_mpaths(f->paths[i], f->n_paths[i]);
+        set_mpaths_reverse(f->paths[i], f->n_paths[i]);
+        for(j = 0; j < f->n_paths[i]; j++)
+            destroy_path(f->paths[i][j]);
+        free(f->paths[i]);
+    }
+    f->n = 0;
+}
+#endif /* THREADS */
+
+/**
+ * Finds the paths between all the switches in the graph, and sets them in the CAMs.
+ *
+ * The paths from each switch are found by one of #cam_threads threads, in rounds of
+ * #CAM_ROUND switches per thread. The threads are started once and meet at a barrier at
+ * the start & end of each round. Each thread has its own copy of the graph, as Yen's
+ * algorithm removes edges & nodes from it for a while. At the end of each round, the
+ * paths are set in the CAMs in the order of the switches, so the tables are the same
+ * as when the switches are done one after another.
+ *
+ * @param graph The graph of the switches.
+ */
+static void find_cams(graph_t *graph){
+
+    long s;
+#if (THREADS != 0)
+    cam_worker_t *workers;
+    long nthreads, k;
+
+    nthreads = (cam_threads > 0) ? cam_threads : sysconf(_SC_NPROCESSORS_ONLN);
+    if(nthreads > nswitches)
+        nthreads = nswitches;
+    if(nthreads > 1){
+        workers = alloc(nthreads * sizeof(cam_worker_t));
+        workers[0].graph = graph;
+        for(k = 1; k < nthreads; k++)
+            workers[k].graph = copy_graph(graph);
+        round_found = alloc(nthreads * CAM_ROUND * sizeof(cam_found_t));
+        for(k = 0; k < nthreads * CAM_ROUND; k++){
+            round_found[k].n = 0;
+            round_found[k].n_paths = alloc(nswitches * sizeof(long));
+            round_found[k].paths = alloc(nswitches * sizeof(path_t**));
+        }
+
+        if(pthread_barrier_init(&round_start, NULL, nthreads) || pthread_barrier_init(&round_done, NULL, nthreads))
+            panic("Cannot create the barriers of the threads filling the CAMs");
+        rounds_over = B_FALSE;
+        for(k = 1; k < nthreads; k++)
+            if(pthread_create(&workers[k].th, NULL, run_rounds, &workers[k]))
+                panic("Cannot create the threads filling the CAMs");
+
+        for(round_first = nprocs; round_first < NUMNODES; round_first = round_end){
+            round_next = round_first;
+            round_end = min(round_first + (nthreads * CAM_ROUND), NUMNODES);
+            pthread_barrier_wait(&round_start);
+            fill_round(&workers[0]);
+            pthread_barrier_wait(&round_done);
+            for(s = round_first; s < round_end; s++)
+                merge_found(&round_found[s - round_first]);
+        }
+        rounds_over = B_TRUE;
+        pthread_barrier_wait(&round_start);
+        for(k = 1; k < nthreads; k++)
+            pthread_join(workers[k].th, NULL);
+        pthread_barrier_destroy(&round_start);
+        pthread_barrier_destroy(&round_done);
+        ksp_finish();
+
+        for(k = 0; k < nthreads * CAM_ROUND; k++){
+            free(round_found[k].n_paths);
+            free(round_found[k].paths);
+        }
+        free(round_found);
+        for(k = 1; k < nthreads; k++)
+            free_graph(workers[k].graph);
+        free(workers);
+        return;
+    }
+#endif /* THREADS */
+    for(s = nprocs; s < NUMNODES; s++)
+        fill_cam(s, graph);
+    ksp_finish();
+}
+
+/**
+ * Writes some data in the CAM cache, or reads them.
+ *
+ * @param f The cache.
+ * @param data The data.
+ * @param size The size of the data, in bytes.
+ * @param save TRUE to write the data, FALSE to read them.
+ * @return TRUE if done, FALSE if the cache ends before.
+ */
+static bool_t cache_data(FILE *f, void *data, size_t size, bool_t save){
+
+    if(size == 0)
+        return B_TRUE;
+    if(save){
+        if(fwrite(data, size, 1, f) != 1)
+            panic("Cannot write the CAM cache");
+        return B_TRUE;
+    }
+    return (fread(data, size, 1, f) == 1);
+}
+
+/**
+ * Writes the header of the CAM cache, or reads and checks it.
+ *
+ * The key holds all that the tables depend on: the graph itself (hashed, so the
+ * generated topologies are covered too), the nodes attached to it and the CAM policy
+ * with its parameters.
+ *
+ * @param f The cache.
+ * @param graph The graph of the switches.
+ * @param save TRUE to write the header, FALSE to read it.
+ * @return TRUE if written, or read and matching this network.
+ */
+static bool_t cache_header(FILE *f, graph_t *graph, bool_t save){
+
+    char magic[8];
+    unsigned long hash;
+    long key[CAM_CACHE_KEYS], k = 0, i, j;
+
+    hash = 14695981039346656037UL;   // FNV-1a
+    for(i = 0; i < nswitches; i++)
+        for(j = 0; j < graph[i].nedges; j++){
+            hash = (hash ^ (unsigned long)graph[i].edge[j].n_node) * 1099511628211UL;
+            hash = (hash ^ (unsigned long)graph[i].edge[j].n_edge) * 1099511628211UL;
+        }
+
+    key[k++] = CAM_CACHE_VERSION;
+    key[k++] = sizeof(long);
+    key[k++] = CAM_PORT_BYTES;
+    key[k++] = (long)hash;
+    key[k++] = topo;
+    key[k++] = nswitches;
+    key[k++] = nprocs;
+    key[k++] = stUp;
+    key[k++] = stDown;
+    key[k++] = nnics;
+    key[k++] = cam_policy;
+    key[k++] = cam_ports;
+    key[k++] = cam_policy_params[0];
+    key[k++] = cam_policy_params[1];
+    key[k++] = cam_policy_params[2];
+
+    strncpy(magic, CAM_CACHE_MAGIC, sizeof(magic));
+    if(!cache_data(f, magic, sizeof(magic), save) || strncmp(magic, CAM_CACHE_MAGIC, sizeof(magic)))
+        return B_FALSE;
+    for(i = 0; i < CAM_CACHE_KEYS; i++){
+        k = key[i];
+        if(!cache_data(f, &k, sizeof(k), save) || k != key[i])
+            return B_FALSE;
+    }
+    return B_TRUE;
+}
+
+/**
+ * Writes the CAMs of all the switches in the cache, or reads them.
+ *
+ * The CAMs have to be initialized, but empty, before reading.
+ *
+ * @param f The cache.
+ * @param save TRUE to write the CAMs, FALSE to read them.
+ */
+static void cache_cams(FILE *f, bool_t save){
+
+    long s, e;
+    cam_t *c;
+
+    if(!cache_data(f, &diameter_t, sizeof(diameter_t), save) ||
+            !cache_data(f, &diameter_r, sizeof(diameter_r), save))
+        panic("CAM cache is truncated");
+    for(s = nprocs; s < NUMNODES; s++){
+        c = network[s].cam;
+        if(!save)
+            c->dst = alloc((nswitches + 1) * sizeof(uint32_t));
+        if(!cache_data(f, c->dst, (nswitches + 1) * sizeof(uint32_t), save))
+            panic("CAM cache is truncated");
+        e = c->dst[nswitches];
+        if(cam_ports == CAM_ADAPTIVE){
+            if(!save){
+                c->ports = alloc(max(e, 1) * sizeof(cam_port_t));
+                c->dist = alloc(max(e, 1) * sizeof(cam_port_t));
             }
+            if(!cache_data(f, c->ports, e * sizeof(cam_port_t), save) ||
+                    !cache_data(f, c->dist, e * sizeof(cam_port_t), save))
+                panic("CAM cache is truncated");
+            continue;
         }
+        if(!save)
+            c->hop = alloc((e + 1) * sizeof(uint32_t));
+        if(!cache_data(f, c->hop, (e + 1) * sizeof(uint32_t), save))
+            panic("CAM cache is truncated");
+        if(!save)
+            c->ports = alloc(max(c->hop[e], 1) * sizeof(cam_port_t));
+        if(!cache_data(f, c->ports, c->hop[e] * sizeof(cam_port_t), save))
+            panic("CAM cache is truncated");
+    }
+}
+
+/**
+ * Resolves, in the adaptive CAMs, the queues of the neighbour reached through each port,
+ * so choosing a port needs not go through the neighbours.
+ */
+static void link_cams(){
+
+    long p, s;
+    cam_t *c;
+
+    if(cam_ports != CAM_ADAPTIVE)
+        return;
+    for(s = nprocs; s < NUMNODES; s++){
+        c = network[s].cam;
+        c->next = alloc(radix * sizeof(port*));
+        for(p = 0; p < radix; p++)
+            if(network[s].nbor[p] == NULL_PORT)
+                c->next[p] = NULL;
+            else
+                c->next[p] = &network[network[s].nbor[p]].p[network[s].nborp[p] * nchan];
+    }
+}
+
+/**
+ * Fills the CAMs of all the switches with the paths found in the graph.
+ *
+ * With #cam_cache_file, the CAMs are read from it when it was written for this network
+ * & CAM policy. Otherwise, they are built and written there for the next runs.
+ *
+ * @param graph The graph of the switches.
+ */
+void fill_cams(graph_t *graph){
+
+    char name[FILENAME_MAX];
+    FILE *f;
+
+    if(cam_cache_file[0] != '\0' && (f = fopen(cam_cache_file, "rb")) != NULL){
+        if(cache_header(f, graph, B_FALSE)){
+            cache_cams(f, B_FALSE);
+            fclose(f);
+            printf("CAM tables read from %s\n", cam_cache_file);
+            link_cams();
+            return;
+        }
+        fclose(f);
+        printf("CAM cache %s is for another network; building the tables again\n", cam_cache_file);
+    }
+
+    start_build();
+    find_cams(graph);
+    pack_build();
+    link_cams();
+    if(cam_cache_file[0] == '\0')
+        return;
+    snprintf(name, FILENAME_MAX, "%s.tmp", cam_cache_file);
+    if((f = fopen(name, "wb")) == NULL)
+        panic("Cannot create the CAM cache");
+    cache_header(f, graph, B_TRUE);
+    cache_cams(f, B_TRUE);
+    if(fclose(f) != 0 || rename(name, cam_cache_file) != 0)
+        panic("Cannot write the CAM cache");
+}
+
+/**
+ * Creates the empty CAMs of the switches, for static port selection.
+ */
+void init_cams_rr(){
+
+    long i, switch_id;
+
+    if(radix > CAM_PORT_MAX)
+        panic("Too many ports for the CAM tables; build with a larger CAM_PORT_BYTES");
+    for(switch_id = nprocs; switch_id < NUMNODES; switch_id++){
+        network[switch_id].cam = alloc(sizeof(cam_t));
+        network[switch_id].cam->dst = NULL;
+        network[switch_id].cam->hop = NULL;
+        network[switch_id].cam->ports = NULL;
+        network[switch_id].cam->dist = NULL;
+        network[switch_id].cam->next = NULL;
+        network[switch_id].cam->l_path = alloc(nswitches * sizeof(uint32_t));
+        for(i = 0; i < nswitches; i++)
+            network[switch_id].cam->l_path[i] = 0;
+    }
+}
+
+/**
+ * Creates the empty CAMs of the switches, for adaptive port selection.
+ */
+void init_cams_adaptive(){
+
+    long switch_id;
+
+    if(radix > CAM_PORT_MAX)
+        panic("Too many ports for the CAM tables; build with a larger CAM_PORT_BYTES");
+    for(switch_id = nprocs; switch_id < NUMNODES; switch_id++){
+        network[switch_id].cam = alloc(sizeof(cam_t));
+        network[switch_id].cam->dst = NULL;
+        network[switch_id].cam->hop = NULL;
+        network[switch_id].cam->ports = NULL;
+        network[switch_id].cam->dist = NULL;
+        network[switch_id].cam->l_path = NULL;
+        network[switch_id].cam->next = NULL;
     }
 }
 
@@ -76,15 +611,11 @@ void fill_cam_sp(long node_id, graph_t *graph){
 
     diam_aux = find_shortest_path(switch_id, paths, paths_dists, links, links_r, graph);
 
-    if(diam_aux > diameter_t){
-        diameter_t = diam_aux;
-        diameter_r = diam_aux;
-    }
+    cam_diameter(diam_aux);
 
     for(end = switch_id; end < nswitches; end++){ 
         shortest_path(l, paths, links, links_r, switch_id, end, paths_dists[end]);
-        set_paths(l);
-        set_paths_reverse(l);
+        cam_set_paths(&l, 1);
     }
     free(paths);
     free(paths_dists);
@@ -109,14 +640,12 @@ void fill_cam_ecmp(long node_id, graph_t *graph){
 
     diam_aux = find_shortest_path(switch_id, paths, paths_dists, links, links_r, graph);
 
-    if(diam_aux > diameter_t)
-        diameter_t = diam_aux;
+    cam_diameter(diam_aux);
 
     for(end = switch_id; end < nswitches; end++){ 
         k_paths[0] = init_path(nswitches);
         m_paths_aux = shortest_path_generic(k_paths, paths, links, links_r, switch_id, end, paths_dists[end], m_paths, 1, graph);
-        set_mpaths(k_paths, m_paths_aux);
-        set_mpaths_reverse(k_paths, m_paths_aux);
+        cam_set_paths(k_paths, m_paths_aux);
 
         for(i = 0; i < m_paths_aux; i++){
             destroy_path(k_paths[i]);
@@ -146,14 +675,12 @@ void fill_cam_ksp(long node_id, graph_t *graph){
 
     diam_aux = find_shortest_path(switch_id, paths, paths_dists, links, links_r, graph);
 
-    if(diam_aux > diameter_t)
-        diameter_t = diam_aux;
+    cam_diameter(diam_aux);
 
     for(end = switch_id; end < nswitches; end++){ 
         k_paths[0] = init_path(nswitches);
         m_paths_aux = shortest_path_generic(k_paths, paths, links, links_r, switch_id, end, paths_dists[end], m_paths, 0, graph);
-        set_mpaths(k_paths, m_paths_aux);
-        set_mpaths_reverse(k_paths, m_paths_aux);
+        cam_set_paths(k_paths, m_paths_aux);
 
         for(i = 0; i < m_paths_aux; i++){
             destroy_path(k_paths[i]);
@@ -195,14 +722,12 @@ void fill_cam_llskr(long node_id, graph_t *graph){
 
     diam_aux = find_shortest_path(switch_id, paths, paths_dists, links, links_r, graph);
 
-    if(diam_aux > diameter_t)
-        diameter_t = diam_aux;
+    cam_diameter(diam_aux);
 
     for(end = switch_id; end < nswitches; end++){ 
         k_paths[0] = init_path(nswitches);
         m_paths_aux = shortest_path_generic_limited(k_paths, paths, links, links_r, switch_id, end, paths_dists[end], M, m_paths, H, ths, graph);
-        set_mpaths(k_paths, m_paths_aux);
-        set_mpaths_reverse(k_paths, m_paths_aux);
+        cam_set_paths(k_paths, m_paths_aux);
 
         for(i = 0; i < m_paths_aux; i++){
             destroy_path(k_paths[i]);
@@ -234,14 +759,12 @@ void fill_cam_allpath(long node_id, graph_t *graph){
 
     diam_aux = find_shortest_path(switch_id, paths, paths_dists, links, links_r, graph);
 
-    if(diam_aux > diameter_t)
-        diameter_t = diam_aux;
+    cam_diameter(diam_aux);
 
     for(end = switch_id; end < nswitches; end++){ 
         k_paths[0] = init_path(nswitches);
         m_paths_aux = shortest_path_generic_limited(k_paths, paths, links, links_r, switch_id, end, paths_dists[end], M, m_paths, H, 0, graph);
-        set_mpaths(k_paths, m_paths_aux);
-        set_mpaths_reverse(k_paths, m_paths_aux);
+        cam_set_paths(k_paths, m_paths_aux);
 
         for(i = 0; i < m_paths_aux; i++){
             destroy_path(k_paths[i]);
@@ -255,88 +778,79 @@ void fill_cam_allpath(long node_id, graph_t *graph){
     free(links_r);
 }
 
-void set_paths(path_t *path){
-
-    long i, src, l, dst;
-
-    src = path->nodes[0] + nprocs;
-    dst = path->nodes[path->length - 1];
-
-    network[src].cam[dst].ports[0] = alloc((path->length) * sizeof(long)); 
-    network[src].cam[dst].ports[0][0] = path->length -1; 
-    network[src].cam[dst].n_paths = 1;
-    for(i = 1; i < path->length; i++){
-        l = path->links[i] + stDown;
-        network[src].cam[dst].ports[0][i] = l; // position 0 is for length  
-    }
-}
-
-void set_paths_reverse(path_t *path){
-
-    long i, src, l, dst;
+/**
+ * Appends the paths between two switches to the CAM being filled of one of them.
+ *
+ * @param sw The switch whose CAM is filled.
+ * @param dst The other switch.
+ * @param path The paths.
+ * @param n_paths The number of paths.
+ * @param reverse TRUE if the paths go from dst to sw, so they are walked backwards.
+ */
+static void add_paths(long sw, long dst, path_t **path, long n_paths, bool_t reverse){
 
-    src = path->nodes[path->length - 1] + nprocs;
-    dst = path->nodes[0];
+    long i, j, len;
+    cam_build_t *b = &build[sw];
 
-    network[src].cam[dst].ports[0] = alloc((path->length) * sizeof(long)); 
-    network[src].cam[dst].ports[0][0] = path->length -1; 
-    network[src].cam[dst].n_paths = 1;
-    for(i = path->length - 2; i >= 0; i--){
-        l = path->links_r[i + 1] + stDown;
-        network[src].cam[dst].ports[0][path->length - 1 - i] = l; // position 0 is for length  
+    b->rec = grow(b->rec, &b->cap_rec, b->n_rec + 2 + n_paths, sizeof(uint32_t));
+    b->rec[b->n_rec++] = dst;
+    b->rec[b->n_rec++] = n_paths;
+    for(j = 0; j < n_paths; j++){
+        len = path[j]->length - 1;
+        b->rec[b->n_rec++] = len;
+        b->ports = grow(b->ports, &b->cap_ports, b->n_ports + len, sizeof(cam_port_t));
+        for(i = 1; i <= len; i++)
+            b->ports[b->n_ports++] = (reverse ? path[j]->links_r[len - i + 1] : path[j]->links[i]) + stDown;
     }
 }
 
 void set_mpaths_rr(path_t **path, long n_paths){
 
-    long i, j, src, l, dst;
-
-    src = path[0]->nodes[0] + nprocs;
-    dst = path[0]->nodes[path[0]->length - 1];
-
-    network[src].cam[dst].n_paths = n_paths;
-
-    for(j = 0; j < n_paths; j++){
-
-        network[src].cam[dst].ports[j] = alloc((path[j]->length) * sizeof(long)); 
-        network[src].cam[dst].ports[j][0] = path[j]->length -1; 
+    long j;
 
+    for(j = 0; j < n_paths; j++)
         if((path[j]->length - 1) > diameter_r)
             diameter_r = (path[j]->length - 1);
-
-        for(i = 1; i < path[j]->length; i++){
-            l = path[j]->links[i] + stDown;
-            network[src].cam[dst].ports[j][i] = l; // position 0 is for length  
-        }
-    }
+    add_paths(path[0]->nodes[0], path[0]->nodes[path[0]->length - 1], path, n_paths, B_FALSE);
 }
 
 void set_mpaths_reverse_rr(path_t **path, long n_paths){
 
-    long i, j, src, l, dst;
-
-    src = path[0]->nodes[path[0]->length - 1] + nprocs; // Do it just once
-    dst = path[0]->nodes[0];
-
-    network[src].cam[dst].n_paths = n_paths;
-
-    for(j = 0; j < n_paths; j++){
-
-        network[src].cam[dst].ports[j] = alloc((path[j]->length) * sizeof(long)); 
-        network[src].cam[dst].ports[j][0] = path[j]->length -1; 
-
-        for(i = path[j]->length - 2; i >= 0; i--){
-            l = path[j]->links_r[i + 1] + stDown;
-            network[src].cam[dst].ports[j][path[j]->length - 1 - i] = l; // position 0 is for length  
-        }
-    }
+    if(path[0]->length == 1)
+        return; // From a switch to itself, already set.
+    add_paths(path[0]->nodes[path[0]->length - 1], path[0]->nodes[0], path, n_paths, B_TRUE);
 }
 
+/**
+ * Adds a port to a destination in the CAM being filled of a switch, if it is not there yet.
+ *
+ * @param sw The switch whose CAM is filled.
+ * @param dst The destination switch.
+ * @param l The port.
+ * @param dist The distance to the destination through the port.
+ */
+static void add_port(long sw, long dst, long l, long dist){
+
+    long k, n;
+    cam_build_t *b = &build[sw];
+    cam_port_t *ports = &b->ports[dst * stUp];
+
+    n = b->rec[dst];
+    for(k = 0; k < n; k++)
+        if(ports[k] == l)
+            return;
+    if(n == stUp)
+        return;
+    if(dist > CAM_PORT_MAX)
+        panic("Path too long for the CAM tables; build with a larger CAM_PORT_BYTES");
+    ports[n] = l;
+    b->dist[(dst * stUp) + n] = dist;
+    b->rec[dst]++;
+}
 
 void set_mpaths_adaptive(path_t **path, long n_paths){
 
-    long i, j, k, src, l, dst, max_length, dist;
-
+    long i, j, dst, max_length;
 
     max_length = path[n_paths - 1]->length;
     dst = path[n_paths - 1]->nodes[max_length - 1];
@@ -347,56 +861,23 @@ void set_mpaths_adaptive(path_t **path, long n_paths){
             if(i == 1 && ((path[j]->length - 1) > diameter_r))
                 diameter_r = (path[j]->length - 1);
 
-            if(i < path[j]->length){
-                dist = path[j]->length - i;
-                src = path[j]->nodes[i - 1] + nprocs; 
-                l = path[j]->links[i] + stDown;
-                k = 0;
-
-                while(k < stUp){
-                    if(network[src].cam[dst].ports[0][k] == l){
-                        break;
-                    }
-                    if(network[src].cam[dst].ports[0][k] == -1){
-                        network[src].cam[dst].ports[0][k] = l;
-                        network[src].cam[dst].ports[1][k] = dist;
-                        network[src].cam[dst].n_paths++; //In adaptive we use this field to know how many ports are used
-                        break;
-                    }
-                    k++;
-                }
-            }
+            if(i < path[j]->length)
+                add_port(path[j]->nodes[i - 1], dst, path[j]->links[i] + stDown, path[j]->length - i);
         }
     }
 }
 
 void set_mpaths_reverse_adaptive(path_t **path, long n_paths){
     
-    long i, j, k, src, l, dst, max_length, dist;
+    long i, j, dst, max_length;
 
     max_length = path[n_paths - 1]->length;
     dst = path[n_paths - 1]->nodes[0];
 
     for(i = 1; i < max_length; i++){
         for(j = 0; j < n_paths; j++){
-           if(i < path[j]->length){
-                dist = i;
-                src = path[j]->nodes[i] + nprocs; 
-                l = path[j]->links_r[i] + stDown;
-                k = 0;
-
-                while(k < stUp){
-                    if(network[src].cam[dst].ports[0][k] == l)
-                        break;
-                    if(network[src].cam[dst].ports[0][k] == -1){
-                        network[src].cam[dst].ports[0][k] = l;
-                        network[src].cam[dst].ports[1][k] = dist;
-                        network[src].cam[dst].n_paths++; //In adaptive we use this field to know how many ports are used
-                        break;
-                    }
-                    k++;
-                }
-            }
+            if(i < path[j]->length)
+                add_port(path[j]->nodes[i], dst, path[j]->links_r[i] + stDown, i);
         }
     }
 }
@@ -404,26 +885,21 @@ void set_mpaths_reverse_adaptive(path_t **path, long n_paths){
 void print_cams(){
 
     long i, j, k, switch_id;
+    cam_t *c;
 
     for(switch_id = nprocs; switch_id < NUMNODES; switch_id++){
+        c = network[switch_id].cam;
         for(i = 0; i < nswitches; i++){
-            printf("SWICTH: %ld --> %ld #ENTRIES: %ld PORTS: \n", switch_id, i, network[switch_id].cam[i].n_paths);
-            //for(j = 0; j < network[switch_id].cam[i].n_paths; j++){
-            for(j = 0; j < 1; j++){
-                if( switch_id != i + nprocs){
-                    //for(k = 0; k < network[switch_id].cam[i].ports[j][0]; k++){
-                    for(k = 0; k < stUp; k++){
-                        //printf("%ld ", network[switch_id].cam[i].ports[j][k + 1]);
-                        printf("%ld ", network[switch_id].cam[i].ports[0][k]);
-                    }
-                    printf("\n");
-                        for(k = 0; k < stUp; k++){
-                        //printf("%ld ", network[switch_id].cam[i].ports[j][k + 1]);
-                        printf("%ld ", network[switch_id].cam[i].ports[1][k]);
-                    }
-
+            printf("SWICTH: %ld --> %ld #ENTRIES: %ld PORTS: \n", switch_id, i, cam_entries(c, i));
+            if(switch_id == i + nprocs)
+                continue;
+            for(j = 0; j < cam_entries(c, i); j++){
+                if(cam_ports == CAM_ADAPTIVE)
+                    printf("%ld (%ld)", (long)cam_port(c, i, j), (long)cam_dist(c, i, j));
+                else
+                    for(k = 0; k < cam_path_len(c, i, j); k++)
+                        printf("%ld ", (long)cam_path(c, i, j)[k]);
                 printf("\n");
-                }
             }
         }
     }
@@ -440,36 +916,26 @@ void print_vector(long *v, long l){
 
 void finish_cams_rr(){
 
-    long i, j, switch_id;
+    long switch_id;
 
     for(switch_id = nprocs; switch_id < NUMNODES; switch_id++){
-        for(i = 0; i < nswitches; i++){
-            for(j = 0; j < network[switch_id].cam[i].n_paths; j++){
-                if(switch_id != (i + nprocs)){
-                    free(network[switch_id].cam[i].ports[j]);
-                }
-            }
-            free(network[switch_id].cam[i].ports);
-        }
+        free(network[switch_id].cam->dst);
+        free(network[switch_id].cam->hop);
+        free(network[switch_id].cam->ports);
+        free(network[switch_id].cam->l_path);
         free(network[switch_id].cam);
     }
 }
 
 void finish_cams_adaptive(){
 
-    long i, switch_id;
+    long switch_id;
 
     for(switch_id = nprocs; switch_id < NUMNODES; switch_id++){
-        for(i = 0; i < nswitches; i++){
-                if(switch_id != (i + nprocs)){
-                    free(network[switch_id].cam[i].ports[0]);
-                    free(network[switch_id].cam[i].ports[1]);
-                }
-            free(network[switch_id].cam[i].ports);
-        }
+        free(network[switch_id].cam->dst);
+        free(network[switch_id].cam->ports);
+        free(network[switch_id].cam->dist);
+        free(network[switch_id].cam->next);
         free(network[switch_id].cam);
     }
 }
-
-
-
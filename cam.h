@@ -6,22 +6,78 @@
 #ifndef _cam
 #define _cam
 
+#include <stdint.h>
+#include "constants.h"
 #include "graph.h"
 #include "list.h"
 #include "ksp_routing.h"
 
+#define CAM_CACHE_MAGIC "FSINCAM"   ///< First bytes of a CAM cache (8, with the '\0').
+#define CAM_CACHE_VERSION 2         ///< Version of the format of the CAM cache.
+#define CAM_CACHE_KEYS 15           ///< Number of values in the key of a CAM cache.
+
+#if (CAM_PORT_BYTES == 1)
+typedef uint8_t cam_port_t;         ///< A port, or a distance, in a CAM table.
+#define CAM_PORT_MAX UINT8_MAX      ///< Largest port, or distance, in a CAM table.
+#else
+typedef uint16_t cam_port_t;        ///< A port, or a distance, in a CAM table.
+#define CAM_PORT_MAX UINT16_MAX     ///< Largest port, or distance, in a CAM table.
+#endif /* CAM_PORT_BYTES */
+
+/**
+ * The CAM table of a switch, with the paths (or the ports) to every destination switch.
+ *
+ * The entries of all the destinations are packed one after another: the ones of
+ * destination d go from dst[d] to dst[d+1]. With static port selection (rr, rnd) an
+ * entry is a path, whose ports, one per hop, go from hop[e] to hop[e+1] in #ports. With
+ * adaptive port selection an entry is a port of the switch in #ports, with the distance
+ * to the destination through it in #dist, and the queues reached through each port are
+ * in #next.
+ */
+struct port;
+
 typedef struct cam_t {
 
-    long n_paths; // Number of paths to one destination
-    long l_path;  // Last path used to one destination
-    long **ports;  // Port to be used
+    uint32_t *dst;      ///< First entry of each destination (nswitches + 1).
+    uint32_t *hop;      ///< First port of each path (entries + 1). Static only.
+    cam_port_t *ports;  ///< The ports.
+    cam_port_t *dist;   ///< Distance through each port. Adaptive only.
+    uint32_t *l_path;   ///< Last path used to each destination. Static only.
+    struct port **next; ///< First VC of the input port of the neighbour at each port. Adaptive only.
 
 } cam_t;
 
+/**
+ * Number of entries (paths, or ports if adaptive) to destination switch d in CAM c.
+ */
+#define cam_entries(c, d) ((long)((c)->dst[(d) + 1] - (c)->dst[d]))
+
+/**
+ * Number of hops of path j to destination switch d in CAM c.
+ */
+#define cam_path_len(c, d, j) ((long)((c)->hop[(c)->dst[d] + (j) + 1] - (c)->hop[(c)->dst[d] + (j)]))
+
+/**
+ * The ports of path j to destination switch d in CAM c, one per hop.
+ */
+#define cam_path(c, d, j) (&(c)->ports[(c)->hop[(c)->dst[d] + (j)]])
+
+/**
+ * Port i to destination switch d in adaptive CAM c.
+ */
+#define cam_port(c, d, i) ((c)->ports[(c)->dst[d] + (i)])
+
+/**
+ * Distance to destination switch d through port i in adaptive CAM c.
+ */
+#define cam_dist(c, d, i) ((c)->dist[(c)->dst[d] + (i)])
+
 void init_cams_rr();
 
 void init_cams_adaptive();
 
+void fill_cams(graph_t *graph);
+
 void fill_cam_sp(long switch_id, graph_t *graph);
 
 void fill_cam_ecmp(long switch_id, graph_t *graph);
@@ -32,10 +88,6 @@ void fill_cam_llskr(long switch_id, graph_t *graph);
 
 void fill_cam_allpath(long switch_id, graph_t *graph);
 
-void set_paths(path_t *path);
-
-void set_paths_reverse(path_t *path);
-
 void set_mpaths_rr(path_t **path, long n_paths);
 
 void set_mpaths_reverse_rr(path_t **path, long n_paths);
@@ -0,0 +1,293 @@
+/**
+* @file
+* @brief	Checkpoints: snapshots of a simulation, taken between two cycles, to resume it later.
+*
+* The simulation is built from the configuration as usual and then the snapshot is loaded
+* over it, so only what changes while simulating is written: the topology, the routing
+* tables and the traces are built again. Thus, the configuration used to resume has to
+* describe the same network, traffic and seed, which is checked with the key written in
+* the header. Other parameters, like the load, may change, so the runs of a load sweep can
+* all start from the same warmed-up network.
+*
+* A checkpoint is only valid for the build of FSIN that wrote it: the data are written with
+* the sizes and byte order of the machine.
+
+FSIN Functional Simulator of Interconnection Networks
+Copyright (2003-2011) J. Miguel-Alonso, A. Gonzalez, J. Navaridas
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "globals.h"
+
+#define RNG_STATE 128	///< Bytes of the state of the random generator: the one rand() uses after srand().
+#define CKP_KEYS 24		///< Number of values in the key of a checkpoint.
+
+static char rng_state[2][RNG_STATE];	///< Two buffers for the state of the random generator. See rng_checkpoint().
+static long rng_curr = 0;				///< The buffer in use.
+static CLOCK_TYPE last_ckp = -1;		///< Cycle of the last snapshot written or read.
+
+/**
+* Writes some data in a checkpoint, or reads them.
+*
+* @param f The checkpoint.
+* @param data The data.
+* @param size The size of the data, in bytes.
+* @param save TRUE to write the data, FALSE to read them.
+*/
+void ckp_data(FILE *f, void *data, size_t size, bool_t save) {
+	if (size == 0)
+		return;
+	if (save && fwrite(data, size, 1, f) != 1)
+		panic("Cannot write the checkpoint");
+	if (!save && fread(data, size, 1, f) != 1)
+		panic("Checkpoint is truncated");
+}
+
+/**
+* Seeds the random generator used by rand().
+*
+* rand() takes its numbers from the generator of random(), whose state can be put in our own
+* buffer with initstate(). With #RNG_STATE bytes it is the same generator, giving the same
+* numbers, as after srand().
+*
+* @param seed The seed.
+*/
+void rng_init(long seed) {
+	initstate((unsigned int)seed, rng_state[rng_curr], RNG_STATE);
+}
+
+/**
+* Writes the state of the random generator in a checkpoint, or reads it.
+*
+* The position of the generator is only stored in its state by setstate(), which stores it
+* in the state in use before changing to the new one. So, a state read goes to the other
+* buffer before using it.
+*
+* @param f The checkpoint.
+* @param save TRUE to write the state, FALSE to read it.
+*/
+static void rng_checkpoint(FILE *f, bool_t save) {
+	if (save) {
+		setstate(rng_state[rng_curr]);
+		ckp_data(f, rng_state[rng_curr], RNG_STATE, save);
+	}
+	else {
+		ckp_data(f, rng_state[1 - rng_curr], RNG_STATE, save);
+		rng_curr = 1 - rng_curr;
+		setstate(rng_state[rng_curr]);
+	}
+}
+
+/**
+* Writes the header of a checkpoint, or reads and checks it.
+*
+* The key holds what has to be the same in the simulation that resumes the checkpoint: the
+* build, the network, the traffic and the seed (the topology may depend on it).
+*
+* @param f The checkpoint.
+* @param save TRUE to write the header, FALSE to read it.
+*/
+static void ckp_header(FILE *f, bool_t save) {
+	char magic[8];
+	long version = CKP_VERSION, key[CKP_KEYS], k = 0, i;
+
+	key[k++] = sizeof(router);
+	key[k++] = sizeof(packet_t);
+	key[k++] = sizeof(batch_t);
+	key[k++] = PACKET_QUEUES;
+	key[k++] = TRACE_SUPPORT;
+	key[k++] = BIMODAL_SUPPORT;
+	key[k++] = NUMNODES;
+	key[k++] = nprocs;
+	key[k++] = n_ports;
+	key[k++] = radix;
+	key[k++] = ninj;
+	key[k++] = tr_qd;
+	key[k++] = inj_qd;
+	key[k++] = buffer_cap;
+	key[k++] = pkt_len;
+	key[k++] = pkt_max;
+	key[k++] = topo;
+	key[k++] = pattern;
+	key[k++] = r_seed;
+	key[k++] = faults;
+	key[k++] = THREADS;	// The random streams of the routers are only there with it.
+	key[k++] = plevel & 5;	// The maps and the distance histograms are only there with these bits.
+	key[k++] = trace_nodes;
+	key[k++] = trace_instances;
+
+	strncpy(magic, CKP_MAGIC, sizeof(magic));
+	ckp_data(f, magic, sizeof(magic), save);
+	if (strncmp(magic, CKP_MAGIC, sizeof(magic)))
+		panic("Not a checkpoint");
+	ckp_var(f, version, save);
+	if (version != CKP_VERSION)
+		panic("Unsupported version of checkpoint");
+	for (i = 0; i < CKP_KEYS; i++) {
+		k = key[i];
+		ckp_var(f, k, save);
+		if (k != key[i])
+			panic("Checkpoint taken with another network, traffic, seed or build of FSIN");
+	}
+}
+
+/**
+* Writes the clock and the stats in a checkpoint, or reads them.
+*
+* @param f The checkpoint.
+* @param save TRUE to write them, FALSE to read them.
+*/
+static void stats_checkpoint(FILE *f, bool_t save) {
+	long i;
+
+	ckp_var(f, sim_clock, save);
+	ckp_var(f, go_on, save);
+	ckp_var(f, reseted, save);
+	ckp_var(f, last_reset_time, save);
+	ckp_var(f, warmed_up, save);
+	ckp_var(f, sent_count, save);
+	ckp_var(f, injected_count, save);
+	ckp_var(f, rcvd_count, save);
+	ckp_var(f, last_rcvd_count, save);
+	ckp_var(f, dropped_count, save);
+	ckp_var(f, transit_dropped_count, save);
+	ckp_var(f, last_tran_drop_count, save);
+	ckp_var(f, inj_phit_count, save);
+	ckp_var(f, sent_phit_count, save);
+	ckp_var(f, rcvd_phit_count, save);
+	ckp_var(f, dropped_phit_count, save);
+	ckp_var(f, acum_delay, save);
+	ckp_var(f, acum_inj_delay, save);
+	ckp_var(f, acum_sq_delay, save);
+	ckp_var(f, acum_sq_inj_delay, save);
+	ckp_var(f, max_delay, save);
+	ckp_var(f, max_inj_delay, save);
+	ckp_var(f, acum_hops, save);
+	ckp_var(f, global_q_u, save);
+	ckp_var(f, global_q_u_current, save);
+	ckp_var(f, used_chan, save);
+
+	ckp_data(f, source_ports, sizeof(long) * n_ports, save);
+	ckp_data(f, dest_ports, sizeof(long) * n_ports, save);
+	ckp_data(f, port_utilization, sizeof(CLOCK_TYPE) * n_ports, save);
+	if (plevel & 1)
+		for (i = 0; i < nprocs; i++) {
+			ckp_data(f, destinations[i], sizeof(long) * nprocs, save);
+			ckp_data(f, sources[i], sizeof(long) * nprocs, save);
+		}
+	if (plevel & 4) {
+		ckp_data(f, inj_dst, sizeof(long) * max_dst, save);
+		ckp_data(f, con_dst, sizeof(long) * max_dst, save);
+	}
+#if (BIMODAL_SUPPORT != 0)
+	ckp_var(f, msg_sent_count, save);
+	ckp_var(f, msg_injected_count, save);
+	ckp_var(f, msg_rcvd_count, save);
+	ckp_var(f, msg_acum_delay, save);
+	ckp_var(f, msg_acum_inj_delay, save);
+	ckp_var(f, msg_acum_sq_delay, save);
+	ckp_var(f, msg_acum_sq_inj_delay, save);
+	ckp_var(f, msg_max_delay, save);
+	ckp_var(f, msg_max_inj_delay, save);
+#endif /* BIMODAL */
+}
+
+/**
+* Writes the whole state of the simulation in a checkpoint, or reads it.
+*
+* @param f The checkpoint.
+* @param save TRUE to write it, FALSE to read it.
+*/
+static void state_checkpoint(FILE *f, bool_t save) {
+	char magic[8];
+	long i;
+
+	ckp_header(f, save);
+	stats_checkpoint(f, save);
+	for (i = 0; i < NUMNODES; i++)
+		router_checkpoint(f, i, save);
+	pkt_checkpoint(f, save);
+	worklist_checkpoint(f, save);
+#if (THREADS != 0)
+	threads_checkpoint(f, save);
+#endif
+	injection_checkpoint(f, save);
+	batch_checkpoint(f, save);
+#if (TRACE_SUPPORT != 0)
+	if (pattern == TRACE || pattern == MPA)
+		trace_checkpoint(f, save);
+#endif
+	rng_checkpoint(f, save);
+
+	// The magic again, to know that everything has been read as it was written.
+	strncpy(magic, CKP_MAGIC, sizeof(magic));
+	ckp_data(f, magic, sizeof(magic), save);
+	if (strncmp(magic, CKP_MAGIC, sizeof(magic)))
+		panic("Checkpoint is corrupted");
+}
+
+/**
+* Writes a snapshot of the simulation in #checkpoint_file.
+*
+* It is written in a temporary file first, so the previous snapshot is kept until the new one
+* is complete. Nothing is done if there is no #checkpoint_file or if the snapshot of this cycle
+* has already been written, or read.
+*/
+void take_checkpoint(void) {
+	char name[FILENAME_MAX];
+	FILE *f;
+
+	if (checkpoint_file[0] == '\0' || sim_clock == last_ckp)
+		return;
+	snprintf(name, FILENAME_MAX, "%s.tmp", checkpoint_file);
+	if ((f = fopen(name, "wb")) == NULL)
+		panic("Cannot create the checkpoint file");
+	state_checkpoint(f, B_TRUE);
+	if (fclose(f) != 0 || rename(name, checkpoint_file) != 0)
+		panic("Cannot write the checkpoint");
+	last_ckp = sim_clock;
+	printf("%11"PRINT_CLOCK":: Checkpoint written in %s\n", sim_clock, checkpoint_file);
+}
+
+/**
+* Resumes the simulation from the snapshot in #restore_file.
+*
+* The simulation must have been built, and the trace read, before.
+*/
+void restore_checkpoint(void) {
+	FILE *f;
+
+	if ((f = fopen(restore_file, "rb")) == NULL)
+		panic("Checkpoint to restore not found");
+	state_checkpoint(f, B_FALSE);
+	fclose(f);
+	last_ckp = sim_clock;
+	printf("%11"PRINT_CLOCK":: Simulation restored from %s\n", sim_clock, restore_file);
+}
+
+/**
+* Takes the snapshots due at the end of a cycle: every #checkpoint_period cycles and when
+* the simulation is interrupted, so it can be resumed later.
+*
+* The clock may jump over many cycles when the CPU bursts are skipped, so a snapshot is
+* taken in the first cycle of each period, not only in its multiples.
+*/
+void checkpoint_cycle(void) {
+	if (checkpoint_file[0] == '\0' || aborted)
+		return;
+	if (interrupted || (checkpoint_period > 0 && sim_clock / checkpoint_period != last_ckp / checkpoint_period))
+		take_checkpoint();
+}
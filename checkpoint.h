@@ -0,0 +1,46 @@
+/**
+* @file
+* @brief	Declaration of the checkpoints of the simulation.
+*
+* A checkpoint is a binary snapshot of all the state that changes while simulating: the
+* queues of the routers, the packets, the event queues, the random generators, the stats
+* and the clock. Each module writes its own part with the helpers declared here.
+
+FSIN Functional Simulator of Interconnection Networks
+Copyright (2003-2011) J. Miguel-Alonso, A. Gonzalez, J. Navaridas
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _checkpoint
+#define _checkpoint
+
+#include <stdio.h>
+#include "misc.h"
+
+#define CKP_MAGIC "FSINCKP"	///< First bytes of a checkpoint (8, with the '\0').
+#define CKP_VERSION 5		///< Version of the format.
+
+void ckp_data(FILE *f, void *data, size_t size, bool_t save);
+
+/**
+* Writes a variable in a checkpoint, or reads it.
+*/
+#define ckp_var(f, x, save) ckp_data((f), &(x), sizeof(x), (save))
+
+void rng_init(long seed);
+void take_checkpoint(void);
+void restore_checkpoint(void);
+void checkpoint_cycle(void);
+
+#endif /* _checkpoint */
@@ -206,7 +206,7 @@ routing_r circ_pk_rr (long source, long destination){
 	long i,t;
 
 	//printf("\n==== kk:  %ld --> %ld ====\n",source, destination);
-	res.rr=alloc(ndim*sizeof(long));
+	res.rr=rr_alloc(ndim);
 
 	if (source == destination)
 		panic("Self-sent packet");
@@ -74,7 +74,7 @@ routing_r circulant_rr (long source, long destination) {
 	routing_r res;	///> The resulting routing record
 
 	//printf("\n==== kk:  %ld --> %ld ====\n",source, destination);
-	res.rr=alloc(ndim*sizeof(long));
+	res.rr=rr_alloc(ndim);
 
 	top=4;
 
@@ -201,7 +201,7 @@ routing_r circulant_dummy_rr (long source, long destination) {
 	long A2, x2, y2, d2; ///> The id difference, the number of hops in x and y and the total distance, when travelling counterclockwise
 	routing_r res;	///> The resulting routing record
 
-	res.rr=alloc(ndim*sizeof(long));
+	res.rr=rr_alloc(ndim);
 
 	if (destination>source){
 		A1=destination-source;
@@ -29,17 +29,25 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #endif /* BIMODAL */
 
 /**
- * Keep count of the number of phits within a router and if there is 0 do not enter packet moving routine.
+ * Do not enter packet moving routine in routers with no phits within (the count is always kept).
  * Boost traces using large cpu intervals or handling low loads. Otherwise it is not likely to help, but barely harms performance, so it's the default mode.
+ * The worklist option gets the same benefit at run-time without scanning all the routers.
  */
 #ifndef PCOUNT
 #define PCOUNT 0
 #endif /* PCOUNT */
 
+/**
+ * Queues keep a descriptor per packet (its id and how many of its phits are in the queue) instead of a copy of every phit.
+ * Phits are still inserted and removed one by one, but memory and bulk operations no longer grow with the packet length.
+ * When zero, the queues are arrays of phits.
+ */
+#ifndef PACKET_QUEUES
+#define PACKET_QUEUES 1
+#endif /* PACKET_QUEUES */
+
 #ifndef TRACE_SUPPORT
-#define TRACE_SUPPORT 2		///< 0: trace support is deactivated.
-                            ///< 1: occurs is implemented as a single list (less memory but slower).
-							///< 2+: occurs is implemented as a multilist (much faster but more memory). This is default
+#define TRACE_SUPPORT 2		///< 0: trace support is deactivated. Any other value activates it.
 #endif /* TRACE */
 
 #ifndef REPORT_ALL_TASKS
@@ -51,10 +59,41 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #endif /* CHECK_TRC_DEADLOCK */
 
 #ifndef SKIP_CPU_BURSTS
-#define SKIP_CPU_BURSTS 1 ///< If all the nodes are executing CPU events skip enough cycles until there is any communication event. Checking is somewhat compute intensive (although there is some space for improvement), so only should be used with cpu-intensive traces
+#define SKIP_CPU_BURSTS 1 ///< In trace mode, when there is no packet in the network and the tasks are only computing, skip the cycles until the next CPU burst finishes. The bursts are kept in a heap, so checking is cheap.
 #endif /* SKIP_CPU_BURSTS */
 
 
+/**
+ * Support for the multi-threaded engine (option threads). When zero the simulator is strictly single-threaded
+ * and there is no need to link against pthreads; routing then draws from rand() instead of the random streams
+ * of the routers, so the results are not the same as with it.
+ */
+#ifndef THREADS
+#define THREADS 1
+#endif /* THREADS */
+
+/**
+ * Bytes of each port (and distance) in the CAM tables of graph topologies. One byte is enough for switches of
+ * up to 255 ports and paths of up to 255 hops; use 2 for larger ones.
+ */
+#ifndef CAM_PORT_BYTES
+#define CAM_PORT_BYTES 1
+#endif /* CAM_PORT_BYTES */
+
+#if (THREADS != 0)
+#define THREAD_LOCAL __thread	///< Storage for the scratch variables that every worker thread needs a copy of.
+#else
+#define THREAD_LOCAL
+#endif /* THREAD_LOCAL */
+
+/**
+ * Support for the cycle profiler (option profile). When zero the counters are not compiled at all, so they
+ * cost nothing. The target insee_n_dim_sim_prof is built with it.
+ */
+#ifndef PROFILE
+#define PROFILE 0
+#endif /* PROFILE */
+
 /* Execution driven simulation */
 #ifndef EXECUTION_DRIVEN
 #define EXECUTION_DRIVEN 0	///< If non-zero, performs a execution driven simulation. Overrides other execution modes in #tpattern.
@@ -113,7 +113,7 @@ port_type select_input_port_dor_only(long i, long dest) {
 			break;
 		default:;
 	}
-	free(r.rr);
+	rr_free(r.rr);
 	if (p==NULL_PORT)
 		panic("Bad pre-routing");
 
@@ -160,7 +160,7 @@ port_type select_input_port_shortest_profitable(long i, long dest) {
 			}
 		}
 	}
-	free (r.rr);
+	rr_free(r.rr);
 	return selport;
 }
 
@@ -220,7 +220,7 @@ port_type select_input_port_lpath(long i, long dest) {
 			}
 		}
 	}
-	free(r.rr);
+	rr_free(r.rr);
 	return selport;
 }
 
@@ -263,6 +263,9 @@ void generate_phits(unsigned long packet, port_type iport) {
 		p.pclass = TAIL;
 		inj_ins_queue(qi, &p);
 	}
+	network[node].pcount += pkt_space[packet].size;
+	if (worklist)
+		activate_router(node);
 
 	if (plevel & 1)
 		sources[pkt_space[packet].from][pkt_space[packet].to]++;
@@ -295,6 +298,9 @@ void generate_pkt(long i) {
 	packet_t packet;
 
         packet.path_id = -1;
+#if (TRACE_SUPPORT != 0)
+        packet.length = 0;	// Only the packets of the messages of a trace have it.
+#endif
 //	if (network[i].source==NO_SOURCE) // Should not be testing this -- paranoid mode.
 //	{
 //		printf("node %ld\n",i);
@@ -496,8 +502,12 @@ void generate_pkt(long i) {
                     if (!event_empty(&network[i].events)){
                         event e;
                         while (!event_empty(&network[i].events) && (e=head_event(&network[i].events)).type==RECEPTION){
-                            if (occurred(&network[i].occurs, e))
+                            if (occurred(&network[i].occurs, e)){
                                 rem_head_event(&network[i].events);
+#if (SKIP_CPU_BURSTS==1)
+                                trace_activity = sim_clock;
+#endif
+                            }
                             else
                                 break;
                         }
@@ -507,20 +517,8 @@ void generate_pkt(long i) {
                             packet.length = e.length;
                             d=e.pid;
                         }else if(event_empty(&network[i].events)){
-                            //change node source to FINISHED
+                            //change node source to FINISHED. There is no app mix to update in this mode.
                             network[i].source=FINISHED;
-                            ////> change bitmap of app
-                            if(network[i].appid==0){
-                                printf("App 0 Node %d finished", i);
-                            }
-                            set_bitmap(i, network[i].appid);
-                            //Check if all nodes of app have finished in bitmap
-                            //If all have been done we have to empty events and ocurred queues, then del app, and call apx_traces
-                            // to laod next app, if not continue
-                            if(check_finished_app(network[i].appid)==1){
-                                d_app(network[i].appid);
-                                apx_traces();
-                            }
                             return;
                         }else{
                             return;
@@ -528,18 +526,6 @@ void generate_pkt(long i) {
                     }else{
                         //change node source to FINISHED
                         network[i].source=FINISHED;
-                        ////> change bitmap of app
-                        if(network[i].appid==0){
-                            printf("App 0 Node %d finished", i);
-                        }
-                        set_bitmap(i, network[i].appid);
-                        //Check if all nodes of app have finished in bitmap
-                        //If all have been done we have to empty events and ocurred queues, then del app, and call apx_traces
-                        // to laod next app, if not continue
-                        if(check_finished_app(network[i].appid)==1){
-                            d_app(network[i].appid);
-                            apx_traces();
-                        }
                         return ;
                     }
                 }else{
@@ -558,8 +544,12 @@ void generate_pkt(long i) {
                         if (!event_empty(&network[i].events)){
                             event e;
                             while (!event_empty(&network[i].events) && (e=head_event(&network[i].events)).type==RECEPTION){
-                                if (occurred(&network[i].occurs, e))
+                                if (occurred(&network[i].occurs, e)){
                                     rem_head_event(&network[i].events);
+#if (SKIP_CPU_BURSTS==1)
+                                    trace_activity = sim_clock;
+#endif
+                                }
                                 else
                                     break;
                             }
@@ -569,36 +559,14 @@ void generate_pkt(long i) {
                                 packet.length = e.length;
                                 d=e.pid;
                             }else if(event_empty(&network[i].events)){
-                                //change node source to FINISHED
-                                if(i==1566){
-                                    i=i;
-                                }
-                                network[i].source=FINISHED;
-                                ////> change bitmap of app
-                                set_bitmap(i, network[i].appid);
-                                //Check if all nodes of app have finished in bitmap
-                                //If all have been done we have to empty events and ocurred queues, then del app, and call apx_traces
-                                // to load next app, if not continue
-                                if(check_finished_app(network[i].appid)==1){
-                                    d_app(network[i].appid);
-                                    apx_traces();
-                                }
+                                // The app is told, so it can finish and let others start.
+                                mpa_node_finished(i);
                                 return;
                             }else{
                                 return;
                             }
                         }else{
-                            //change node source to FINISHED
-                            network[i].source=FINISHED;
-                            ////> change bitmap of app
-                            set_bitmap(i, network[i].appid);
-                            //Check if all nodes of app have finished in bitmap
-                            //If all have been done we have to empty events and ocurred queues, then del app, and call apx_traces
-                            // to laod next app, if not continue
-                            if(check_finished_app(network[i].appid)==1){
-                                d_app(network[i].appid);
-                                apx_traces();
-                            }
+                            mpa_node_finished(i);
                             return ;
                         }
                     }else{
@@ -661,9 +629,6 @@ void generate_pkt(long i) {
 		pkt_space[pkt] = packet;
 		generate_phits(pkt, iport);
 		packet.size = pkt_len;
-#if (PCOUNT!=0)
-		network[i].pcount+=packet.size;
-#endif
 		if(shotmode)
 			count[i]--;
 	}
@@ -679,8 +644,12 @@ void generate_pkt(long i) {
 * @param i The node in which the data must be generated.
 */
 void data_generation(long i) {
-	if (global_q_u > congestion_limit)
+	if (global_q_u > congestion_limit){
+#if (TRACE_SUPPORT != 0) && (SKIP_CPU_BURSTS==1)
+		trace_activity = sim_clock; // CPU bursts are stalled as well.
+#endif
 		return;
+	}
 	if (i>=nprocs)
 		panic("Generating packets in a undefined node");
 #if (TRACE_SUPPORT != 0)
@@ -688,6 +657,12 @@ void data_generation(long i) {
 		event e;
 		if(!event_empty(&network[i].events) && (e=head_event(&network[i].events)).type==COMPUTATION){
 			do_event(&network[i].events, &e);
+#if (SKIP_CPU_BURSTS==1)
+			if (e.count == e.length)
+				trace_activity = sim_clock;
+			else if (e.count == 1)
+				cpu_burst_started(i, sim_clock + e.length - 1);
+#endif
 		}
 	}
 #endif
@@ -740,10 +715,7 @@ void data_injection(long i) {
 		for (e=0; e<ninj; e++) {
 			ib = &(network[i].qi[e]); // ib is a pointer to inj buffer
 			iq = &(network[i].p[e+p_inj_first].q); // iq is a pointer to inj queue
-			while (queue_space(iq) && inj_queue_len(ib)) {
-				inj_rem_queue(ib, &ph);
-				ins_queue(iq, &ph);
-			}
+			inj_move_queue(ib, iq);
 		}
 	}
 	else {
@@ -897,6 +869,16 @@ void init_injection	(void) {
 		total_shot_size = scount*shotsize;
 }
 
+/**
+* Writes the state of the generation in a checkpoint, or reads it.
+*
+* @param f The checkpoint.
+* @param save TRUE to write the state, FALSE to read it.
+*/
+void injection_checkpoint(FILE *f, bool_t save) {
+	ckp_data(f, next_dest, sizeof(long) * nprocs, save);
+}
+
 void injection_finish(void){
 
 #if (TRACE_SUPPORT != 0)
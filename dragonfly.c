@@ -383,7 +383,7 @@ routing_r dragonfly_rr (long source, long destination) {
     if (source == destination)
         panic("Self-sent packet\n");
 
-    res.rr = alloc(8 * sizeof(long));
+    res.rr = rr_alloc(8);
     res.rr[7] = 0;
     res.size=0;
 
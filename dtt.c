@@ -136,7 +136,7 @@ routing_r dtt_rr (long source, long destination) {
 	long mesh_x, mesh_y, mesh_z, wrapx_x, wrapx_y, wrapx_z,wrapy_x, wrapy_y, wrapy_z,wrapz_x, wrapz_y, wrapz_z;
 	routing_r res;
 
-	res.rr=alloc(ndim*sizeof(long));
+	res.rr=rr_alloc(ndim);
 
 	if (source == destination)
 		panic("Self-sent message");
@@ -461,7 +461,7 @@ routing_r dtt_rr_unidir (long source, long destination) {
 	routing_r res;
 	panic("Not ready to work yet with unidirectional twisted torus");
 /*
-	res.rr=alloc(ndim*sizeof(long));
+	res.rr=rr_alloc(ndim);
 	res.rr[D_X] = 0;
 	if (ndim >= 2)
 		res.rr[D_Y] = 0;
@@ -31,6 +31,87 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #if (TRACE_SUPPORT != 0)
 
+/**
+* A block of chunks for the event queues.
+*/
+typedef struct event_b {
+	event_c c[EVENT_BLOCK];	///< The chunks.
+	struct event_b * next;	///< The next block allocated.
+} event_b;
+
+static event_b * blocks = NULL;		///< All the blocks allocated, freed at once in free_events().
+static event_c * free_chunks = NULL;	///< Chunks not used by any queue.
+
+/**
+* Gets an empty chunk from the pool, allocating a new block when all are in use.
+*
+* @return The chunk.
+*/
+static event_c * get_chunk(void) {
+	event_c *c;
+	event_b *b;
+	long i;
+
+	if (free_chunks == NULL) {
+		b = alloc(sizeof(event_b));
+		b->next = blocks;
+		blocks = b;
+		for (i = EVENT_BLOCK - 1; i >= 0; i--) {
+			b->c[i].next = free_chunks;
+			free_chunks = &b->c[i];
+		}
+	}
+	c = free_chunks;
+	free_chunks = c->next;
+	c->next = NULL;
+	return c;
+}
+
+/**
+* Removes the first event of a queue, returning its chunk to the pool when it is finished.
+*
+* @param q A pointer to the queue.
+*/
+static void advance_head(event_q *q) {
+	event_c *c = q->head;
+
+	prof_count(prof_events);
+	q->first++;
+	if (c == q->tail && q->first == q->last) {
+		q->head = q->tail = NULL;
+		q->first = q->last = 0;
+	}
+	else if (q->first == EVENT_CHUNK) {
+		q->head = c->next;
+		q->first = 0;
+	}
+	else
+		return;
+	c->next = free_chunks;
+	free_chunks = c;
+}
+
+/**
+* Frees the memory of all the event queues. They cannot be used afterwards.
+*/
+void free_events(void) {
+	event_b *b;
+
+	while (blocks != NULL) {
+		b = blocks->next;
+		free(blocks);
+		blocks = b;
+	}
+	free_chunks = NULL;
+}
+
+/**
+* Refills a queue from its feed if it has run out of events.
+*
+* @param q A pointer to the queue.
+*/
+#define feed_events(q) if ((q)->head == NULL && (q)->feed != NULL) fill_events(q)
+
 /**
 * Initializes an event queue.
 *
@@ -39,6 +120,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 void init_event (event_q *q) {
 	q->head = NULL;
 	q->tail = NULL;
+	q->first = 0;
+	q->last = 0;
+	q->feed = NULL;
 }
 
 /**
@@ -48,19 +132,16 @@ void init_event (event_q *q) {
 * @param i the event to be added to q.
 */
 void ins_event (event_q *q, event i) {
-	event_n *e;
-	e=alloc(sizeof(event_n));
-	e->ev=i;
-	e->next = NULL;
-
 	if(q->head==NULL){ // Empty Queue
-		q->head = e;
-		q->tail = e;
+		q->head = q->tail = get_chunk();
+		q->first = q->last = 0;
 	}
-	else{
-		q->tail->next = e;
-		q->tail = e;
+	else if (q->last == EVENT_CHUNK){
+		q->tail->next = get_chunk();
+		q->tail = q->tail->next;
+		q->last = 0;
 	}
+	q->tail->ev[q->last++] = i;
 }
 
 /**
@@ -73,19 +154,15 @@ void ins_event (event_q *q, event i) {
 * @param i A pointer to the event to do.
 */
 void do_event (event_q *q, event *i) {
-	event_n *e;
+	event *e;
+	feed_events(q);
 	if (q->head==NULL)
 		panic("Using event from an empty queue");
-	e = q->head;
-	e->ev.count++;
-	*i = e->ev;
-	if (i->count == i->length){
-		q->head=q->head->next;
-		free (e);
-		if (q->head==NULL)
-			q->tail=NULL;
-
-	}
+	e = &q->head->ev[q->first];
+	e->count++;
+	*i = *e;
+	if (i->count == i->length)
+		advance_head(q);
 }
 
 
@@ -100,24 +177,22 @@ void do_event (event_q *q, event *i) {
 * @param increment the number of times the event has happened.
 */
 void do_event_n_times (event_q *q, event *i, CLOCK_TYPE increment) {
-	event_n *e;
+	event *e;
+	feed_events(q);
 	if (q->head==NULL)
 		panic("Using event from an empty queue");
-	e = q->head;
+	e = &q->head->ev[q->first];
 
-	if (e->ev.type!=i->type ||
-		e->ev.pid!=i->pid ||
-		e->ev.task!=i->task) {
+	if (e->type!=i->type ||
+		e->pid!=i->pid ||
+		e->task!=i->task) {
 			panic("Incorrect event in do_event_n_times");
 		}
 
-	e->ev.count+=increment;
-	if (e->ev.count == e->ev.length){
-		q->head=q->head->next;
-		free (e);
-		if (q->head==NULL)
-			q->tail=NULL;
-	} else 	if (e->ev.count > e->ev.length){
+	e->count+=increment;
+	if (e->count == e->length){
+		advance_head(q);
+	} else 	if (e->count > e->length){
 		panic("Increment in do_event_n_times exceeded the count");
 	}
 }
@@ -129,9 +204,10 @@ void do_event_n_times (event_q *q, event *i, CLOCK_TYPE increment) {
 * @return The first event in the queue (without using nor modifying it).
 */
 event head_event (event_q *q) {
+	feed_events(q);
 	if (q->head==NULL)
 		panic("Getting event from an empty queue");
-	return q->head->ev;
+	return q->head->ev[q->first];
 }
 
 /**
@@ -140,13 +216,10 @@ event head_event (event_q *q) {
 * @param q A pointer to the queue.
 */
 void rem_head_event (event_q *q) {
-	event_n *e;
+	feed_events(q);
 	if (q->head==NULL)
 		panic("Deleting event from an empty queue");
-	e = q->head;
-	q->head=q->head->next;
-	free (e);
-	if (q->head==NULL) q->tail=NULL;
+	advance_head(q);
 }
 
 /**
@@ -156,217 +229,266 @@ void rem_head_event (event_q *q) {
 * @return TRUE if the queue is empty FALSE in other case.
 */
 bool_t event_empty (event_q *q){
+	feed_events(q);
 	return (q->head==NULL);
 }
 
-#if (TRACE_SUPPORT > 1)
+#define OCCUR_MIN 8	///< Initial size of the tables of occurred events.
 
 /**
-* Initializes all ocurred events lists.
-*
-* There is a list in each router for each posible source of messages.
-* Increases memory usage but reduces look-up time for trace driven simulation. For large-scale systems, this can be a limiting factor.
+* Hash of the key of an occurred event: type, source, task & length.
 *
-* @param l A pointer to the list to be initialized.
+* @param i The event.
+* @return The hash.
 */
-void init_occur (event_l **l){
-	int i=0;
-	for (i=0; i<nprocs; i++)
-		(*l)[i].first=NULL;
+static unsigned long occur_hash(event i) {
+	unsigned long long h;
+
+	h = ((unsigned long long)i.pid * 0x9E3779B97F4A7C15ULL) ^ (unsigned long long)i.task;
+	h = (h ^ (h >> 29)) * 0xBF58476D1CE4E5B9ULL;
+	h ^= ((unsigned long long)i.length << 8) ^ (unsigned long long)i.type;
+	h = (h ^ (h >> 32)) * 0x94D049BB133111EBULL;
+	return (unsigned long)(h ^ (h >> 29));
 }
 
 /**
-* Inserts an event's occurrence in an event list.
-*
-* If the event is in the list, then its count is increased. Otherwise a new event is created
-* in the occurred event list.
+* Looks for the entry of an event in a table of occurred events.
 *
-* @param l A pointer to a list.
-* @param i The event to be added.
+* @param h A pointer to the table. It must have, at least, a free entry.
+* @param i The event we are seeking for.
+* @return The entry of the event or, if it is not in the table, the free entry in which it should be.
 */
-void ins_occur (event_l **l, event i){
-	event_n *e = (*l)[i.pid].first;
-	event_n *aux = NULL;
-
-	if (e==NULL) {	// List is Empty
-		// Create a new occurred event
-		aux=alloc(sizeof(event_n));
-		i.count = 1;
-		aux->ev = i;
-		aux->next = (*l)[i.pid].first;
-		(*l)[i.pid].first = aux;
-		return;
-	}
-
-	if (e->ev.type == i.type && e->ev.pid == i.pid &&
-		e->ev.task == i.task && e->ev.length == i.length &&
-		e->ev.count < e->ev.length)	{
-		// The occurence is the first element.
-		e->ev.count++;
-		return;
+static event_o * find_occur(event_h *h, event i) {
+	long k = occur_hash(i) & (h->size - 1);
+	event_o *o;
+
+	while (B_TRUE) {
+		o = &h->t[k];
+		if (o->pid == NULL_PORT ||
+			(o->pid == i.pid && o->task == i.task && o->length == i.length && o->type == i.type))
+			return o;
+		k = (k + 1) & (h->size - 1);
 	}
+}
 
-	while (e->next!=NULL) {
-		if (e->next->ev.type == i.type && e->next->ev.pid == i.pid &&
-			e->next->ev.task == i.task && e->next->ev.length == i.length &&
-			e->next->ev.count < e->next->ev.length) {
-			// Another element in the list
-			e->next->ev.count++;
-			return;
+/**
+* Sets the size of a table of occurred events, moving all its entries.
+*
+* @param h A pointer to the table.
+* @param size The new size. A power of two, larger than the entries in use.
+*/
+static void resize_occur(event_h *h, long size) {
+	event_o *old = h->t;
+	long old_size = h->size, k;
+	event i;
+
+	h->t = alloc(sizeof(event_o) * size);
+	h->size = size;
+	for (k = 0; k < size; k++)
+		h->t[k].pid = NULL_PORT;
+	for (k = 0; k < old_size; k++)
+		if (old[k].pid != NULL_PORT) {
+			i.type = old[k].type;
+			i.pid = old[k].pid;
+			i.task = old[k].task;
+			i.length = old[k].length;
+			*find_occur(h, i) = old[k];
 		}
-		e = e->next;
-	}
-
-	// It is not in the list, so we create a new occurred event
-	aux = alloc(sizeof(event_n));
-	i.count = 1;
-	aux->ev = i;
-	aux->next = (*l)[i.pid].first;
-	(*l)[i.pid].first = aux;
+	free(old);
 }
 
 /**
-* Has an event completely occurred?.
+* Deletes an entry from a table of occurred events.
 *
-* If it has totally occurred, this is, the event is in the list and its count is equal to
-* its length, then it is deleted from the list.
+* The entries after it are moved back, so that no entry is left after a free one in its
+* probing sequence.
 *
-* @param l a pointer to a list.
-* @param i the event we are seeking for.
-* @return TRUE if the event has been occurred, elseway FALSE
+* @param h A pointer to the table.
+* @param o The entry to delete.
 */
-bool_t occurred (event_l **l, event i){
-	event_n *e = (*l)[i.pid].first;
-	event_n *aux;
-
-	if (e==NULL)	// List is Empty
-		return B_FALSE;
-	if (e->ev.type == i.type && e->ev.pid == i.pid && e->ev.count == e->ev.length &&
-		e->ev.task == i.task && e->ev.length == i.length) {
-		aux = e->next;
-		free(e);
-		(*l)[i.pid].first = aux;
-		return B_TRUE;
-	}
-
-	while (e->next!=NULL) {
-		if (e->next->ev.type == i.type && e->next->ev.pid == i.pid &&
-			e->next->ev.task == i.task && e->next->ev.length == i.length &&
-			e->next->ev.count == e->next->ev.length) {
-			// Delete from list
-			aux = e->next->next;
-			free(e->next);
-			e->next = aux;
-			return B_TRUE;
-		}
-		e = e->next;
+static void del_occur(event_h *h, event_o *o) {
+	long mask = h->size - 1;
+	long k = o - h->t, j = k, home;
+	event i;
+
+	while (B_TRUE) {
+		h->t[k].pid = NULL_PORT;
+		do {
+			j = (j + 1) & mask;
+			if (h->t[j].pid == NULL_PORT) {
+				h->used--;
+				return;
+			}
+			i.type = h->t[j].type;
+			i.pid = h->t[j].pid;
+			i.task = h->t[j].task;
+			i.length = h->t[j].length;
+			home = occur_hash(i) & mask;
+		} while (k <= j ? (k < home && home <= j) : (k < home || home <= j));
+		h->t[k] = h->t[j];
+		k = j;
 	}
-	return B_FALSE;
 }
-#endif // Trace support with multilist #occurs
-
-#if (TRACE_SUPPORT == 1)
 
 /**
-* Initializes all ocurred events lists.
+* Initializes a table of occurred events. No memory is used until an event arrives.
 *
-* There is only one list in each router.
+* @param h A pointer to the table to be initialized.
+*/
+void init_occur (event_h *h){
+	h->t = NULL;
+	h->size = 0;
+	h->used = 0;
+}
+
+/**
+* Frees the memory of a table of occurred events, leaving it empty.
 *
-* @param l A pointer to the list to be initialized.
+* @param h A pointer to the table.
 */
-void init_occur (event_l *l){
-	(*l).first=NULL;
+void finish_occur (event_h *h){
+	free(h->t);
+	init_occur(h);
 }
 
 /**
-* Inserts an event's occurrence in an event list.
+* Inserts an event's occurrence in a table of occurred events.
 *
-* If the event is in the list, then its count is increased. Otherwise a new event is created
-* in the occurred event list.
+* If a message with the same key is being received its count is increased. Otherwise
+* a new message starts. When a message has arrived completely it is counted as done.
 *
-* @param l A pointer to a list.
+* @param h A pointer to a table.
 * @param i The event to be added.
 */
-void ins_occur (event_l *l, event i){
-	event_n *e = (*l).first;
-	event_n *aux = NULL;
-
-	if (e==NULL) {	// List is Empty
-		// Create a new occurred event
-		aux=alloc(sizeof(event_n));
-		i.count = 1;
-		aux->ev = i;
-		aux->next = (*l).first;
-		(*l).first = aux;
-		return;
+void ins_occur (event_h *h, event i){
+	event_o *o;
+
+	if (h->t == NULL)
+		resize_occur(h, OCCUR_MIN);
+	else if (4 * (h->used + 1) > 3 * h->size)
+		resize_occur(h, 2 * h->size);
+
+	o = find_occur(h, i);
+	if (o->pid == NULL_PORT) {
+		o->type = i.type;
+		o->pid = i.pid;
+		o->task = i.task;
+		o->length = i.length;
+		o->count = 0;
+		o->done = 0;
+		h->used++;
 	}
-
-	if (e->ev.type == i.type && e->ev.pid == i.pid &&
-		e->ev.task == i.task && e->ev.length == i.length &&
-		e->ev.count < e->ev.length)	{
-		// The occurence is the first element.
-		e->ev.count++;
-		return;
+	if (++o->count == o->length) {
+		o->done++;
+		o->count = 0;
 	}
-
-	while (e->next!=NULL) {
-		if (e->next->ev.type == i.type && e->next->ev.pid == i.pid &&
-			e->next->ev.task == i.task && e->next->ev.length == i.length &&
-			e->next->ev.count < e->next->ev.length) {
-			// Another element in the list
-			e->next->ev.count++;
-			return;
-		}
-		e = e->next;
-	}
-
-	// There is not in the list, so we create a new occurred event
-	aux = alloc(sizeof(event_n));
-	i.count = 1;
-	aux->ev = i;
-	aux->next = (*l).first;
-	(*l).first = aux;
 }
 
 /**
 * Has an event completely occurred?.
 *
-* If it has totally occurred, this is, the event is in the list and its count is equal to
-* its length, then it is deleted from the list.
+* If it has totally occurred, this is, a message with its key has been completely
+* received, then it is deleted from the table.
+*
+* @param h a pointer to a table.
+* @param i the event we are seeking for.
+* @return TRUE if the event has been occurred, elseway FALSE
+*/
+bool_t occurred (event_h *h, event i){
+	event_o *o;
+
+	if (h->used == 0)
+		return B_FALSE;
+	o = find_occur(h, i);
+	if (o->pid == NULL_PORT || o->done == 0)
+		return B_FALSE;
+	if (--o->done == 0 && o->count == 0)
+		del_occur(h, o);
+	return B_TRUE;
+}
+
+/**
+* Has an event completely occurred? Unlike occurred(), the table is not changed.
 *
-* @param l a pointer to a list.
+* @param h a pointer to a table.
 * @param i the event we are seeking for.
 * @return TRUE if the event has been occurred, elseway FALSE
 */
-bool_t occurred (event_l *l, event i){
-	event_n *e = (*l).first;
-	event_n *aux;
+bool_t peek_occurred (event_h *h, event i){
+	event_o *o;
 
-	if (e==NULL)	// List is Empty
+	if (h->used == 0)
 		return B_FALSE;
-	if (e->ev.type == i.type && e->ev.pid == i.pid && e->ev.count == e->ev.length &&
-		e->ev.task == i.task && e->ev.length == i.length) {
-		aux = e->next;
-		free(e);
-		(*l).first = aux;
-		return B_TRUE;
+	o = find_occur(h, i);
+	return (o->pid != NULL_PORT && o->done > 0);
+}
+
+/**
+* Writes the events of a queue in a checkpoint, or reads them.
+*
+* The feed of the queue is not written here, but with the trace. When reading, the events
+* in the queue are replaced.
+*
+* @param f The checkpoint.
+* @param q A pointer to the queue.
+* @param save TRUE to write the events, FALSE to read them.
+*
+* @see trace_checkpoint
+*/
+void events_checkpoint(FILE *f, event_q *q, bool_t save) {
+	event_c *c;
+	event e;
+	long n = 0, k;
+
+	if (save) {
+		for (c = q->head; c != NULL; c = c->next)
+			n += ((c == q->tail) ? q->last : EVENT_CHUNK) - ((c == q->head) ? q->first : 0);
+		ckp_var(f, n, save);
+		for (c = q->head; c != NULL; c = c->next)
+			for (k = (c == q->head) ? q->first : 0; k < ((c == q->tail) ? q->last : EVENT_CHUNK); k++)
+				ckp_var(f, c->ev[k], save);
+	}
+	else {
+		while ((c = q->head) != NULL) {
+			q->head = c->next;
+			c->next = free_chunks;
+			free_chunks = c;
+		}
+		q->tail = NULL;
+		q->first = q->last = 0;
+		ckp_var(f, n, save);
+		for (k = 0; k < n; k++) {
+			ckp_var(f, e, save);
+			ins_event(q, e);
+		}
 	}
+}
 
-	while (e->next!=NULL) {
-		if (e->next->ev.type == i.type && e->next->ev.pid == i.pid &&
-			e->next->ev.task == i.task && e->next->ev.length == i.length &&
-			e->next->ev.count == e->next->ev.length) {
-			// Delete from list
-			aux = e->next->next;
-			free(e->next);
-			e->next = aux;
-			return B_TRUE;
+/**
+* Writes a table of occurred events in a checkpoint, or reads it.
+*
+* The entries are written in their places, so the table is read as it was.
+*
+* @param f The checkpoint.
+* @param h A pointer to the table.
+* @param save TRUE to write the table, FALSE to read it.
+*/
+void occur_checkpoint(FILE *f, event_h *h, bool_t save) {
+	long size = h->size;
+
+	ckp_var(f, size, save);
+	if (!save) {
+		if (size < 0 || (size & (size - 1)))
+			panic("Wrong table of occurred events in checkpoint");
+		finish_occur(h);
+		if (size > 0) {
+			h->t = alloc(sizeof(event_o) * size);
+			h->size = size;
 		}
-		e = e->next;
 	}
-	return B_FALSE;
+	ckp_var(f, h->used, save);
+	ckp_data(f, h->t, sizeof(event_o) * size, save);
 }
-#endif // Trace support with single list #occurs
 
 #endif//TRACE_SUPPORT
 
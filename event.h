@@ -50,30 +50,61 @@ typedef struct event {
 	CLOCK_TYPE count;		///< The number of packets sent/arrived. Number of elapsed cycles when running.
 } event;
 
+#define EVENT_CHUNK 64	///< Events in each chunk of an event queue.
+#define EVENT_BLOCK 64	///< Chunks allocated at once for the event queues.
+
 /**
-* Structure that defines a node for event queue & lists.
+* Structure that defines a chunk of an event queue: an array of consecutive events.
 * @see event_q
-* @see event_l
 */
-typedef struct event_n {
-	event ev;				///< The event in this position.
-	struct event_n * next;	///< The next node in the list/queue.
-} event_n;
+typedef struct event_c {
+	event ev[EVENT_CHUNK];	///< The events in this chunk.
+	struct event_c * next;	///< The next chunk in the queue.
+} event_c;
 
 /**
 * Structure that defines an event queue.
+*
+* The events are kept in a list of chunks, taken from a common pool, so there is no
+* allocation for each event and the events of a node are mostly contiguous.
+*
+* When the queue has a feed, the events are not inserted beforehand: the queue is
+* refilled from the feed whenever it runs out of events.
 */
 typedef struct event_q {
-	event_n *head;	///< A pointer to the first event node (for removing).
-	event_n *tail;	///< A pointer to the last event node (for enqueuing).
+	event_c *head;	///< A pointer to the first chunk (for removing).
+	event_c *tail;	///< A pointer to the last chunk (for enqueuing).
+	long first;		///< Position of the first event in the head chunk.
+	long last;		///< Position after the last event in the tail chunk.
+	struct event_feed *feed;	///< Where the rest of the events are. NULL when all of them are in the queue.
 } event_q;
 
 /**
-* Structure that defines a list of events.
+* Structure that defines an entry of a table of occurred events.
+*
+* All the messages with the same type, source, task & length share the entry: it counts
+* the packets arrived of the one being received and how many have been completely received.
+*/
+typedef struct event_o {
+	event_t type;	///< Type of the event.
+	long pid;		///< The other node (processor id). #NULL_PORT if the entry is free.
+	long task;		///< An id for distinguish messages.
+	CLOCK_TYPE length;	///< Length of the message in packets.
+	CLOCK_TYPE count;	///< The number of packets arrived of the message being received.
+	long done;		///< The number of messages completely received, not used yet.
+} event_o;
+
+/**
+* Structure that defines a table of occurred events.
+*
+* It is a hash table with open addressing (linear probing), so its size depends on the
+* messages in flight towards the node, not on the number of nodes.
 */
-typedef struct event_l {
-	event_n * first;	///< A pointer to the first element of the list.
-} event_l;
+typedef struct event_h {
+	event_o * t;	///< The entries. NULL until the first event arrives.
+	long size;		///< Number of entries. A power of two.
+	long used;		///< Number of entries in use.
+} event_h;
 
 #endif /* TRACE_SUPPORT */
 #endif /* _event */
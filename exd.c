@@ -374,7 +374,6 @@ port_type generate_FSIN_packet(unsigned long src, unsigned long dst, long id_eth
 	packet.size = packet_size_in_phits; // pkt_len;
 	packet.tt = sim_clock;
 	inj_phit_count += packet.size;
-	packet.rr = calc_rr(packet.from, packet.to);
 	packet.inj_time = sim_clock;  // Some additional info
 	packet.n_hops = 0;
 	packet.id_trama = id_ethernet_frame;
@@ -393,6 +392,7 @@ port_type generate_FSIN_packet(unsigned long src, unsigned long dst, long id_eth
 		}*/
 		return NULL_PORT;
 	}
+	packet.rr = calc_rr(packet.from, packet.to);	// Once there is room for it, so it is not lost.
 	pkt=get_pkt();
 	packet_aux = &pkt_space[pkt];
 	*packet_aux = packet;
@@ -301,7 +301,7 @@ routing_r fattree_rr (long source, long destination) {
 		nhops++;
 		k_n=k_n*k;
 	}
-	res.rr=alloc(2*nhops*sizeof(routing_r));
+	res.rr=rr_alloc(2*nhops);
 	res.rr[0]=0; // first hop is always up the NIC
 
 	for (k=1; k<nhops; k++){
@@ -365,7 +365,7 @@ routing_r thintree_rr_rnd (long source, long destination) {
 		sgDown=sgDown*stDown;
 	}
 
-	res.rr=alloc(2*nhops*sizeof(routing_r));
+	res.rr=rr_alloc(2*nhops);
 	res.rr[0]=0; // first hop is always up the NIC
 
 	for (k=1; k<nhops; k++){
@@ -402,7 +402,7 @@ routing_r thintree_rr (long source, long destination) {
 		sgDown=sgDown*stDown;
 	}
 
-	res.rr=alloc(2*nhops*sizeof(routing_r));
+	res.rr=rr_alloc(2*nhops);
 	res.rr[0]=0; // first hop is always up the NIC
 
 	for (k=1; k<nhops; k++){
@@ -439,7 +439,7 @@ routing_r thintree_rr_src (long source, long destination) {
 		sgDown=sgDown*stDown;
 	}
 
-	res.rr=alloc(2*nhops*sizeof(routing_r));
+	res.rr=rr_alloc(2*nhops);
 	res.rr[0]=0; // first hop is always up the NIC
 
 	for (k=1; k<nhops; k++){
@@ -477,7 +477,7 @@ routing_r thintree_rr_dst (long source, long destination) {
 		sgDown=sgDown*stDown;
 	}
 
-	res.rr=alloc(2*nhops*sizeof(routing_r));
+	res.rr=rr_alloc(2*nhops);
 	res.rr[0]=0; // first hop is always up the NIC
 
 	for (k=1; k<nhops; k++){
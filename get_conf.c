@@ -50,6 +50,9 @@ static void set_default_conf(void);
 static void get_option(char *);
 static void get_conf_file(char *);
 static void verify_conf(void);
+static long ring_size(long n);
+static void set_load(void);
+static void verify_sweep(void);
 long *nodes_per_dim;
 long *bub;
 char *mpa_file;
@@ -131,6 +134,22 @@ static literal_t options_l[] = {
 	{ 62, "cpu_units"},
 	{ 63, "cam_policy"},
 	{ 64, "vc_inj"},
+	{ 65, "threads"},
+	{ 66, "worklist"},
+	{ 67, "profile"},
+	{ 68, "trace_lookahead"},
+	{ 69, "trace_threads"},
+	{ 70, "collective_algorithm"},
+	{ 71, "mpa_queue"},
+	{ 72, "checkpoint"},
+	{ 73, "checkpoint_period"},
+	{ 74, "restore"},
+	{ 75, "sweep"},
+	{ 76, "sweep_param"},
+	{ 77, "sweep_jobs"},
+	{ 78, "sweep_warmup"},
+	{ 79, "cam_threads"},
+	{ 80, "cam_cache"},
 	{ 100, "fsin_cycle_relation"},
 	{ 101, "simics_cycle_relation"},
 	{ 103, "serv_addr"},
@@ -189,6 +208,38 @@ literal_t cpu_units_l[] = {
 	LITERAL_END
 };
 
+/**
+* All the algorithms for expanding the collectives of the traces.
+* @see literal.c
+*/
+literal_t coll_alg_l[] = {
+	{ COLL_BINOMIAL,	"binomial"},
+	{ COLL_RDOUBLING,	"recursive_doubling"},
+	{ COLL_RDOUBLING,	"rdoubling"},
+	{ COLL_RING,		"ring"},
+	LITERAL_END
+};
+
+/**
+* All the policies for starting the apps of a mpa mix.
+* @see literal.c
+*/
+literal_t mpa_queue_l[] = {
+	{ MPA_FCFS,		"fcfs"},
+	{ MPA_BACKFILL,	"backfill"},
+	LITERAL_END
+};
+
+/**
+* All the parameters that can be swept.
+* @see literal.c
+*/
+literal_t sweep_param_l[] = {
+	{ SWEEP_LOAD,		"load"},
+	{ SWEEP_PATTERN,	"tpattern"},
+	LITERAL_END
+};
+
 /**
 * All the topologies allowed are specified here.
 * @see literal.c
@@ -906,6 +957,69 @@ void get_option(char * option) {
                 if(!literal_value(vc_inj_l, value, (int*) &vc_inj))
                      panic("get_conf: Unknown VC injection mode");
                 break;
+    case 65:
+		sscanf(value, "%ld", &threads);
+		break;
+    case 66:
+		sscanf(value, "%ld", &aux);
+		if (aux)
+			worklist = B_TRUE;
+		else
+			worklist = B_FALSE;
+		break;
+    case 67:
+		sscanf(value, "%ld", &aux);
+		if (aux)
+			profile = B_TRUE;
+		else
+			profile = B_FALSE;
+		break;
+    case 68:
+		sscanf(value, "%ld", &trace_lookahead);
+		break;
+    case 69:
+		sscanf(value, "%ld", &trace_threads);
+		break;
+    case 70:
+		if(!literal_value(coll_alg_l, value, (int*) &coll_alg))
+			panic("get_conf: Unknown collective algorithm");
+		break;
+    case 71:
+		if(!literal_value(mpa_queue_l, value, (int*) &mpa_queue))
+			panic("get_conf: Unknown mpa queue policy");
+		break;
+    case 72:
+		sscanf(value, "%255s", checkpoint_file);
+		break;
+    case 73:
+		sscanf(value, "%"SCAN_CLOCK, &checkpoint_period);
+		break;
+    case 74:
+		sscanf(value, "%255s", restore_file);
+		break;
+    case 75:
+		sscanf(value, "%1023s", sweep_values);
+		break;
+    case 76:
+		if(!literal_value(sweep_param_l, value, (int*) &sweep_param))
+			panic("get_conf: Unknown parameter to sweep");
+		break;
+    case 77:
+		sscanf(value, "%ld", &sweep_jobs);
+		break;
+    case 78:
+		sscanf(value, "%ld", &aux);
+		if (aux)
+			sweep_warmup = B_TRUE;
+		else
+			sweep_warmup = B_FALSE;
+		break;
+    case 79:
+		sscanf(value, "%ld", &cam_threads);
+		break;
+    case 80:
+		sscanf(value, "%255s", cam_cache_file);
+		break;
 
 #if (EXECUTION_DRIVEN != 0)
 	case 100:
@@ -933,6 +1047,94 @@ void get_option(char * option) {
 	}
 }
 
+/**
+* Calculates the size of a queue ring.
+*
+* @param n The number of items the ring must hold.
+* @return The smallest power of two not less than n.
+*/
+static long ring_size(long n) {
+	long r = 1;
+
+	while (r < n)
+		r <<= 1;
+	return r;
+}
+
+/**
+* Calculates the values used to inject from #load.
+*/
+static void set_load(void) {
+#if (BIMODAL_SUPPORT != 0)
+	lm_prob = lm_percent/(msglength-(lm_percent*(msglength-1)));
+	aload = (long) (load * RAND_MAX * (msglength * (1-lm_prob) + lm_prob) / (pkt_len * msglength));
+	lm_load = aload * lm_prob ;
+#else
+	// is the same as above when msglength=1 & lm_percent=0 (bimodal: off)
+	aload = (long) ( (load/pkt_len) * RAND_MAX);
+#endif /* BIMODAL */
+
+	if (aload<0) //Because an overflow
+		aload = RAND_MAX;
+}
+
+/**
+* Verifies the configuration of a sweep & each one of its values.
+*
+* The points of a sweep share the network, so only synthetic traffic can be swept.
+*/
+static void verify_sweep(void) {
+	char values[1024];
+	char *value, *param;
+	traffic_pattern_t p;
+	double l;
+
+	if (pattern == TRACE || pattern == MPA || EXECUTION_DRIVEN)
+		panic("Sweeps are only for synthetic traffic");
+	if (sweep_jobs < 0)
+		panic("sweep_jobs must be 0 or positive");
+	if (checkpoint_file[0] != '\0')
+		panic("The points of a sweep can not write checkpoints");
+	if (sweep_warmup && (shotmode || restore_file[0] != '\0'))
+		panic("A shared warm-up needs a batch simulation from scratch");
+	if (sweep_warmup && threads > 0)
+		panic("A shared warm-up needs the classic engine (threads=0)");
+
+	strcpy(values, sweep_values);
+	for (value = strtok(values, ","); value; value = strtok(NULL, ",")) {
+		if (sweep_param == SWEEP_LOAD) {
+			if (sscanf(value, "%lf", &l) != 1 || l < 0.0)
+				panic("Wrong load in sweep");
+		}
+		else {
+			param = strchr(value, '_');
+			if (param)
+				*param = '\0';
+			if (!literal_value(pattern_l, value, (int*) &p))
+				panic("Unknown traffic pattern in sweep");
+			if (p == TRACE || p == MPA)
+				panic("Sweeps are only for synthetic traffic");
+		}
+	}
+}
+
+/**
+* Sets the value of #sweep_param for a point of a sweep.
+*
+* The value is taken as that of the option, and the values derived from it are calculated again.
+*
+* @param value The value of the point.
+*/
+void set_sweep_point(char *value) {
+	char option[1100];
+	char *name;
+
+	literal_name(sweep_param_l, &name, sweep_param);
+	sprintf(option, "%s=%s", name, value);
+	get_option(option);
+	set_load();
+}
+
 /**
 * Verifies the simulation configuration.
 *
@@ -947,6 +1149,44 @@ void verify_conf(void) {
 		panic("Illegal bubble size");
 	tr_ql = buffer_cap * pkt_len + 1;
 	inj_ql = binj_cap * pkt_len + 1;
+#if (PACKET_QUEUES != 0)
+	tr_qd = ring_size(buffer_cap + 1);
+	inj_qd = ring_size(binj_cap + 1);
+#else
+	tr_qd = ring_size(tr_ql - 1);
+	inj_qd = ring_size(inj_ql - 1);
+#endif
+
+	if (threads < 0)
+		panic("verify_conf: Illegal number of threads");
+#if (THREADS == 0)
+	if (threads > 0){
+		printf("WARNING: Compiled without thread support\n");
+		printf("         Setting threads to 0!!!\n");
+		threads = 0;
+	}
+#endif
+	if (cam_threads < 0)
+		panic("cam_threads must be 0 or positive");
+#if (THREADS == 0)
+	if (cam_threads > 1){
+		printf("WARNING: Compiled without thread support\n");
+		printf("         Setting cam_threads to 1!!!\n");
+		cam_threads = 1;
+	}
+#endif
+	if (worklist && timeout_upper_limit>0){
+		printf("WARNING: Timeout-based congestion detection needs all the routers every cycle\n");
+		printf("         Disabling the worklist!!!\n");
+		worklist = B_FALSE;
+	}
+#if (PROFILE == 0)
+	if (profile){
+		printf("WARNING: Compiled without profiler support\n");
+		printf("         Setting profile to 0!!!\n");
+		profile = B_FALSE;
+	}
+#endif
 
 	if (topo == ICUBE && nways!=2){
 		printf("WARNING: only bidirectional icubes implemented\n");
@@ -1276,6 +1516,17 @@ void verify_conf(void) {
 				panic("Diagonal placement only for 2D cube topologies and 1 instance");
 		if (trace_nodes*trace_instances>nprocs)
 			panic("Too many nodes and/or instances for this trace. There are more tasks than nodes");
+		if (trace_lookahead<0)
+			panic("trace_lookahead must be 0 or positive");
+		if (trace_threads<0)
+			panic("trace_threads must be 0 or positive");
+#if (THREADS == 0)
+		if (trace_threads>1){
+			printf("WARNING: Compiled without thread support\n");
+			printf("         Setting trace_threads to 1!!!\n");
+			trace_threads=1;
+		}
+#endif
 	}
 
 	if (req_mode > TWO_OR_MORE_REQUIRED && nchan < 2)
@@ -1298,20 +1549,18 @@ void verify_conf(void) {
 			shotsize = (nprocs-1);
 	}
 
+	if (checkpoint_period < 0)
+		panic("checkpoint_period must be 0 or positive");
+	if ((shotmode || EXECUTION_DRIVEN) && (checkpoint_file[0] != '\0' || restore_file[0] != '\0'))
+		panic("Checkpoints are not supported in shot mode nor in execution-driven mode");
+
+	if (sweep_values[0] != '\0')
+		verify_sweep();
+
 	if (max_conv_time==0)
 		max_conv_time = (CLOCK_TYPE) 1000000L; // Should have converged in less than a million cycles.
 
-#if (BIMODAL_SUPPORT != 0)
-	lm_prob = lm_percent/(msglength-(lm_percent*(msglength-1)));
-	aload = (long) (load * RAND_MAX * (msglength * (1-lm_prob) + lm_prob) / (pkt_len * msglength));
-	lm_load = aload * lm_prob ;
-#else
-	// is the same as above when msglength=1 & lm_percent=0 (bimodal: off)
-	aload = (long) ( (load/pkt_len) * RAND_MAX);
-#endif /* BIMODAL */
-
-	if (aload<0) //Because an overflow
-		aload = RAND_MAX;
+	set_load();
 
 	trigger = trigger_rate * RAND_MAX;
 	trigger_dif = 1 + trigger_max - trigger_min;
@@ -1412,6 +1661,13 @@ void set_default_conf (void) {
 	binj_cap = 4;
 	tr_ql = buffer_cap * pkt_len + 1;
 	inj_ql = binj_cap * pkt_len + 1;
+#if (PACKET_QUEUES != 0)
+	tr_qd = ring_size(buffer_cap + 1);
+	inj_qd = ring_size(binj_cap + 1);
+#else
+	tr_qd = ring_size(tr_ql - 1);
+	inj_qd = ring_size(inj_ql - 1);
+#endif
 
 	sk_xy = sk_xz = sk_yx = sk_yz = sk_zx = sk_zy = 0;
 
@@ -1448,6 +1704,17 @@ void set_default_conf (void) {
 	max_conv_time= (CLOCK_TYPE) 25000L;
 	trace_nodes=0;
 	trace_instances=0;
+	trace_lookahead=0;
+	trace_threads=0;
+	coll_alg=COLL_BINOMIAL;
+	mpa_queue=MPA_FCFS;
+	checkpoint_file[0]='\0';
+	checkpoint_period=0;
+	restore_file[0]='\0';
+	sweep_values[0]='\0';
+	sweep_param=SWEEP_LOAD;
+	sweep_jobs=0;
+	sweep_warmup=B_FALSE;
     cpu_units=UNIT_NANOSECONDS;
     link_bw=10000; // 10 Gbps
 	samples=10;
@@ -1472,7 +1739,12 @@ void set_default_conf (void) {
 	cam_policy_params[0] = 1;
 	cam_policy_params[1] = -1;
 	cam_policy_params[2] = -1;
+	cam_threads = 0;
+	cam_cache_file[0] = '\0';
 	vc_inj = VC_INJ_ZERO;
+	threads = 0;
+	worklist = B_FALSE;
+	profile = B_FALSE;
 
 	nnics=1;
     mpa_file= DEFAULT_MPA_FILE;
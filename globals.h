@@ -35,6 +35,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "batch.h"
 #include "graph.h"
 #include "spanning_tree.h"
+#include "profile.h"
+#include "checkpoint.h"
 
 #include <math.h>
 #include <time.h>
@@ -53,6 +55,9 @@ extern long nnics;
 extern long n_ports;
 
 extern long r_seed;
+extern long threads;
+extern bool_t worklist;
+extern bool_t profile;
 extern long nodes_x, nodes_y, nodes_z;
 extern long *nodes_per_dim;
 extern long binj_cap;
@@ -157,8 +162,12 @@ extern cam_policy_t cam_policy;
 extern vc_inj_t vc_inj;
 extern cam_ports_t cam_ports;
 extern long cam_policy_params[3];
+extern long cam_threads;
+extern char cam_cache_file[256];
 extern traffic_pattern_t pattern;
 extern cpu_units_t cpu_units;
+extern coll_alg_t coll_alg;
+extern mpa_queue_t mpa_queue;
 extern cons_mode_t cons_mode;
 extern arb_mode_t arb_mode;
 extern req_mode_t req_mode;
@@ -168,10 +177,13 @@ extern placement_t placement;
 extern long shift_plc;
 extern long trace_nodes;
 extern long trace_instances;
+extern long trace_lookahead;
+extern long trace_threads;
 extern char placefile[128];
 
 #if (SKIP_CPU_BURSTS==1)
 extern CLOCK_TYPE skipped_cycles, skipped_periods;
+extern CLOCK_TYPE trace_activity;
 #endif
 
 extern bool_t drop_packets;
@@ -203,7 +215,7 @@ extern double acum_hops;
 extern long nodes_per_switch;
 extern long links_per_direction;
 
-extern long pkt_len, phit_len, buffer_cap, tr_ql, inj_ql;
+extern long pkt_len, phit_len, buffer_cap, tr_ql, inj_ql, tr_qd, inj_qd;
 
 extern dim * port_coord_dim;
 extern way * port_coord_way;
@@ -213,6 +225,13 @@ extern packet_t * pkt_space;
 extern long pkt_max;
 
 extern char trcfile[256];
+extern char checkpoint_file[256];
+extern char restore_file[256];
+extern CLOCK_TYPE checkpoint_period;
+extern char sweep_values[1024];
+extern sweep_param_t sweep_param;
+extern long sweep_jobs;
+extern bool_t sweep_warmup;
 
 extern bool_t go_on;
 extern bool_t interrupted;
@@ -239,6 +258,7 @@ void injection_finish(void);
 void data_generation(long i);
 void data_injection(long i);
 void datagen_oneshot(bool_t reset);
+void injection_checkpoint(FILE *f, bool_t save);
 
 void generate_pkt(long i);
 port_type select_input_port_shortest(long i, long dest);
@@ -323,6 +343,31 @@ void consume_multiple(long i);
 void advance(long n, long p);
 void data_movement_direct(bool_t inject);
 void data_movement_indirect(bool_t inject);
+void route_router_direct(long i);
+void route_router_indirect(long i);
+void move_router_direct(long i);
+void move_router_indirect(long i);
+void move_phits_direct(void);
+void move_phits_indirect(void);
+void worklist_init(void);
+void worklist_finish(void);
+void activate_router(long i);
+long next_active_router(long i);
+void wake_source(long i);
+void generate_pending_sources(void);
+void move_active_routers(void);
+void data_movement_worklist(bool_t inject);
+void worklist_checkpoint(FILE *f, bool_t save);
+
+#if (THREADS != 0)
+/* In threads.c */
+void rng_streams_init(void);
+void threads_init(void);
+void threads_finish(void);
+void threads_free_pkt(unsigned long n);
+void data_movement_threads(bool_t inject);
+void threads_checkpoint(FILE *f, bool_t save);
+#endif /* THREADS */
 
 /* In init_functions.c */
 void init_functions (void);
@@ -347,6 +392,7 @@ void router_init(void);
 void router_finish(void);
 void init_network(void);
 void finish_network(void);
+void router_checkpoint(FILE *f, long i, bool_t save);
 void coords (long ad, long *coord);
 void coords_icube (long ad, long *cx, long *cy, long *cz);
 
@@ -404,11 +450,15 @@ extern literal_t atype_l[];
 extern literal_t ctype_l[];
 extern literal_t pattern_l[];
 extern literal_t cpu_units_l[];
+extern literal_t coll_alg_l[];
+extern literal_t mpa_queue_l[];
+extern literal_t sweep_param_l[];
 extern literal_t topology_l[];
 extern literal_t injmode_l[];
 extern literal_t placement_l[];
 
 void get_conf(long, char **);
+void set_sweep_point(char *value);
 
 /* In print_results.c */
 void print_headers(void);
@@ -417,9 +467,15 @@ void print_results(time_t, time_t);
 void results_partial(void);
 
 /* In batch.c */
+void warm_up(void);
 void save_batch_results();
 void print_batch_results(batch_t *b);
 void print_batch_results_vast(batch_t *b);
+void batch_checkpoint(FILE *f, bool_t save);
+
+/* In sweep.c */
+bool_t run_sweep(void);
+void sweep_done(void);
 
 /* In circulant.c */
 extern long step;	// 2nd dimension of a circulant graph
@@ -436,26 +492,6 @@ extern long k_inv;
 /* In dtt.c */
 extern long sk_xy, sk_xz, sk_yx, sk_yz, sk_zx, sk_zy; // Skews for twisted torus
 
-/* In mpa.c */
-struct AppLinkedList{
-    char * filename;
-    long running;
-    long id;
-    long nodes;
-    CLOCK_TYPE ini_clock;
-    CLOCK_TYPE end_clock;
-    long * node_list;
-    long * node_bmp; //node bitmap
-    struct appnode *next;
-};typedef struct AppLinkedList *appnode;
-extern appnode head;
-appnode addapp(appnode head, char *name, long nodes, long *nodelist, long id);
-int check_node_disp(long *nodelist, long nodes);
-void set_bitmap(long node, long id);
-int check_finished_app(long id);
-void d_app(long id);
-
-
 /* In queue.c */
 void init_queue (queue *q);
 
@@ -464,13 +500,32 @@ void pkt_init();
 void pkt_finish();
 void free_pkt(unsigned long n);
 unsigned long get_pkt();
+long pkts_in_use();
+void rr_init();
+long * rr_alloc(long n);
+void rr_free(long * rr);
+void packet_checkpoint(FILE *f, packet_t *p, bool_t save);
+void pkt_checkpoint(FILE *f, bool_t save);
 
 #if (TRACE_SUPPORT != 0)
  /* In trace.c */
  void read_trace();
  void trace_finish();
+ void fill_events(event_q *q);
  void run_network_trc();
- void apx_traces();
+#if (SKIP_CPU_BURSTS==1)
+ void cpu_burst_started(long node, CLOCK_TYPE end);
+#endif
+ CLOCK_TYPE msg_packets(long size);
+ CLOCK_TYPE cpu_cycles(long length, cpu_units_t units);
+ void trace_checkpoint(FILE *f, bool_t save);
+
+/* In mpa.c */
+ void mpa_init(void);
+ void mpa_node_finished(long node);
+ bool_t mpa_pending(void);
+ void mpa_finish(void);
+ void mpa_checkpoint(FILE *f, bool_t save);
 
 /* In event.c */
  void init_event (event_q *q);
@@ -480,20 +535,16 @@ unsigned long get_pkt();
  event head_event (event_q *q);
  void rem_head_event (event_q *q);
  bool_t event_empty (event_q *q);
+ void free_events(void);
+ void init_occur (event_h *h);
+ void finish_occur (event_h *h);
+ void ins_occur (event_h *h, event i);
+ bool_t occurred (event_h *h, event i);
+ bool_t peek_occurred (event_h *h, event i);
+ void events_checkpoint(FILE *f, event_q *q, bool_t save);
+ void occur_checkpoint(FILE *f, event_h *h, bool_t save);
 #endif /* TRACE common */
 
-#if (TRACE_SUPPORT > 1)
- void init_occur (event_l **l);
- void ins_occur (event_l **l, event i);
- bool_t occurred (event_l **l, event i);
-#endif /* TRACE multilist */
-
-#if (TRACE_SUPPORT == 1)
- void init_occur (event_l *l);
- void ins_occur (event_l *l, event i);
- bool_t occurred (event_l *l, event i);
-#endif /* TRACE single list */
-
 #if (EXECUTION_DRIVEN != 0)
   extern long fsin_cycle_relation;
   extern long simics_cycle_relation;
@@ -106,16 +106,13 @@ void create_graph(){
 				network[i].op_i[paux] = ESCAPE;
 			}
 		}
-
-		if(routing == CAM_ROUTING)
-			fill_cam(i, graph);
 	}
-	if(routing == SPANNING_TREE_ROUTING)
+	if(routing == CAM_ROUTING)
+		fill_cams(graph);
+	else if(routing == SPANNING_TREE_ROUTING)
 		create_spanning_trees(nchan, stDown);
 
-	for(i = 0; i < nswitches; i++)
-		free(graph[i].edge);
-	free(graph);
+	free_graph(graph);
 }
 
 /**
@@ -129,6 +126,8 @@ void create_graph(){
 routing_r graph_rr_static (long source, long destination) {
 
 	long i, p_src, p_dst, sw_src, sw_dst, current_path, length;
+	cam_port_t *ports;
+	cam_t *c;
 	routing_r res;
 
 	if (source == destination)
@@ -139,16 +138,18 @@ routing_r graph_rr_static (long source, long destination) {
 	sw_src = ((source / stDown) * nnics) + nprocs + p_src;
 	sw_dst = ((destination / stDown) * nnics) + p_src;
 	//printf("S: %ld D: %ld SS: %ld SD: %ld\n", source, destination, sw_src, sw_dst);
-	current_path = network[sw_src].cam[sw_dst].l_path++;
-	length = network[sw_src].cam[sw_dst].ports[current_path][0];
-	res.rr = alloc((length + 2) * sizeof(long));
+	c = network[sw_src].cam;
+	current_path = c->l_path[sw_dst]++;
+	length = cam_path_len(c, sw_dst, current_path);
+	ports = cam_path(c, sw_dst, current_path);
+	res.rr = rr_alloc(length + 2);
 	res.rr[0] = p_src;
 	res.rr[length + 1] = p_dst;
 	for(i = 0; i < length; i++){
-		res.rr[i + 1] =  network[sw_src].cam[sw_dst].ports[current_path][i + 1];
+		res.rr[i + 1] = ports[i];
 	}
 	res.size = length + 2;
-	network[sw_src].cam[sw_dst].l_path %= network[sw_src].cam[sw_dst].n_paths;
+	c->l_path[sw_dst] %= cam_entries(c, sw_dst);
 
 	return(res);
 }
@@ -164,6 +165,8 @@ routing_r graph_rr_static (long source, long destination) {
 routing_r graph_rnd_static (long source, long destination) {
 
 	long i, p_src, p_dst, sw_src, sw_dst, current_path, length;
+	cam_port_t *ports;
+	cam_t *c;
 	routing_r res;
 
 	if (source == destination)
@@ -173,13 +176,15 @@ routing_r graph_rnd_static (long source, long destination) {
 	p_dst = (destination) % stDown;
 	sw_src = ((source / stDown) * nnics) + nprocs + p_src;
 	sw_dst = ((destination / stDown) * nnics) + p_src;
-	current_path = rand() % network[sw_src].cam[sw_dst].n_paths;
-	length = network[sw_src].cam[sw_dst].ports[current_path][0];
-	res.rr = alloc((length + 2) * sizeof(long));
+	c = network[sw_src].cam;
+	current_path = rand() % cam_entries(c, sw_dst);
+	length = cam_path_len(c, sw_dst, current_path);
+	ports = cam_path(c, sw_dst, current_path);
+	res.rr = rr_alloc(length + 2);
 	res.rr[0] = p_src;
 	res.rr[length + 1] = p_dst;
 	for(i = 0; i < length; i++){
-		res.rr[i + 1] =  network[sw_src].cam[sw_dst].ports[current_path][i + 1];
+		res.rr[i + 1] = ports[i];
 	}
 	res.size = length + 2;
 
@@ -203,13 +208,48 @@ routing_r graph_rr_adaptive (long source, long destination) {
 	if (source == destination)
 		panic("Self-sent packet");
 
-	res.rr = alloc((diameter_r + 1)* sizeof(long));;
+	res.rr = rr_alloc(diameter_r + 1);
 	res.rr[0] = diameter_r + 1;
 	res.size = 0;
 
 	return(res);
 }
 
+/**
+ * Makes a copy of a graph, with all its nodes & edges.
+ *
+ * @param graph The graph to copy.
+ * @return The copy, to be freed with free_graph().
+ */
+graph_t *copy_graph(graph_t *graph){
+
+	long i, j;
+	graph_t *res;
+
+	res = alloc(nswitches * sizeof(graph_t));
+	for(i = 0; i < nswitches; i++){
+		res[i] = graph[i];
+		res[i].edge = alloc(graph[i].nedges * sizeof(edge_t));
+		for(j = 0; j < graph[i].nedges; j++)
+			res[i].edge[j] = graph[i].edge[j];
+	}
+	return(res);
+}
+
+/**
+ * Frees a graph.
+ *
+ * @param graph The graph.
+ */
+void free_graph(graph_t *graph){
+
+	long i;
+
+	for(i = 0; i < nswitches; i++)
+		free(graph[i].edge);
+	free(graph);
+}
+
 void deactivate_edge(graph_t *rg, long node_src, long node_dst){
 
 	long i;
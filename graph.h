@@ -20,6 +20,10 @@ typedef struct graph_t {
 } graph_t;
 
 
+graph_t *copy_graph(graph_t *graph);
+
+void free_graph(graph_t *graph);
+
 void deactivate_edge(graph_t *rg, long node_src, long node_dst);
 
 void activate_edge(graph_t *rg, long node_src, long node_dst);
@@ -18,9 +18,9 @@
  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <string.h>
 #include "globals.h"
 #include "ksp_routing.h"
-#include "list.h"
 
 path_t *init_path(long max_length){
 
@@ -34,6 +34,27 @@ path_t *init_path(long max_length){
     return(p);
 }
 
+/**
+ * Makes a copy of a path, just as long as it is.
+ *
+ * @param p The path to copy.
+ * @return The copy, to be freed with destroy_path().
+ */
+path_t *copy_path(path_t *p){
+
+    path_t *c = alloc(sizeof(path_t));
+    c->length = p->length;
+    c->next = p->next;
+    c->nodes = alloc((p->length) * sizeof(long));
+    c->links = alloc((p->length) * sizeof(long));
+    c->links_r = alloc((p->length) * sizeof(long));
+    memcpy(c->nodes, p->nodes, p->length * sizeof(long));
+    memcpy(c->links, p->links, p->length * sizeof(long));
+    memcpy(c->links_r, p->links_r, p->length * sizeof(long));
+
+    return(c);
+}
+
 void destroy_path(path_t *p){
 
     free(p->nodes);
@@ -152,253 +173,428 @@ long shortest_path(path_t *l, long *paths, long *links, long *links_r, int start
 }  
 
 /**
- * Auxiliar funtion to generate the routing table.
+ * A candidate path of Yen's algorithm, in the set B.
  */
+typedef struct ksp_cand_t{
+    path_t *path;           ///< The path.
+    unsigned long hash;     ///< Hash of its nodes.
+    long seq;               ///< Order of arrival to B.
+    long chain;             ///< Next candidate in the same bucket of the hash table, -1 if none.
+} ksp_cand_t;
 
-long shortest_path_generic(path_t **k_paths, long *paths, long *links, long *links_r, int start, int end, long length, long K, long ecmp, graph_t *graph){
+/**
+ * The scratch space of the search of k shortest paths, kept from a pair of switches to the
+ * next. Each thread filling the CAMs has its own, as it has its own copy of the graph.
+ *
+ * The set B is a binary heap of the candidates, with the shortest on top and, among paths
+ * as long, the last one added. A hash table of their nodes finds the repeated ones.
+ */
+typedef struct ksp_scratch_t{
+    long stamp;             ///< Number of the last BFS.
+    long *seen;             ///< The BFS that reached each switch last.
+    long *queue;            ///< Queue of the BFS.
+    long *paths;            ///< Previous switch in the BFS tree.
+    long *dists;            ///< Distance from the root of the BFS tree, plus 1.
+    long *links;            ///< Port to each switch from the previous one.
+    long *links_r;          ///< Port to the previous switch from each one.
+    path_t *root_path;      ///< The root of a spur path.
+    path_t *spur_path;      ///< A spur path.
+    path_t *total_path;     ///< A root and its spur path together.
+    long *nodes_removed;    ///< The switches of the root, removed for a while.
+    edge_removed_t *edges;  ///< The edges removed for a while, one per path found.
+    long cap_edges;         ///< Allocated length of #edges.
+    ksp_cand_t *cand;       ///< The candidates found for the current pair of switches.
+    long n_cand;            ///< Used length of #cand.
+    long cap_cand;          ///< Allocated length of #cand.
+    long *heap;             ///< The candidates in B, as a heap of indices in #cand.
+    long n_heap;            ///< Number of candidates in B.
+    long cap_heap;          ///< Allocated length of #heap.
+    long *bucket;           ///< First candidate in each bucket of the hash table, -1 if none.
+    long n_bucket;          ///< Number of buckets, a power of 2.
+} ksp_scratch_t;
+
+static THREAD_LOCAL ksp_scratch_t *ksp = NULL; ///< The scratch space of the thread.
 
-    long k, i, j, p, eq, spur_node, shortest_path_length, cont, curr_path, n_edges, n_nodes_removed, K_aux;
-    // list_t **l_aux;
-    path_t *total_path;
-    path_t *root_path;
-    path_t *spur_path;
-    edge_removed_t edges[100];
-    long nodes_removed[100];
-    long *paths_aux, *paths_aux_dists, *links_aux, *links_r_aux;
-    list *B = CreateVoidList();;
-
-    root_path = init_path(nswitches);
-    spur_path = init_path(nswitches);
-
-    paths_aux = alloc((nswitches) * sizeof(long));
-    paths_aux_dists = alloc((nswitches) * sizeof(long));
-    links_aux = alloc((nswitches) * sizeof(long));
-    links_r_aux = alloc((nswitches) * sizeof(long));
-
-    curr_path = 0;
-    K_aux = K;
-    shortest_path(k_paths[0], paths, links, links_r, start, end, length);
+/**
+ * Enlarges a scratch array, if it is shorter than needed. Like grow() in cam.c.
+ *
+ * @param a The array.
+ * @param cap Its allocated length, updated.
+ * @param need The length needed.
+ * @param size The size of an element.
+ * @return The array, maybe moved.
+ */
+static void *ksp_grow(void *a, long *cap, long need, size_t size){
+
+    if(need <= *cap)
+        return a;
+    *cap = max(need, (2 * (*cap)) + 16);
+    if((a = realloc(a, *cap * size)) == NULL)
+        panic("ksp_grow: Unable to allocate memory");
+    return a;
+}
 
-    shortest_path_length = k_paths[0]->length;
+/**
+ * Allocates the scratch space of the thread, the first time it is needed.
+ */
+static void ksp_scratch(){
 
-    if(start == end){
-        K_aux=1;
-    }
+    long i;
 
-    for(k = 1; k < K_aux; k++){
-        for(i = k_paths[k-1]->next; i < k_paths[k-1]->length - 1; i++){
-            n_edges = 0;
-            n_nodes_removed = 0;
-            spur_node = k_paths[k-1]->nodes[i];
-
-            for(j = 0;j <= i;j++){
-                root_path->nodes[j] = k_paths[k-1]->nodes[j];
-                root_path->links[j] = k_paths[k-1]->links[j];
-                root_path->links_r[j] = k_paths[k-1]->links_r[j];
+    if(ksp)
+        return;
+    ksp = alloc(sizeof(ksp_scratch_t));
+    ksp->stamp = 0;
+    ksp->seen = alloc(nswitches * sizeof(long));
+    for(i = 0; i < nswitches; i++)
+        ksp->seen[i] = 0;
+    ksp->queue = alloc(nswitches * sizeof(long));
+    ksp->paths = alloc(nswitches * sizeof(long));
+    ksp->dists = alloc(nswitches * sizeof(long));
+    ksp->links = alloc(nswitches * sizeof(long));
+    ksp->links_r = alloc(nswitches * sizeof(long));
+    ksp->root_path = init_path(nswitches);
+    ksp->spur_path = init_path(nswitches);
+    ksp->total_path = init_path(nswitches);
+    ksp->nodes_removed = alloc(nswitches * sizeof(long));
+    ksp->edges = NULL;
+    ksp->cap_edges = 0;
+    ksp->cand = NULL;
+    ksp->n_cand = 0;
+    ksp->cap_cand = 0;
+    ksp->heap = NULL;
+    ksp->n_heap = 0;
+    ksp->cap_heap = 0;
+    ksp->n_bucket = 64;
+    ksp->bucket = alloc(ksp->n_bucket * sizeof(long));
+    for(i = 0; i < ksp->n_bucket; i++)
+        ksp->bucket[i] = -1;
+}
+
+/**
+ * Frees the scratch space of the thread, if it has one.
+ */
+void ksp_finish(){
+
+    if(!ksp)
+        return;
+    free(ksp->seen);
+    free(ksp->queue);
+    free(ksp->paths);
+    free(ksp->dists);
+    free(ksp->links);
+    free(ksp->links_r);
+    destroy_path(ksp->root_path);
+    destroy_path(ksp->spur_path);
+    destroy_path(ksp->total_path);
+    free(ksp->nodes_removed);
+    free(ksp->edges);
+    free(ksp->cand);
+    free(ksp->heap);
+    free(ksp->bucket);
+    free(ksp);
+    ksp = NULL;
+}
+
+/**
+ * BFS from a spur node, that stops as soon as the destination is reached.
+ *
+ * The switches are visited in the same order as find_shortest_path() does, so the path
+ * found to the destination is the same. Only the switches reached have their entries
+ * set in the scratch arrays.
+ *
+ * @param src The spur node.
+ * @param dst The destination.
+ * @param graph The graph, with some edges & nodes removed.
+ * @return The length of the path to dst, counting both ends, or 0 if there is none.
+ */
+static long spur_bfs(long src, long dst, graph_t *graph){
+
+    long i, v, w, queue_insert, queue_extract;
+    long stamp = ++ksp->stamp;
+
+    queue_insert = 0;
+    queue_extract = 0;
+    ksp->queue[queue_insert++] = src;
+    ksp->seen[src] = stamp;
+    ksp->paths[src] = -1;
+    ksp->dists[src] = 1;
+
+    while(queue_insert != queue_extract) {
+        v = ksp->queue[queue_extract++];
+        for(i = 0; i < graph[v].nedges; i++) {
+            w = graph[v].edge[i].n_node;
+            if(graph[v].edge[i].n_edge != -1 && graph[v].edge[i].active && graph[w].active && ksp->seen[w] != stamp) {
+                ksp->queue[queue_insert++] = w;
+                ksp->seen[w] = stamp;
+                ksp->dists[w] = ksp->dists[v] + 1;
+                ksp->paths[w] = v;
+                ksp->links_r[w] = graph[v].edge[i].n_edge;
+                ksp->links[w] = i;
+                if(w == dst)
+                    return(ksp->dists[w]);
             }
-            root_path->length = i + 1;
+        }
+    }
+    return(0);
+}
 
-            for(p = 0; p <= curr_path; p++){
+/**
+ * Tells if a candidate goes before another one in B: if it is shorter or, being as long,
+ * it has been added later.
+ */
+static long cand_before(long a, long b){
 
-                eq = arrays_eq(root_path, k_paths[p], i);
+    long la = ksp->cand[a].path->length;
+    long lb = ksp->cand[b].path->length;
 
-                if(k_paths[p]->length > i && eq == 1){
-                    edges[n_edges].src = k_paths[p]->nodes[i];
-                    edges[n_edges].dst = k_paths[p]->nodes[i+1];
-                    deactivate_edge(graph,  k_paths[p]->nodes[i], k_paths[p]->nodes[i+1]);
-                    n_edges++;
-                }
-            }
-            for(j = 0; j < root_path->length; j++){
-                if(root_path->nodes[j] == spur_node)
-                    break;
-                else{
-                    nodes_removed[n_nodes_removed] = root_path->nodes[j];
-                    deactivate_node(graph, root_path->nodes[j]);
-                    n_nodes_removed++;
-                }
-            }
+    return(la < lb || (la == lb && ksp->cand[a].seq > ksp->cand[b].seq));
+}
 
-            find_shortest_path(spur_node, paths_aux, paths_aux_dists, links_aux, links_r_aux, graph);
-
-            if(shortest_path(spur_path, paths_aux, links_aux, links_r_aux, spur_node, end, paths_aux_dists[end])){
-                total_path = init_path(root_path->length + spur_path->length);
-
-                for(j = 0; j < root_path->length - 1; j++){
-                    total_path->nodes[j] = root_path->nodes[j];
-                    total_path->links[j + 1] = root_path->links[j + 1]; 
-                    total_path->links_r[j + 1] = root_path->links_r[j + 1]; 
-                }
-
-                for(j = 0; j < spur_path->length - 1; j++){
-                    total_path->nodes[root_path->length + j - 1] = spur_path->nodes[j];
-                    total_path->links[root_path->length + j] = spur_path->links[j + 1];
-                    total_path->links_r[root_path->length + j] = spur_path->links_r[j + 1];
-                }
-                total_path->nodes[root_path->length + spur_path->length -2] = spur_path->nodes[spur_path->length - 1];
-                total_path->length = root_path->length + spur_path->length - 1;
-
-                if(root_path->length - 2 >= 0)
-                    total_path->next = root_path->length - 2;
-                else
-                    total_path->next = 0;
-
-                if(!is_path(B, total_path))
-                    AddFirst(B, (void*)total_path);
-                else
-                    destroy_path(total_path);
-            }
-            for(j = 0; j < n_edges; j++)
-                activate_edge(graph, edges[j].src, edges[j].dst);
-            for(j = 0; j < n_nodes_removed; j++)
-                activate_node(graph, nodes_removed[j]);
-        }
-        if(B->emptyList == B_TRUE)
-            break;
+/**
+ * Puts the candidates of B in the buckets of the hash table, after it grows.
+ */
+static void rehash_cands(){
 
-        cont = extract_shortest(B, &k_paths[k], ecmp, shortest_path_length);
+    long i, c, h;
 
-        if(!cont)
-            break;
-        curr_path++;
+    for(i = 0; i < ksp->n_bucket; i++)
+        ksp->bucket[i] = -1;
+    for(i = 0; i < ksp->n_heap; i++){
+        c = ksp->heap[i];
+        h = ksp->cand[c].hash & (ksp->n_bucket - 1);
+        ksp->cand[c].chain = ksp->bucket[h];
+        ksp->bucket[h] = c;
     }
+}
 
-    DestroyListData(&B);
-    destroy_path(root_path);
-    destroy_path(spur_path);
-    free(paths_aux);
-    free(paths_aux_dists);
-    free(links_aux);
-    free(links_r_aux);
+/**
+ * Adds a path to B, unless it is already there.
+ *
+ * @param p The path, that is copied.
+ */
+static void add_cand(path_t *p){
+
+    long c, i, j;
+    unsigned long hash = 2166136261UL;
+
+    for(j = 0; j < p->length; j++)
+        hash = (hash ^ (unsigned long)p->nodes[j]) * 16777619UL;
+    for(c = ksp->bucket[hash & (ksp->n_bucket - 1)]; c != -1; c = ksp->cand[c].chain)
+        if(ksp->cand[c].hash == hash && ksp->cand[c].path->length == p->length &&
+                !memcmp(ksp->cand[c].path->nodes, p->nodes, p->length * sizeof(long)))
+            return;
+
+    ksp->cand = ksp_grow(ksp->cand, &ksp->cap_cand, ksp->n_cand + 1, sizeof(ksp_cand_t));
+    ksp->heap = ksp_grow(ksp->heap, &ksp->cap_heap, ksp->n_heap + 1, sizeof(long));
+    c = ksp->n_cand++;
+    ksp->cand[c].path = copy_path(p);
+    ksp->cand[c].hash = hash;
+    ksp->cand[c].seq = c;
+
+    for(i = ksp->n_heap++; i > 0 && cand_before(c, ksp->heap[(i - 1) / 2]); i = (i - 1) / 2)
+        ksp->heap[i] = ksp->heap[(i - 1) / 2];
+    ksp->heap[i] = c;
+
+    if(ksp->n_heap > ksp->n_bucket){
+        free(ksp->bucket);
+        ksp->n_bucket *= 4;
+        ksp->bucket = alloc(ksp->n_bucket * sizeof(long));
+        rehash_cands();
+    }
+    else{
+        ksp->cand[c].chain = ksp->bucket[hash & (ksp->n_bucket - 1)];
+        ksp->bucket[hash & (ksp->n_bucket - 1)] = c;
+    }
+}
 
-    return(curr_path + 1);
+/**
+ * Takes the candidate on top of B out of it.
+ *
+ * @return The path, now owned by the caller.
+ */
+static path_t *take_cand(){
+
+    long c, i, l, h, *prev;
+
+    c = ksp->heap[0];
+    l = ksp->heap[--ksp->n_heap];
+    for(i = 0; 2 * i + 1 < ksp->n_heap; i = h){
+        h = 2 * i + 1;
+        if(h + 1 < ksp->n_heap && cand_before(ksp->heap[h + 1], ksp->heap[h]))
+            h++;
+        if(!cand_before(ksp->heap[h], l))
+            break;
+        ksp->heap[i] = ksp->heap[h];
+    }
+    ksp->heap[i] = l;
+
+    for(prev = &ksp->bucket[ksp->cand[c].hash & (ksp->n_bucket - 1)]; *prev != c; prev = &ksp->cand[*prev].chain);
+    *prev = ksp->cand[c].chain;
+    return(ksp->cand[c].path);
 }
 
+/**
+ * Empties B, freeing the paths left in it.
+ */
+static void clear_cands(){
+
+    long i, c;
+
+    for(i = 0; i < ksp->n_heap; i++){
+        c = ksp->heap[i];
+        ksp->bucket[ksp->cand[c].hash & (ksp->n_bucket - 1)] = -1;
+        destroy_path(ksp->cand[c].path);
+    }
+    ksp->n_heap = 0;
+    ksp->n_cand = 0;
+}
 
 /**
- * Auxiliar funtion to generate the routing table.
+ * Adds to B the deviations of the last path found, one for each of its spur nodes.
+ *
+ * @param k_paths The paths found.
+ * @param k The number of paths found.
+ * @param end The destination.
+ * @param graph The graph, whose edges & nodes are removed for a while.
  */
+static void spur_paths(path_t **k_paths, long k, long end, graph_t *graph){
+
+    long i, j, p, spur_node, n_edges, n_nodes_removed, length;
+    path_t *last = k_paths[k - 1];
+    path_t *root_path = ksp->root_path;
+    path_t *spur_path = ksp->spur_path;
+    path_t *total_path = ksp->total_path;
+
+    ksp->edges = ksp_grow(ksp->edges, &ksp->cap_edges, k, sizeof(edge_removed_t));
+    for(i = last->next; i < last->length - 1; i++){
+        n_edges = 0;
+        n_nodes_removed = 0;
+        spur_node = last->nodes[i];
+
+        for(j = 0;j <= i;j++){
+            root_path->nodes[j] = last->nodes[j];
+            root_path->links[j] = last->links[j];
+            root_path->links_r[j] = last->links_r[j];
+        }
+        root_path->length = i + 1;
+
+        for(p = 0; p < k; p++){
+            if(k_paths[p]->length > i && arrays_eq(root_path, k_paths[p], i)){
+                ksp->edges[n_edges].src = k_paths[p]->nodes[i];
+                ksp->edges[n_edges].dst = k_paths[p]->nodes[i+1];
+                deactivate_edge(graph,  k_paths[p]->nodes[i], k_paths[p]->nodes[i+1]);
+                n_edges++;
+            }
+        }
+        for(j = 0; j < root_path->length; j++){
+            if(root_path->nodes[j] == spur_node)
+                break;
+            else{
+                ksp->nodes_removed[n_nodes_removed] = root_path->nodes[j];
+                deactivate_node(graph, root_path->nodes[j]);
+                n_nodes_removed++;
+            }
+        }
 
-long shortest_path_generic_limited(path_t **k_paths, long *paths, long *links, long *links_r, int start, int end, long length, long M, long K, long H, long ths, graph_t *graph){
+        length = spur_bfs(spur_node, end, graph);
+
+        if(length && shortest_path(spur_path, ksp->paths, ksp->links, ksp->links_r, spur_node, end, length)){
+            for(j = 0; j < root_path->length - 1; j++){
+                total_path->nodes[j] = root_path->nodes[j];
+                total_path->links[j + 1] = root_path->links[j + 1];
+                total_path->links_r[j + 1] = root_path->links_r[j + 1];
+            }
 
-    long k, i, j, p, eq, spur_node, cont, curr_path, n_edges, n_nodes_removed, K_aux, H_aux;
-    path_t *total_path;
-    path_t *root_path;
-    path_t *spur_path;
-    edge_removed_t edges[1000];
-    long nodes_removed[1000];
-    long *paths_aux, *paths_aux_dists, *links_aux, *links_r_aux;
-    list *B = CreateVoidList();;
+            for(j = 0; j < spur_path->length - 1; j++){
+                total_path->nodes[root_path->length + j - 1] = spur_path->nodes[j];
+                total_path->links[root_path->length + j] = spur_path->links[j + 1];
+                total_path->links_r[root_path->length + j] = spur_path->links_r[j + 1];
+            }
+            total_path->nodes[root_path->length + spur_path->length -2] = spur_path->nodes[spur_path->length - 1];
+            total_path->length = root_path->length + spur_path->length - 1;
 
-    root_path = init_path(nswitches);
-    spur_path = init_path(nswitches);
+            if(root_path->length - 2 >= 0)
+                total_path->next = root_path->length - 2;
+            else
+                total_path->next = 0;
 
-    paths_aux = alloc((nswitches) * sizeof(long));
-    paths_aux_dists = alloc((nswitches) * sizeof(long));
-    links_aux = alloc((nswitches) * sizeof(long));
-    links_r_aux = alloc((nswitches) * sizeof(long));
+            add_cand(total_path);
+        }
+        for(j = 0; j < n_edges; j++)
+            activate_edge(graph, ksp->edges[j].src, ksp->edges[j].dst);
+        for(j = 0; j < n_nodes_removed; j++)
+            activate_node(graph, ksp->nodes_removed[j]);
+    }
+}
 
-    curr_path = 0;
-    K_aux = M;
+/**
+ * Auxiliar funtion to generate the routing table.
+ *
+ * Yen's algorithm: each path after the first one is the shortest in B, the set of the
+ * deviations of the paths found before. With ecmp, only paths as short as the first one.
+ */
+
+long shortest_path_generic(path_t **k_paths, long *paths, long *links, long *links_r, int start, int end, long length, long K, long ecmp, graph_t *graph){
+
+    long k, K_aux;
+
+    ksp_scratch();
+    K_aux = K;
     shortest_path(k_paths[0], paths, links, links_r, start, end, length);
 
-    H_aux = k_paths[0]->length + H;
     if(start == end){
         K_aux=1;
     }
 
-    k = 1;
-    while(k < K_aux){
-        for(i = k_paths[k-1]->next; i < k_paths[k-1]->length - 1; i++){
-            n_edges = 0;
-            n_nodes_removed = 0;
-            spur_node = k_paths[k-1]->nodes[i];
-
-            for(j = 0;j <= i;j++){
-                root_path->nodes[j] = k_paths[k-1]->nodes[j];
-                root_path->links[j] = k_paths[k-1]->links[j];
-                root_path->links_r[j] = k_paths[k-1]->links_r[j];
-            }
-            root_path->length = i + 1;
+    for(k = 1; k < K_aux; k++){
+        spur_paths(k_paths, k, end, graph);
+        if(ksp->n_heap == 0)
+            break;
+        if(ecmp && ksp->cand[ksp->heap[0]].path->length > k_paths[0]->length)
+            break;
+        k_paths[k] = take_cand();
+    }
+    clear_cands();
 
-            for(p = 0; p <= curr_path; p++){
+    return(k);
+}
 
-                eq = arrays_eq(root_path, k_paths[p], i);
 
-                if(k_paths[p]->length > i && eq == 1){
-                    edges[n_edges].src = k_paths[p]->nodes[i];
-                    edges[n_edges].dst = k_paths[p]->nodes[i+1];
-                    deactivate_edge(graph,  k_paths[p]->nodes[i], k_paths[p]->nodes[i+1]);
-                    n_edges++;
-                }
-            }
-            for(j = 0; j < root_path->length; j++){
-                if(root_path->nodes[j] == spur_node)
-                    break;
-                else{
-                    nodes_removed[n_nodes_removed] = root_path->nodes[j];
-                    deactivate_node(graph, root_path->nodes[j]);
-                    n_nodes_removed++;
-                }
-            }
+/**
+ * Auxiliar funtion to generate the routing table.
+ *
+ * Yen's algorithm, taking the paths up to H hops longer than the first one, M of them at
+ * most. Once ths paths have been found, K paths are taken, even if they are longer.
+ */
 
-            find_shortest_path(spur_node, paths_aux, paths_aux_dists, links_aux, links_r_aux, graph);
-
-            if(shortest_path(spur_path, paths_aux, links_aux, links_r_aux, spur_node, end, paths_aux_dists[end])){
-                total_path = init_path(root_path->length + spur_path->length);
-
-                for(j = 0; j < root_path->length - 1; j++){
-                    total_path->nodes[j] = root_path->nodes[j];
-                    total_path->links[j + 1] = root_path->links[j + 1]; 
-                    total_path->links_r[j + 1] = root_path->links_r[j + 1]; 
-                }
-
-                for(j = 0; j < spur_path->length - 1; j++){
-                    total_path->nodes[root_path->length + j - 1] = spur_path->nodes[j];
-                    total_path->links[root_path->length + j] = spur_path->links[j + 1];
-                    total_path->links_r[root_path->length + j] = spur_path->links_r[j + 1];
-                }
-                total_path->nodes[root_path->length + spur_path->length -2] = spur_path->nodes[spur_path->length - 1];
-                total_path->length = root_path->length + spur_path->length - 1;
-
-                if(root_path->length - 2 >= 0)
-                    total_path->next = root_path->length - 2;
-                else
-                    total_path->next = 0;
-
-                if(!is_path(B, total_path))
-                    AddFirst(B, (void*)total_path);
-                else
-                    destroy_path(total_path);
-            }
-            for(j = 0; j < n_edges; j++)
-                activate_edge(graph, edges[j].src, edges[j].dst);
-            for(j = 0; j < n_nodes_removed; j++)
-                activate_node(graph, nodes_removed[j]);
-        }
-        if(B->emptyList == B_TRUE)
-            break;
+long shortest_path_generic_limited(path_t **k_paths, long *paths, long *links, long *links_r, int start, int end, long length, long M, long K, long H, long ths, graph_t *graph){
 
-        cont = extract_shortest_limited(B, &k_paths[k],  k - 1, H_aux, ths);
+    long k, K_aux, H_aux;
 
-        if(!cont)
+    ksp_scratch();
+    K_aux = M;
+    shortest_path(k_paths[0], paths, links, links_r, start, end, length);
+
+    H_aux = k_paths[0]->length + H;
+    if(start == end){
+        K_aux=1;
+    }
+
+    for(k = 1; k < K_aux; k++){
+        spur_paths(k_paths, k, end, graph);
+        if(ksp->n_heap == 0)
             break;
-        else if(cont == 2){               
+        if(ksp->cand[ksp->heap[0]].path->length > H_aux){
+            if(k - 1 >= ths)
+                break;
             K_aux = K;
         }
-        curr_path++;
-        k++;   
+        k_paths[k] = take_cand();
     }
+    clear_cands();
 
-    DestroyListData(&B);
-    destroy_path(root_path);
-    destroy_path(spur_path);
-    free(paths_aux);
-    free(paths_aux_dists);
-    free(links_aux);
-    free(links_r_aux);
-
-    return(curr_path + 1);
+    return(k);
 }
 
 /**
@@ -422,88 +618,3 @@ long arrays_eq(path_t *a1, path_t *a2, long i){
     }
     return(eq);
 }
-
-long is_path(list *B, path_t *p){
-
-    long j, ret;
-    listElement *ll;
-    path_t *p_aux;
-
-    ret = 0;
-
-    ll = B->first;
-    while( ll ) {
-        for(j = 0; j < p->length; j++){
-            p_aux = (path_t*)ll->pointer;
-            if(p_aux->nodes[j] != p->nodes[j])
-                break;
-        }
-        if(j == p->length){
-            ret = 1;
-        }
-        ll = ll->next;
-    }   
-    return(ret);
-}
-
-long extract_shortest(list *B, path_t **l_dst, long ecmp, long shortest_path_length){
-
-    long ret = 0;                                                                  
-    long min = LONG_MAX;                                                           
-
-    listElement *ll = NULL;
-    path_t *path =NULL;
-    path_t *path_aux = NULL;
-
-    ll = B->first;
-
-    while(ll){                                                          
-        path = (path_t*)ll->pointer;                                             
-        if(path->length < min){                                                           
-            min = path->length;                                                           
-            path_aux = path;                                                            
-        }                                                                          
-        ll = ll->next;
-    }                                                                              
-    if(path_aux->length <= shortest_path_length || ecmp == 0 ){                            
-        ret = 1;                                                                   
-        *l_dst = path_aux;                                                            
-        RemoveFromList(B, path_aux);
-    }                                                                              
-    return(ret);                                                                   
-}  
-
-long extract_shortest_limited(list *B, path_t **l_dst, long n_current, long H, long ths){
-
-    long ret = 0;                                                                  
-    long min = LONG_MAX;                                                           
-
-    listElement *ll = NULL;
-    path_t *path = NULL;
-    path_t *path_aux = NULL;
-
-    ll = B->first;
-
-    while(ll){                                                          
-        path = (path_t*)ll->pointer;                                             
-        if(path->length < min){                                                           
-            min = path->length;                                                           
-            path_aux = path;                                                            
-        }                                                                          
-        ll = ll->next;
-    }                                                                              
-    if(path_aux->length <= H){
-        ret = 1;
-        *l_dst = path_aux;
-        RemoveFromList(B, path_aux);
-    }
-    else if((path_aux->length > H) && n_current < ths){
-        ret = 2;
-        *l_dst = path_aux;
-        RemoveFromList(B, path_aux);
-    }
-    else{
-        ret = 0;
-    }
-    return(ret);                                                                   
-} 
@@ -7,7 +7,6 @@
 #define _ksp_routing
 
 #include "graph.h"
-#include "list.h"
 
 typedef struct path_t{
 
@@ -27,6 +26,8 @@ typedef struct edge_removed_t{
 
 path_t *init_path(long max_length);
 
+path_t *copy_path(path_t *p);
+
 void destroy_path(path_t *p);
 
 void print_path(path_t *p);
@@ -41,11 +42,7 @@ long shortest_path_generic_limited(path_t **k_paths, long *paths, long *links, l
 
 long arrays_eq(path_t *a1, path_t *a2, long i);
 
-long is_path(list *B, path_t *p);
-
-long extract_shortest(list *B, path_t **l_dst, long ecmp, long shortest_path_length);
-
-long extract_shortest_limited(list *B, path_t **l_dst, long n_current, long H, long ths);
+void ksp_finish();
 
 #endif
 
@@ -47,6 +47,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 /* Global variables - parameters */
 
 long  r_seed;		///< Random Seed
+long threads;		///< Number of worker threads of the cycle engine. 0 means the classic, single-threaded engine.
+bool_t worklist;	///< Visit only the routers holding phits in each cycle.
+bool_t profile;		///< Print where the simulation time goes at the end of the run.
 
 double load;		///< The provided injected load.
 double trigger_rate;///< Probability to trigger new packets when a packet is received.
@@ -107,6 +110,23 @@ long tr_ql;
 */
 long inj_ql;
 
+/**
+* Transit queue ring size, a power of two.
+*
+* In packet descriptors: a queue full of phits may hold the tail of a packet and #buffer_cap
+* packets, no more. Without #PACKET_QUEUES, in phits: #tr_ql - 1 rounded up.
+*
+* @see PACKET_QUEUES.
+*/
+long tr_qd;
+
+/**
+* Injection queue ring size, a power of two.
+*
+* @see tr_qd.
+*/
+long inj_qd;
+
 /**
 * The traffic pattern Id.
 *
@@ -149,6 +169,8 @@ cam_policy_t cam_policy;
 vc_inj_t vc_inj;
 cam_ports_t cam_ports;
 long cam_policy_params[3];
+long cam_threads;			///< Threads filling the CAM tables. 0 uses one per online CPU.
+char cam_cache_file[256];	///< File in which the CAM tables are kept between runs. Empty for no cache.
 
 /**
 * Bandwidth of the links used to translate from CPU units to fsin cycles.
@@ -163,6 +185,22 @@ long link_bw;
 */
 cpu_units_t cpu_units;
 
+/**
+* Algorithm used to expand the collectives of the traces.
+*
+* @see coll_alg_t
+* @see coll_alg_l
+*/
+coll_alg_t coll_alg;
+
+/**
+* Policy for starting the apps waiting in a mpa mix.
+*
+* @see mpa_queue_t
+* @see mpa_queue_l
+*/
+mpa_queue_t mpa_queue;
+
 /**
 * Id of the request port mechanism.
 *
@@ -206,6 +244,8 @@ placement_t placement;
 long shift_plc;				///< Number of places for shift placement.
 long trace_nodes;		///< Number of tasks in the trace
 long trace_instances;	///< Number of instances of the trace to simulate
+long trace_lookahead;	///< Events of each task kept in memory when streaming the trace. 0 loads the whole trace.
+long trace_threads;		///< Threads reading a text trace. 0 uses one per online CPU.
 char placefile[128];
 
 bool_t parallel_injection;			///< Allows/Disallows the parallel injection (inject some packets in the same cycle & router).
@@ -300,6 +340,20 @@ long num_executions;	///< Number of executions, appended to the output filename.
 */
 char trcfile[256];
 
+char checkpoint_file[256];		///< File in which the snapshots of the simulation are written. Empty for no snapshots.
+char restore_file[256];			///< Snapshot from which the simulation is resumed. Empty for starting from scratch.
+CLOCK_TYPE checkpoint_period;	///< Cycles between snapshots. When 0, only at the end of the warm-up & when interrupted.
+char sweep_values[1024];	///< Values of #sweep_param, separated by commas, one point of the sweep each. Empty for no sweep.
+/**
+* Parameter swept.
+*
+* @see sweep_param_t
+* @see sweep_param_l
+*/
+sweep_param_t sweep_param;
+long sweep_jobs;			///< Points of the sweep run at a time. 0 uses one per online CPU.
+bool_t sweep_warmup;		///< Do the warm-up once, before forking the points of the sweep.
+
 long samples;			///< Number of samples (batchs or shots) to take from the current Simulation.
 CLOCK_TYPE batch_time;		///< Sampling period.
 long min_batch_size;	///< Minimum number of reception in a batch to save stats.
@@ -623,9 +677,12 @@ int main(int argc, char *argv[]) {
 
 	time(&start_time);
 	get_conf((long)(argc - 1), argv + 1);
+#if (PROFILE != 0)
+	profile_init();
+#endif
 	sim_clock = (CLOCK_TYPE) 1L; // HAS TO BE ONE for arbitrate to work
 
-	srand(r_seed);
+	rng_init(r_seed);
 
 	router_init();
 	pkt_init();
@@ -634,17 +691,38 @@ int main(int argc, char *argv[]) {
 
 	init_functions();
 	init_network();
+	rr_init();
 	init_injection();
+	worklist_init();
+#if (THREADS != 0)
+	rng_streams_init();
+#endif
+	if (sweep_values[0] != '\0' && !run_sweep())
+		return 0;	// All the points of the sweep done & reported.
+#if (THREADS != 0)
+	threads_init();
+#endif
 
 	if (pheaders > 0 && pattern!=MPA)
 		print_headers();
 
+#if (PROFILE != 0)
+	profile_start();
+#endif
 	run_network();
 	time(&end_time);
     if(pattern!=MPA)
 	    print_results(start_time, end_time);
+	sweep_done();
+#if (PROFILE != 0)
+	print_profile();
+#endif
 
 
+#if (THREADS != 0)
+        threads_finish();
+#endif
+        worklist_finish();
         finish_network();
         injection_finish();
         finish_functions();
@@ -67,7 +67,7 @@ routing_r midimew_rr (long source, long destination) {
 	long x0, x1, y0, y1, q, r;
 	routing_r res;
 
-	res.rr=alloc(ndim*sizeof(long));
+	res.rr=rr_alloc(ndim);
 
 	b = (long)ceil(sqrt(((double)NUMNODES/(double)2)));
 
@@ -74,6 +74,7 @@ void * alloc(long size) {
 
         if((res = malloc(size)) == NULL)
 		panic("alloc: Unable to allocate memory");
+	prof_count(prof_allocs);
 
 	return res;
 }
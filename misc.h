@@ -16,13 +16,24 @@
 
 #include "constants.h"
 
+#if (THREADS != 0)
+long sim_rand(void);
+void sim_rand_router(long i);
+#else
+/**
+* A random number in [ 0, RAND_MAX ]. Without thread support it is just rand().
+*/
+#define sim_rand() rand()
+#define sim_rand_router(i)
+#endif
+
 /**
 * Choose a random number in [ 0, m ).
 *
 * @param m maximum.
 * @return A random number.
 */
-#define ztm(m) (long) (m * ( (1.0*rand() ) / (RAND_MAX+1.0)))
+#define ztm(m) (long) (m * ( (1.0*sim_rand() ) / (RAND_MAX+1.0)))
 
 /**
 * Return the absolute value
@@ -41,6 +52,8 @@
 
 #define P_NULL (-1) ///< Definition of a NULL value.
 
+#define WORD_BITS (8 * sizeof(unsigned long))	///< Bits in each word of a bitmap.
+
 /**
 * Definition of the maximum chooser
 *
@@ -88,6 +101,27 @@ typedef enum cpu_units_t {
 	UNIT_MILLISECONDS=0, UNIT_MICROSECONDS=1, UNIT_NANOSECONDS=2, UNIT_CYCLES=3
 } cpu_units_t;
 
+/**
+* Algorithms used to expand the collectives of the traces into point-to-point messages.
+*/
+typedef enum coll_alg_t {
+	COLL_BINOMIAL=0, COLL_RDOUBLING=1, COLL_RING=2
+} coll_alg_t;
+
+/**
+* Policies for starting the apps waiting in a mpa mix.
+*/
+typedef enum mpa_queue_t {
+	MPA_FCFS=0, MPA_BACKFILL=1
+} mpa_queue_t;
+
+/**
+* Parameters that can be swept, one process per value, from the same network.
+*/
+typedef enum sweep_param_t {
+	SWEEP_LOAD=0, SWEEP_PATTERN=1
+} sweep_param_t;
+
 /**
 * Definition of all accepted topologies.
 */
@@ -1,168 +1,497 @@
 /**
- * Jon Moríñigo Mazo (2023)
- *
- * This file contains all the functions used in the mpa traffic pattern
- */
+* @file
+* @brief	Scheduler of the mpa traffic: a mix of apps, each one running a trace in its own nodes.
+*
+* The mix is read from #mpa_file, one app per line, with the fields separated by '_':
+*	tracefile_nodes[_node0_node1...]
+* When the nodes are given, task i of the trace runs in the i-th of them. Otherwise the app
+* takes the lowest free nodes when it starts.
+*
+* Each trace is read once, whatever the number of apps running it, and kept grouped by task
+* with the lengths already in packets and cycles, so starting an app only copies its events to
+* the queues of its nodes. The busy nodes are kept in a bitmap and each app counts its nodes
+* still running, so a node finishing costs a decrement and the waiting apps are only looked at
+* when an app finishes.
+*
+* The apps wait in the order of the file and start as #mpa_queue says:
+* - fcfs: the first app waiting starts as soon as its nodes are free, and no other before it.
+* - backfill: an app may start before others waiting ahead of it if it does not use any of their
+*   nodes, so it never holds the nodes they wait for. As any free node could be taken by an app
+*   that asks for a number of nodes, nothing starts before one of those.
+*
+* Jon Moríñigo Mazo (2023)
 
+FSIN Functional Simulator of Interconnection Networks
+Copyright (2003-2011) J. Miguel-Alonso, J. Navaridas
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "globals.h"
 
-appnode createNode();
-appnode addapp(appnode head, char* name, long nodes, long *nodelist, long id);
-void d_app(long id);
-appnode head;
-void set_bitmap(long node, long id);
-int check_finished_app(long id);
+#if (TRACE_SUPPORT != 0)
+
+#define bit_test(b, n) (((b)[(n)/WORD_BITS] >> ((n)%WORD_BITS)) & 1UL)	///< Is node n in bitmap b?
+#define bit_set(b, n) ((b)[(n)/WORD_BITS] |= 1UL << ((n)%WORD_BITS))	///< Puts node n in bitmap b.
+#define bit_clear(b, n) ((b)[(n)/WORD_BITS] &= ~(1UL << ((n)%WORD_BITS)))	///< Removes node n from bitmap b.
+
+/**
+* An event of a trace of the mix, as it is kept while the trace is not running.
+*/
+typedef struct app_event {
+	event_t type;		///< Type of the event (Reception / Sent / Computation).
+	long peer;			///< The other task: destination when sending, source when receiving.
+	long tag;			///< An id for distinguish messages.
+	CLOCK_TYPE length;	///< Length of the message in packets. Number of cycles in computation.
+} app_event;
+
+/**
+* A trace of the mix, read once and shared by all the apps running it.
+*/
+typedef struct app_trace {
+	char * name;		///< The file of the trace.
+	long ntasks;		///< Number of tasks.
+	long * first;		///< Position in #ev of the first event of each task, ntasks+1 of them.
+	app_event * ev;		///< The events, grouped by task.
+	struct app_trace * next;	///< The next trace read.
+} app_trace;
+
+/**
+* An app of the mix.
+*/
+typedef struct app_t {
+	app_trace * trace;	///< The trace it runs.
+	long nodes;			///< Number of nodes.
+	long * node_list;	///< The node of each task.
+	bool_t fixed;		///< Were the nodes given in #mpa_file? Otherwise they are taken when it starts.
+	long left;			///< Nodes still running.
+	CLOCK_TYPE ini_clock;	///< Cycle in which it started.
+	CLOCK_TYPE end_clock;	///< Cycle in which it finished.
+} app_t;
+
+static app_t * apps = NULL;		///< All the apps, in the order of #mpa_file. Their id is their position.
+static long napps = 0;			///< Number of apps.
+static long * waiting;			///< The apps waiting, in order.
+static long nwaiting = 0;		///< Number of apps waiting.
+static long running = 0;		///< Number of apps running.
+static app_trace * traces = NULL;	///< All the traces read.
+static unsigned long * busy;	///< Bitmap of the nodes running an app.
+static unsigned long * held;	///< Bitmap of the nodes of the apps that can not be overtaken by backfilling.
+static long nfree;				///< Nodes not running any app.
+static long words;				///< Words in a bitmap.
+static long room;				///< Room in the app_trace.first of the trace being counted.
+
+/**
+* Reads a line of a trace of the mix.
+*
+* The first time a trace is read only the events of each task are counted, in t->first. The
+* second one they are stored, in the positions given by pos.
+*
+* @param t The trace.
+* @param buffer The line.
+* @param pos The position of the next event of each task, or NULL when counting.
+*/
+static void read_app_line(app_trace *t, char *buffer, long *pos) {
+	char sep[] = " \t\n";
+	char * tok;
+	app_event ev;
+	long task = -1;
+
+	if (buffer[0] == '#' || (tok = strtok(buffer, sep)) == NULL)
+		return;
+	if (!strcmp(tok, "s") || !strcmp(tok, "r")) {
+		ev.type = (tok[0] == 's') ? SENDING : RECEPTION;
+		if ((tok = strtok(NULL, sep)) == NULL)
+			panic("mpa: Missing source in a trace of the mix");
+		task = atol(tok);
+		if ((tok = strtok(NULL, sep)) == NULL)
+			panic("mpa: Missing destination in a trace of the mix");
+		ev.peer = atol(tok);
+		if (ev.type == RECEPTION) { // The event is added to the destination.
+			long aux = task;
+			task = ev.peer;
+			ev.peer = aux;
+		}
+		if (task == ev.peer)
+			return;
+		if ((tok = strtok(NULL, sep)) == NULL)
+			panic("mpa: Missing tag in a trace of the mix");
+		ev.tag = atol(tok);
+		if ((tok = strtok(NULL, sep)) == NULL)
+			panic("mpa: Missing size in a trace of the mix");
+		ev.length = msg_packets(atol(tok));
+	}
+	else if (!strcmp(tok, "c")) {
+		ev.type = COMPUTATION;
+		if ((tok = strtok(NULL, sep)) == NULL)
+			panic("mpa: Missing task in a trace of the mix");
+		task = ev.peer = atol(tok);
+		if ((tok = strtok(NULL, sep)) == NULL)
+			panic("mpa: Missing length in a trace of the mix");
+		ev.tag = 0;
+		if ((ev.length = cpu_cycles(atol(tok), cpu_units)) <= 0)
+			return;
+	}
+	else if (!strcmp(tok, "allreduce") || !strcmp(tok, "alltoall") || !strcmp(tok, "bcast") || !strcmp(tok, "barrier"))
+		panic("mpa: Collectives are not supported in the traces of the mix");
+	else
+		return;
+
+	if (task < 0 || ev.peer < 0)
+		panic("mpa: Negative task in a trace of the mix");
+	if (pos == NULL) {
+		if (task >= t->ntasks || ev.peer >= t->ntasks) {	// New tasks.
+			long n = 1 + ((task > ev.peer) ? task : ev.peer), i;
+
+			if (n >= room) {
+				long * first;
+
+				room = (2 * room > n) ? 2 * room : n + 1;
+				first = alloc(room * sizeof(long));
+				for (i = 0; i < room; i++)
+					first[i] = (i <= t->ntasks) ? t->first[i] : 0;
+				free(t->first);
+				t->first = first;
+			}
+			t->ntasks = n;
+		}
+		t->first[task]++;
+	}
+	else
+		t->ev[pos[task]++] = ev;
+}
+
+/**
+* Gets a trace of the mix, reading it if no other app has done it before.
+*
+* The trace is read twice: the events of each task are counted first, and then stored.
+*
+* @param name The file of the trace.
+* @return The trace.
+*/
+static app_trace * get_trace(char *name) {
+	FILE * fd;
+	char buffer[512];
+	app_trace * t;
+	long * pos;
+	long i, n;
+
+	for (t = traces; t != NULL; t = t->next)
+		if (!strcmp(t->name, name))
+			return t;
+
+	if ((fd = fopen(name, "r")) == NULL) {
+		char message[600];
+		sprintf(message, "Trace file not found in current directory - %s", name);
+		panic(message);
+	}
+	t = alloc(sizeof(app_trace));
+	t->name = strdup(name);
+	t->ntasks = 0;
+	t->first = alloc(sizeof(long));
+	t->first[0] = 0;
+	room = 1;
+	while (fgets(buffer, 512, fd) != NULL)
+		read_app_line(t, buffer, NULL);
+
+	pos = alloc((t->ntasks + 1) * sizeof(long));
+	for (i = 0, n = 0; i <= t->ntasks; i++) {	// From counts to positions.
+		long c = t->first[i];
+		t->first[i] = pos[i] = n;
+		n += c;
+	}
+	t->ev = alloc((n ? n : 1) * sizeof(app_event));
+	rewind(fd);
+	while (fgets(buffer, 512, fd) != NULL)
+		read_app_line(t, buffer, pos);
+	fclose(fd);
+	free(pos);
+
+	t->next = traces;
+	traces = t;
+	return t;
+}
+
+/**
+* Reads the apps of the mix from #mpa_file, and the traces they run.
+*/
+static void read_apps(void) {
+	FILE * fp;
+	char * buffer = NULL;
+	size_t size = 0;
+	char sep[] = "_\n";
+	char * tok = NULL, * name;
+	app_t * a;
+	long i, n;
+
+	if ((fp = fopen(mpa_file, "r")) == NULL)
+		panic("mpa: mpa_file not found!");
+	while (getline(&buffer, &size, fp) != -1)
+		if (buffer[0] != '\n' && buffer[0] != '#')
+			napps++;
+	if (napps == 0)
+		panic("mpa: No app in mpa_file");
+	apps = alloc(napps * sizeof(app_t));
+	waiting = alloc(napps * sizeof(long));
+
+	rewind(fp);
+	n = 0;
+	while (getline(&buffer, &size, fp) != -1) {
+		if (buffer[0] == '\n' || buffer[0] == '#')
+			continue;
+		a = &apps[n];
+		if ((name = strtok(buffer, sep)) == NULL || (tok = strtok(NULL, sep)) == NULL)
+			panic("mpa: Missing number of nodes in mpa_file");
+		a->nodes = atol(tok);
+		if (a->nodes <= 0 || a->nodes > nprocs)
+			panic("mpa: Wrong number of nodes in mpa_file");
+		a->node_list = alloc(a->nodes * sizeof(long));
+		a->fixed = B_FALSE;
+		for (i = 0; i < a->nodes && (tok = strtok(NULL, sep)) != NULL; i++) {
+			a->node_list[i] = atol(tok);
+			if (a->node_list[i] < 0 || a->node_list[i] >= nprocs)
+				panic("mpa: Node out of range in mpa_file");
+			if (bit_test(held, a->node_list[i]))
+				panic("mpa: Node repeated in an app of mpa_file");
+			bit_set(held, a->node_list[i]);
+			a->fixed = B_TRUE;
+		}
+		if (a->fixed && i < a->nodes)
+			panic("mpa: Missing nodes in mpa_file");
+		memset(held, 0, words * sizeof(unsigned long));
+		a->trace = get_trace(name);
+		if (a->trace->ntasks > a->nodes)
+			panic("mpa: An app has less nodes than tasks in its trace");
+		waiting[n] = n;
+		n++;
+	}
+	nwaiting = napps;
+	free(buffer);
+	fclose(fp);
+}
+
+/**
+* Can an app start?
+*
+* @param a The app.
+* @return TRUE if its nodes are free and no app waiting before it needs them.
+*/
+static bool_t app_fits(app_t *a) {
+	long i, w, n;
+
+	if (a->fixed) {
+		for (i = 0; i < a->nodes; i++)
+			if (bit_test(busy, a->node_list[i]) || bit_test(held, a->node_list[i]))
+				return B_FALSE;
+		return B_TRUE;
+	}
+	if (a->nodes > nfree)
+		return B_FALSE;
+	for (w = 0, n = 0; w < words && n < a->nodes; w++)
+		n += __builtin_popcountl(~(busy[w] | held[w]));
+	return (n >= a->nodes);	// The bits beyond nprocs are busy.
+}
+
+/**
+* Starts an app: takes its nodes and fills their queues with the events of its trace.
+*
+* @param a The app.
+*/
+static void start_app(app_t *a) {
+	app_trace * t = a->trace;
+	app_event * e;
+	event ev;
+	long id = a - apps, i, w, node;
+
+	if (!a->fixed) // The lowest free nodes.
+		for (w = 0, i = 0; i < a->nodes; w++) {
+			unsigned long f = ~(busy[w] | held[w]);
+
+			for (; f && i < a->nodes; f &= f - 1)
+				a->node_list[i++] = (w * WORD_BITS) + __builtin_ctzl(f);
+		}
+	for (i = 0; i < a->nodes; i++) {
+		node = a->node_list[i];
+		bit_set(busy, node);
+		network[node].source = OTHER_SOURCE;
+		network[node].appid = id;
+	}
+	nfree -= a->nodes;
+	ev.app_id = id;
+	ev.count = 0;
+	for (i = 0; i < t->ntasks; i++) {
+		node = a->node_list[i];
+		for (e = &t->ev[t->first[i]]; e < &t->ev[t->first[i + 1]]; e++) {
+			ev.type = e->type;
+			ev.pid = a->node_list[e->peer];
+			ev.task = e->tag;
+			ev.length = e->length;
+			ins_event(&network[node].events, ev);
+		}
+	}
+	a->left = a->nodes;
+	a->ini_clock = sim_clock;
+	running++;
+}
+
 /**
- *Functions to create app node
- * @return appnode
- */
-appnode createNode(){
-    appnode temp;
-    temp = (appnode)malloc(sizeof(struct AppLinkedList));
-    temp->next=NULL;
-    return temp;
+* Starts the apps waiting that can, as #mpa_queue says.
+*
+* @see mpa_queue_t
+*/
+static void schedule(void) {
+	app_t * a;
+	long i, j, n;
+
+	for (i = 0, n = 0; i < nwaiting; i++) {
+		a = &apps[waiting[i]];
+		if (app_fits(a)) {
+			start_app(a);
+			continue;
+		}
+		waiting[n++] = waiting[i];
+		if (mpa_queue == MPA_FCFS || !a->fixed) {
+			for (i++; i < nwaiting; i++)
+				waiting[n++] = waiting[i];
+			break;
+		}
+		for (j = 0; j < a->nodes; j++)
+			bit_set(held, a->node_list[j]);
+	}
+	nwaiting = n;
+	memset(held, 0, words * sizeof(unsigned long));
 }
+
 /**
- *Function to add app to app linked list with the appnode structure initialized
- * @param head head of app queue
- * @param name name of application
- * @param nodes number of nodes required by application
- * @param nodelist list that contain the node ids
- * @param id Id of app
- * @return head of queue
- */
-appnode addapp(appnode head, char* name, long nodes, long *nodelist, long id){
-    appnode temp, p;
-    temp = createNode();
-    temp->id = id; //todo CONSTANT
-    temp->filename=strdup(name);
-    temp->nodes=nodes;
-    temp->running=0;
-    temp->node_list = malloc(nodes*sizeof(long));
-    temp->node_bmp = calloc(nodes, sizeof(long));
-    memcpy(temp->node_list, nodelist, nodes*sizeof(long));
-    if(head == NULL){
-        head = temp;
-    }else{
-        p=head;
-        while(p->next !=NULL){
-            p=p->next;
-        }
-        p->next = temp;
-    }
-    return head;
+* Prepares the mix: reads the apps and starts the first ones.
+*
+* @see read_trace
+*/
+void mpa_init(void) {
+	long i;
+
+	words = (nprocs + WORD_BITS - 1) / WORD_BITS;
+	busy = alloc(words * sizeof(unsigned long));
+	held = alloc(words * sizeof(unsigned long));
+	memset(busy, 0, words * sizeof(unsigned long));
+	memset(held, 0, words * sizeof(unsigned long));
+	for (i = nprocs; i < words * WORD_BITS; i++)	// No app can take them.
+		bit_set(busy, i);
+	nfree = nprocs;
+
+	read_apps();
+	schedule();
 }
+
 /**
- * Function used to delete app from app queue
- * @param id Id of app
- */
-void d_app(long id){
-    appnode prev;
-    appnode actual;
-    actual=head;
-    int i;
-    long temp;
-
-
-    if(head==NULL){
-        panic("appmix: Error deleting node, list is empty!");
-    }else{
-        while(actual!=NULL){
-            if(actual->id==id){
-                actual->end_clock=sim_clock;
-                printf("App %s with id %lld :Tiempo inicio:%lld, tiempo final: %lld\n",actual->filename, actual->id,actual->ini_clock, actual->end_clock);
-                break;
-            }else{
-                prev=actual;
-                actual=actual->next;
-            }
-        }
-        if(actual==NULL){
-            panic("appmix: Error deleting app, no app with given id exists!");
-        }else{
-            for(i=0; i<actual->nodes; i++){
-
-                temp = actual->node_list[i];
-                network[temp].source=INDEPENDENT_SOURCE;
-                network[temp].appid=0;
-                init_event(&network[temp].events);
-                init_occur(&network[temp].occurs);
-            }
-        }
-    }
-    if(head->id==actual->id){
-        head=actual->next;
-    }else{
-        if (actual->next == NULL) {
-            prev->next = NULL;
-        } else {
-            prev->next = actual->next;
-        }
-    }
-    free(actual);
+* A node has run out of events. When all the nodes of its app have, the app finishes, its
+* nodes are freed and the apps waiting that can are started.
+*
+* Called from generate_pkt(), only once for each node of a running app.
+*
+* @param node The node.
+*/
+void mpa_node_finished(long node) {
+	app_t * a = &apps[network[node].appid];
+	long i, n;
+
+	network[node].source = FINISHED;
+	if (--a->left > 0)
+		return;
+
+	a->end_clock = sim_clock;
+	printf("App %s with id %ld :Tiempo inicio:%" PRINT_CLOCK ", tiempo final: %" PRINT_CLOCK "\n",
+			a->trace->name, (long)(a - apps), a->ini_clock, a->end_clock);
+	for (i = 0; i < a->nodes; i++) {
+		n = a->node_list[i];
+		network[n].source = INDEPENDENT_SOURCE;
+		network[n].appid = 0;
+		wake_source(n);
+		init_event(&network[n].events);
+		finish_occur(&network[n].occurs);
+		bit_clear(busy, n);
+	}
+	nfree += a->nodes;
+	running--;
+	schedule();
+#if (SKIP_CPU_BURSTS==1)
+	trace_activity = sim_clock;
+#endif
 }
+
 /**
- * Function used to check if all the nodes required by the app are available
- * @param nodelist List of nodes required by the app
- * @param nodes Number of nodes required by the app
- * @return
- */
-int check_node_disp(long *nodelist, long nodes){
-    int i;
-    for (i = 0;  i<nodes ; i++) {
-        if(network[nodelist[i]].source==OTHER_SOURCE || network[nodelist[i]].source==FINISHED){
-          return 1;
-        }
-    }
-    return 0;
+* Are there apps running or waiting?
+*
+* @return TRUE if the mix has not finished.
+*/
+bool_t mpa_pending(void) {
+	return (running > 0 || nwaiting > 0);
 }
+
 /**
- * Function used to set a node of an app as finished using a bitmap to represent it
- * @param node Id of node
- * @param id Id of app
- */
-void set_bitmap(long node, long id){
-    appnode actual;
-    actual = head;
-    int i;
-    while(actual!=NULL){
-        if(actual->id==id){
-            break;
-        }else{
-            actual=actual->next;
-        }
-    }
-
-    for(i=0; i<actual->nodes; i++){
-        if(actual->node_list[i]==node){
-            actual->node_bmp[i]=1;
-            break;
-        }
-    }
+* Writes the state of the mix in a checkpoint, or reads it: the nodes of the apps, the queue
+* of apps waiting and the nodes in use. The mix has to be read before.
+*
+* @param f The checkpoint.
+* @param save TRUE to write the state, FALSE to read it.
+*/
+void mpa_checkpoint(FILE *f, bool_t save) {
+	long i, n = napps;
+
+	ckp_var(f, n, save);
+	if (n != napps)
+		panic("Checkpoint taken with another mix of apps");
+	for (i = 0; i < napps; i++) {
+		ckp_data(f, apps[i].node_list, apps[i].nodes * sizeof(long), save);
+		ckp_var(f, apps[i].left, save);
+		ckp_var(f, apps[i].ini_clock, save);
+		ckp_var(f, apps[i].end_clock, save);
+	}
+	ckp_var(f, nwaiting, save);
+	if (nwaiting < 0 || nwaiting > napps)
+		panic("Wrong queue of apps in checkpoint");
+	ckp_data(f, waiting, nwaiting * sizeof(long), save);
+	ckp_var(f, running, save);
+	ckp_var(f, nfree, save);
+	ckp_data(f, busy, words * sizeof(unsigned long), save);
+	ckp_data(f, held, words * sizeof(unsigned long), save);
 }
 
 /**
- * Function used to check if an app has finished
- * @param id Id of app
- * @return 1 if app has ended, 0 if not.
- */
-int check_finished_app(long id){
-    appnode actual;
-    actual = head;
-    int i;
-    while(actual!=NULL){
-        if(actual->id==id){
-            break;
-        }else{
-            actual=actual->next;
-        }
-    }
-    for(i=0; i<actual->nodes; i++){
-        if(actual->node_bmp[i]==0){
-            return 0;
-        }
-    }
-    return 1;
-}
\ No newline at end of file
+* Frees the memory of the mix.
+*/
+void mpa_finish(void) {
+	app_trace * t;
+	long i;
+
+	for (i = 0; i < napps; i++)
+		free(apps[i].node_list);
+	free(apps);
+	free(waiting);
+	while ((t = traces) != NULL) {
+		traces = t->next;
+		free(t->name);
+		free(t->first);
+		free(t->ev);
+		free(t);
+	}
+	free(busy);
+	free(held);
+	apps = NULL;
+	napps = nwaiting = running = 0;
+}
+
+#endif /* TRACE_SUPPORT */
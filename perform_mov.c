@@ -18,9 +18,18 @@ along with this program; if not, write to the Free Software
 Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
+#include <string.h>
+
 #include "globals.h"
 
 static void phit_moved(long i, long n_n, port_type s_p, port_type d_p, phit ph);
+
+
+static unsigned long * active;	///< Bitmap of the routers holding phits. Only kept when using the worklist.
+static unsigned long * pending;	///< Bitmap of the nodes that may have something to generate.
+static long active_words;		///< Number of words in #active and #pending.
+static void (*route_router)(long i);	///< Requests & arbitration of a router, for the worklist.
+static void (*move_router)(long i);		///< Consumption & advance of a router, for the worklist.
 //static void drop_transit(long i);
 
 /**
@@ -41,7 +50,7 @@ void drop_transit(long i){
 	abort_sim("Should not be dropping packet when execution-driven simulation");
 #endif
 	for (s_p=0; s_p<p_con; s_p++) {
-		if (network[i].p[s_p].aop == p_drop) {
+		if (network[i].aop[s_p] == p_drop) {
 			rem_queue(&(network[i].p[s_p].q), &ph);	// Drop
 			dropped_phit_count++;
 #if (PCOUNT!=0)
@@ -54,9 +63,9 @@ void drop_transit(long i){
 						sim_clock, i, ph.packet, sim_clock - pkt_space[ph.packet].inj_time );
 
 			if (ph.pclass >= TAIL) { // TAIL or RR_TAIL
-				network[i].p[s_p].aop = P_NULL; // Free reservation
-				network[i].p[p_con].sip = P_NULL;
-				network[i].p[s_p].tor = CLOCK_MAX;
+				network[i].aop[s_p] = P_NULL; // Free reservation
+				network[i].sip[p_con] = P_NULL;
+				network[i].tor[s_p] = CLOCK_MAX;
 				transit_dropped_count++;
 				free_pkt(ph.packet);
 				if (plevel & 16)
@@ -80,17 +89,15 @@ void consume_single(long i) {
 	phit ph;		// Phit to moved.
 	queue *q;		// The queue where the phit is stored.
 
-	s_p = network[i].p[p_con].sip;
+	s_p = network[i].sip[p_con];
 	if (s_p == P_NULL)
 		return;		// Nobody has this port assigned
-	if (network[i].p[s_p].aop != p_con)
+	if (network[i].aop[s_p] != p_con)
 		panic("Bad assignment - consume single");
 	q = &(network[i].p[s_p].q);		// Transit queue to get phit from
 	rem_queue(q, &ph);
 	phit_away(i, s_p, ph);
-#if (PCOUNT!=0)
 	network[i].pcount--;
-#endif
 }
 
 /**
@@ -106,15 +113,83 @@ void consume_multiple(long i) {
 	phit ph;
 
 	for (s_p=0; s_p<p_inj_first; s_p++) {
-		if (network[i].p[s_p].aop == p_con) {
+		if (network[i].aop[s_p] == p_con) {
 			rem_queue(&(network[i].p[s_p].q), &ph);	// Consume NOW
 			if (i>=nprocs)
 				printf ("WARNING: Packet consumed in switching element %ld [%ld -> %ld] %ld!!!\n",i,pkt_space[ph.packet].to, pkt_space[ph.packet].from, pkt_space[ph.packet].n_hops );
 			phit_away(i, s_p, ph);
-#if (PCOUNT!=0)
 			network[i].pcount--;
+		}
+	}
+}
+
+/**
+* Requests & arbitration in a router of a direct topology.
+*
+* This is the first phase of the cycle, and only touches the router itself, so it
+* can be performed in parallel for different routers.
+*
+* @param i The node id.
+*
+* @see data_movement_direct
+*/
+void route_router_direct(long i) {
+	long e;	// port number
+
+#if (PCOUNT!=0)
+	if (network[i].pcount){
 #endif
+		network[i].req_gen++;	// Voids the requests of the previous cycles.
+		for (e=0; e<p_con; e++)
+			request_port(i, e);
+		prof_phase(PROF_ARBITRATION);
+		arbitrate_cons(i);
+		for (e=0; e<p_con; e++)
+			arbitrate(i, e);
+
+		// Congestion with timeouts.
+		if (timeout_upper_limit>0) {
+			network[i].timeout_counter++;
+			if (network[i].timeout_counter > timeout_upper_limit){
+				network[i].congested = (network[i].timeout_packet != NULL_PORT);
+				network[i].timeout_counter = (CLOCK_TYPE) 0L;
+				network[i].timeout_packet = NULL_PACKET;
+			}
 		}
+#if (PCOUNT!=0)
+	}
+#endif
+}
+
+/**
+* Consumption & advance of the phits of a router in a direct topology.
+*
+* @param i The node id.
+*/
+void move_router_direct(long i) {
+	dim j;
+
+	prof_count(prof_visits);
+	consume(i);
+	for (j=D_X; j<radix; j++)
+		advance(i, j);
+}
+
+/**
+* Consumption & advance of the phits in a direct topology.
+*
+* This is the second phase of the cycle, in which the phits move between routers.
+*
+* @see data_movement_direct
+*/
+void move_phits_direct(void) {
+	long i;	// Node id
+
+	for (i=0; i<NUMNODES; i++) {
+#if (PCOUNT!=0)
+		if (network[i].pcount)
+#endif
+			move_router_direct(i);
 	}
 }
 
@@ -127,55 +202,127 @@ void consume_multiple(long i) {
 * @see data_movement
 */
 void data_movement_direct(bool_t inject) {
-	long i,	// Node id
-		 e,	// port number
-		 ee;// port requested by port 'e'
-	dim j;
+	long i;	// Node id
 
 	for (i=0; i<NUMNODES; i++) {
-		if (plevel & 8)
+		if (plevel & 8) {
+			prof_phase(PROF_STATS);
 			stats(i);
-		if (inject)
+		}
+		if (inject) {
+			prof_phase(PROF_GENERATION);
 			data_generation(i);
+		}
+		prof_phase(PROF_INJECTION);
 		data_injection(i);
+		prof_phase(PROF_REQUEST);
+		sim_rand_router(i);
+		route_router_direct(i);
+		sim_rand_router(-1);
+	}
+	prof_phase(PROF_MOVE);
+	move_phits_direct();
+	prof_phase(PROF_LOOP);
+	prof_count(prof_cycles);
+}
+
+/**
+* Requests & arbitration in a router of an indirect topology.
+*
+* This is the first phase of the cycle, and only touches the router itself, so it
+* can be performed in parallel for different routers.
+*
+* @param i The node id.
+*
+* @see data_movement_indirect
+*/
+void route_router_indirect(long i) {
+	long e;		// port number
 
+	if (i<nprocs){	// This is a NIC. There are only ports for injection/consumption and 1 output port.
 #if (PCOUNT!=0)
 		if (network[i].pcount){
 #endif
-			for (e=0; e<=p_con; e++)
-				for (ee=0; ee<p_con; ee++)
-					network[i].p[e].req[ee] = (CLOCK_TYPE) 0L;
-			for (e=0; e<p_con; e++)
+			network[i].req_gen++;	// Voids the requests of the previous cycles.
+			for (e = 0; e < (nchan * nnics); e++)	// output port requesting
 				request_port(i, e);
+			for (e = p_inj_first; e<p_con; e++)	// injection port requesting
+				request_port(i, e);
+
+			prof_phase(PROF_ARBITRATION);
 			arbitrate_cons(i);
-			for (e=0; e<p_con; e++)
+			for (e = 0; e < (nchan * nnics); e++)	// output port arbitration
+				arbitrate(i, e);
+			for (e=p_inj_first; e<p_con; e++)	// injection port arbitration
 				arbitrate(i, e);
-
-			// Congestion with timeouts.
-			if (timeout_upper_limit>0) {
-				network[i].timeout_counter++;
-				if (network[i].timeout_counter > timeout_upper_limit){
-					network[i].congested = (network[i].timeout_packet != NULL_PORT);
-					network[i].timeout_counter = (CLOCK_TYPE) 0L;
-					network[i].timeout_packet = NULL_PACKET;
-				}
-			}
 #if (PCOUNT!=0)
 		}
 #endif
 	}
-
-	for (i=0; i<NUMNODES; i++) {
+	else{
 #if (PCOUNT!=0)
 		if (network[i].pcount){
 #endif
-			consume(i);
-			for (j=D_X; j<radix; j++)
-				advance(i, j);
-		}
+			network[i].req_gen++;	// Voids the requests of the previous cycles.
+			for (e=0; e<=p_inj_last; e++)
+				request_port(i, e);
+
+			prof_phase(PROF_ARBITRATION);
+			arbitrate_cons(i);
+			for (e=0; e<p_inj_last; e++)
+				arbitrate(i, e);
 #if (PCOUNT!=0)
+		}
+#endif
+	}
+
+	// Congestion with timeouts.
+	if (timeout_upper_limit>0) {
+		network[i].timeout_counter++;
+		if (network[i].timeout_counter > timeout_upper_limit){
+			network[i].congested = (network[i].timeout_packet != NULL_PORT);
+			network[i].timeout_counter = (CLOCK_TYPE) 0L;
+			network[i].timeout_packet = NULL_PACKET;
+		}
 	}
+}
+
+/**
+* Consumption & advance of the phits of a router in an indirect topology.
+*
+* NICs only have nnics links, switches have radix links.
+*
+* @param i The node id.
+*/
+void move_router_indirect(long i) {
+	dim j;
+
+	prof_count(prof_visits);
+	consume(i);
+	if (i<nprocs)
+		for(j = 0; j < nnics; j++)
+			advance(i, j);
+	else
+		for(j=0; j<radix; j++)
+			advance(i, j);
+}
+
+/**
+* Consumption & advance of the phits in an indirect topology.
+*
+* This is the second phase of the cycle, in which the phits move between routers.
+*
+* @see data_movement_indirect
+*/
+void move_phits_indirect(void) {
+	long i;	// Node id
+
+	for (i=0; i<NUMNODES; i++) {
+#if (PCOUNT!=0)
+		if (network[i].pcount)
 #endif
+			move_router_indirect(i);
+	}
 }
 
 /**
@@ -187,97 +334,276 @@ void data_movement_direct(bool_t inject) {
 * @see data_movement
 */
 void data_movement_indirect(bool_t inject) {
-	long i,		// Node id
-		 e,		// port number
-		 ee;	// port requested by port 'e'
-
-	dim j;
+	long i;		// Node id
 
 	for (i=0; i<NUMNODES; i++) {
-		if (plevel & 8)
+		if (plevel & 8) {
+			prof_phase(PROF_STATS);
 			stats(i);
-		if (i<nprocs){	// This is a NIC. There are only ports for injection/consumption and 1 output port.
-			if (inject)
-				data_generation(i);
-			data_injection(i);
-
-#if (PCOUNT!=0)
-			if (network[i].pcount){
-#endif
-				for (e = 0; e < (nchan * nnics); e++)	// only injection can ask for the output port.
-					for (ee=p_inj_first; ee<p_con; ee++)
-						network[i].p[e].req[ee] = (CLOCK_TYPE) 0L;
-				for (ee = 0; ee < (nchan * nnics); ee++)	// Only the output port can ask for the consumption port.
-					network[i].p[p_con].req[ee] = (CLOCK_TYPE) 0L;
-
-				for (e = 0; e < (nchan * nnics); e++)	// output port requesting
-					request_port(i, e);
-				for (e = p_inj_first; e<p_con; e++)	// injection port requesting
-					request_port(i, e);
-
-				arbitrate_cons(i);
-				for (e = 0; e < (nchan * nnics); e++)	// output port arbitration
-					arbitrate(i, e);
-				for (e=p_inj_first; e<p_con; e++)	// injection port arbitration
-					arbitrate(i, e);
-#if (PCOUNT!=0)
-			}
-#endif
 		}
-		else{
-#if (PCOUNT!=0)
-			if (network[i].pcount){
-#endif
-				for (e=0; e<=p_con; e++)
-					for (ee=0; ee<p_con; ee++)
-						network[i].p[e].req[ee] = (CLOCK_TYPE) 0L;
-				for (e=0; e<=p_inj_last; e++)
-					request_port(i, e);
-
-				arbitrate_cons(i);
-				for (e=0; e<p_inj_last; e++)
-					arbitrate(i, e);
-#if (PCOUNT!=0)
+		if (i<nprocs){
+			if (inject) {
+				prof_phase(PROF_GENERATION);
+				data_generation(i);
 			}
-#endif
+			prof_phase(PROF_INJECTION);
+			data_injection(i);
 		}
+		prof_phase(PROF_REQUEST);
+		sim_rand_router(i);
+		route_router_indirect(i);
+		sim_rand_router(-1);
+	}
+	prof_phase(PROF_MOVE);
+	move_phits_indirect();
+	prof_phase(PROF_LOOP);
+	prof_count(prof_cycles);
+}
+/**
+* Prepares the worklist of active routers.
+*
+* When the worklist is used, only the routers holding phits are visited in each
+* cycle, so the cost of a cycle depends on the number of busy routers instead of
+* the size of the network. Generation is only tried in the nodes of the injection
+* pending set, which starts with all of them.
+*
+* @see data_movement_worklist
+*/
+void worklist_init(void) {
+	long i;
+
+	active_words = (NUMNODES + WORD_BITS - 1) / WORD_BITS;
+	active = alloc(sizeof(unsigned long) * active_words);
+	memset(active, 0, sizeof(unsigned long) * active_words);
+	pending = alloc(sizeof(unsigned long) * active_words);
+	memset(pending, 0, sizeof(unsigned long) * active_words);
+	for (i=0; i<nprocs; i++)
+		wake_source(i);
+
+	if (topo<DIRECT) {
+		route_router = route_router_direct;
+		move_router = move_router_direct;
+	}
+	else {
+		route_router = route_router_indirect;
+		move_router = move_router_indirect;
+	}
+	if (worklist)
+		data_movement = data_movement_worklist;
+}
 
-		// Congestion with timeouts.
-		if (timeout_upper_limit>0) {
-			network[i].timeout_counter++;
-			if (network[i].timeout_counter > timeout_upper_limit){
-				network[i].congested = (network[i].timeout_packet != NULL_PORT);
-				network[i].timeout_counter = (CLOCK_TYPE) 0L;
-				network[i].timeout_packet = NULL_PACKET;
-			}
-		}
+/**
+* Writes the worklist in a checkpoint, or reads it.
+*
+* The active routers are not written. They are found again from the phits held by the
+* routers, already read, because #active is only kept with the worklist and the
+* checkpoint may have been taken without it.
+*
+* @param f The checkpoint.
+* @param save TRUE to write the worklist, FALSE to read it.
+*/
+void worklist_checkpoint(FILE *f, bool_t save) {
+	long i;
+
+	ckp_data(f, pending, sizeof(unsigned long) * active_words, save);
+	if (save)
+		return;
+	memset(active, 0, sizeof(unsigned long) * active_words);
+	for (i=0; i<NUMNODES; i++)
+		if (network[i].pcount)
+			activate_router(i);
+}
+
+void worklist_finish(void) {
+	free(active);
+	free(pending);
+}
+
+/**
+* Adds a router to the worklist. It will be visited until it has no phits.
+*
+* @param i The node id.
+*/
+void activate_router(long i) {
+	active[i / WORD_BITS] |= 1UL << (i % WORD_BITS);
+}
+
+/**
+* Adds a node to the injection pending set, because something may let it generate again.
+*
+* @param i The node id.
+*/
+void wake_source(long i) {
+	pending[i / WORD_BITS] |= 1UL << (i % WORD_BITS);
+}
+
+/**
+* Looks for the next node in a bitmap of nodes.
+*
+* @param set The bitmap, #active or #pending.
+* @param i The first node to look at.
+* @return The id of the first node in the set from i on, or NUMNODES if there is none.
+*/
+static long next_in_set(unsigned long *set, long i) {
+	long k;
+	unsigned long w;
+
+	if (i >= NUMNODES)
+		return NUMNODES;
+	k = i / WORD_BITS;
+	w = set[k] & (~0UL << (i % WORD_BITS));
+	while (!w) {
+		if (++k == active_words)
+			return NUMNODES;
+		w = set[k];
 	}
+	return (k * WORD_BITS) + __builtin_ctzl(w);
+}
 
+/**
+* Looks for the next router in the worklist.
+*
+* @param i The first node to look at.
+* @return The id of the first active router from i on, or NUMNODES if there is none.
+*/
+long next_active_router(long i) {
+	return next_in_set(active, i);
+}
 
-	for (i=0; i<nprocs; i++) {
-#if (PCOUNT!=0)
-		if (network[i].pcount){
-#endif
-			consume(i);
-			for(j = 0; j < nnics; j++)
-				advance(i, j);
-#if (PCOUNT!=0)
-		}
+/**
+* Can a node be left out of the injection pending set after its generation?
+*
+* Only the nodes of a trace that have finished, or that wait for a message not received
+* yet, are sure to generate nothing until phit_away() or the mix wake them again.
+*
+* @param i The node id.
+* @return TRUE if the node has nothing to generate, elseway FALSE.
+*/
+static bool_t source_idle(long i) {
+#if (TRACE_SUPPORT != 0)
+	event e;
+
+	if ((pattern != TRACE && pattern != MPA) || network[i].pending_packet || network[i].triggered)
+		return B_FALSE;
+	if (network[i].source == FINISHED)
+		return B_TRUE;
+	if (network[i].source != OTHER_SOURCE || event_empty(&network[i].events))
+		return B_FALSE;
+	e = head_event(&network[i].events);
+	return (e.type == RECEPTION && !peek_occurred(&network[i].occurs, e));
+#else
+	return B_FALSE;
 #endif
+}
+
+/**
+* Data generation in a node of the injection pending set, taking it out if it goes idle.
+*
+* @param i The node id.
+*/
+static void generate_source(long i) {
+	data_generation(i);
+	if (source_idle(i))
+		pending[i / WORD_BITS] &= ~(1UL << (i % WORD_BITS));
+}
+
+/**
+* Data generation in all the nodes of the injection pending set.
+*
+* When injection is stalled by the global congestion control nothing is generated, so
+* data_generation() is called only once, to account for the stall.
+*/
+void generate_pending_sources(void) {
+	long i;
+
+	if (global_q_u > congestion_limit) {
+		data_generation(0);
+		return;
 	}
+	for (i=next_in_set(pending, 0); i<nprocs; i=next_in_set(pending, i+1))
+		generate_source(i);
+}
 
-	for (i=nprocs; i<NUMNODES; i++) {
-#if (PCOUNT!=0)
-		if (network[i].pcount){
-#endif
-			consume(i);
-			for(j=0; j<radix; j++)
-				advance(i, j);
-#if (PCOUNT!=0)
+/**
+* Consumption & advance of the phits of all the routers in the worklist.
+*
+* Routers left without phits are removed from the worklist. If a neighbour sends them
+* a phit later in the loop, it will add them again.
+*/
+void move_active_routers(void) {
+	long i;
+
+	for (i=next_active_router(0); i<NUMNODES; i=next_active_router(i+1)) {
+		move_router(i);
+		if (!network[i].pcount)
+			active[i / WORD_BITS] &= ~(1UL << (i % WORD_BITS));
+	}
+}
+
+/**
+* Looks for the next node to visit in a cycle of the worklist.
+*
+* @param i The first node to look at.
+* @param inject TRUE if the nodes of the injection pending set have to be visited.
+* @return The id of the first node to visit from i on, or NUMNODES if there is none.
+*/
+static long next_visit(long i, bool_t inject) {
+	long a, s;
+
+	if (plevel & 8)	// The stats are taken in all the nodes.
+		return (i < NUMNODES) ? i : NUMNODES;
+	a = next_in_set(active, i);
+	s = inject ? next_in_set(pending, i) : NUMNODES;
+	return (s < a) ? s : a;
+}
+
+/**
+* Performs the movement of the data visiting only the active routers.
+*
+* Generation is only tried in the nodes of the injection pending set, and injection,
+* requests, arbitration and movement are only performed in the routers holding phits.
+* Each node is visited in the same order, and with the same generate, inject & route
+* steps, as in data_movement_direct(), so the results do not change with the worklist.
+*
+* @param inject If TRUE new data generation is performed.
+*
+* @see worklist_init
+* @see data_movement
+*/
+void data_movement_worklist(bool_t inject) {
+	long i;	// Node id
+
+	if (inject && global_q_u > congestion_limit) {
+		prof_phase(PROF_GENERATION);
+		data_generation(0);	// Only accounts for the stall.
+		inject = B_FALSE;
+	}
+	for (i=next_visit(0, inject); i<NUMNODES; i=next_visit(i+1, inject)) {
+		if (plevel & 8) {
+			prof_phase(PROF_STATS);
+			stats(i);
 		}
-#endif
+		if (inject && (pending[i / WORD_BITS] & (1UL << (i % WORD_BITS)))) {
+			prof_phase(PROF_GENERATION);
+			generate_source(i);
+		}
+		if (!(active[i / WORD_BITS] & (1UL << (i % WORD_BITS))))
+			continue;
+		if (i<nprocs) {
+			prof_phase(PROF_INJECTION);
+			data_injection(i);
+		}
+		prof_phase(PROF_REQUEST);
+		sim_rand_router(i);
+		route_router(i);
+		sim_rand_router(-1);
 	}
+	prof_phase(PROF_MOVE);
+	move_active_routers();
+	prof_phase(PROF_LOOP);
+	prof_count(prof_cycles);
 }
+
 /**
 * Advance packets.
 *
@@ -300,9 +626,9 @@ void advance(long n, long p) {
 
 	for (visited=0; visited<nchan; visited++) {
 		d_p = port_address(p, l);
-		s_p = network[n].p[d_p].sip;
+		s_p = network[n].sip[d_p];
 		if (s_p != P_NULL) {
-			if (network[n].p[s_p].aop != d_p)
+			if (network[n].aop[s_p] != d_p)
 			{
 				char message[100];
 				sprintf(message, "Bad assignment - move port ::: node %ld, port %ld, d_p %ld, s_p %ld", n,p, d_p, s_p);
@@ -320,16 +646,17 @@ void advance(long n, long p) {
 			d_np= port_address(network[n].nborp[p],l);
 
 			phit_moved(n, n_n, s_p, d_np, ph);
-#if (PCOUNT!=0)
+			prof_count(prof_phits);
 			network[n].pcount--;
 			network[n_n].pcount++;
-#endif
+			if (worklist)
+				activate_router(n_n);
 
 			if (ph.pclass >= TAIL) {
 				network[n].op_i[p] = (l+1)%nchan;	// Next time assign to another virtual channel
-				network[n].p[s_p].aop = P_NULL;		// Free reservations
-				network[n].p[s_p].tor = CLOCK_MAX;
-				network[n].p[d_p].sip = P_NULL;
+				network[n].aop[s_p] = P_NULL;		// Free reservations
+				network[n].tor[s_p] = CLOCK_MAX;
+				network[n].sip[d_p] = P_NULL;
 			}
 			return;
 		}
@@ -368,14 +695,15 @@ void phit_away(long i, port_type s_p, phit ph) {
 	}
 
 	if (ph.pclass >= TAIL) { // TAIL or RR_TAIL
-		network[i].p[s_p].aop = P_NULL; // Free reservation
-		network[i].p[p_con].sip = P_NULL;
-		network[i].p[s_p].tor = CLOCK_MAX;
+		network[i].aop[s_p] = P_NULL; // Free reservation
+		network[i].sip[p_con] = P_NULL;
+		network[i].tor[s_p] = CLOCK_MAX;
 		del = sim_clock - pkt_space[ph.packet].inj_time;
 		acum_delay += del;
 		acum_sq_delay += del*del;
 		if (rand()<= trigger)
 			network[i].triggered += trigger_min + rand()%trigger_dif;
+		wake_source(i);	// It may be waiting for this packet, or have been triggered by it.
 
 		if (del > max_delay)
 			max_delay = del;
@@ -406,7 +734,11 @@ void phit_away(long i, port_type s_p, phit ph) {
 			e.pid=pkt_space[ph.packet].from;
 			e.task=pkt_space[ph.packet].task;
 			e.length=pkt_space[ph.packet].length;
-			ins_occur(&network[i].occurs, e);
+			if (e.length)	// Background traffic is not part of any message.
+				ins_occur(&network[i].occurs, e);
+#if (SKIP_CPU_BURSTS==1)
+			trace_activity = sim_clock;
+#endif
 		}
 #endif
 
@@ -504,7 +836,7 @@ void phit_moved(long i, long n_n, port_type s_p, port_type d_p, phit ph) {
                         }
 #endif /* BIMODAL */
 			if (i == monitored)
-				dest_ports[network[i].p[s_p].aop]++;
+				dest_ports[network[i].aop[s_p]]++;
 		}/* injection */
 		pkt_space[ph.packet].n_hops++;
 	}/* RR */
@@ -519,8 +851,8 @@ void phit_moved(long i, long n_n, port_type s_p, port_type d_p, phit ph) {
 		if (ph.pclass >= TAIL)
 			printf("T: %"PRINT_CLOCK" - N: %4ld Packet(id %5ld) leaves node\n", sim_clock, i, ph.packet);
 	}
-	network[i].p[network[i].p[s_p].aop].utilization++;
+	network[i].utilization[network[i].aop[s_p]]++;
 	if (i == monitored)
-		port_utilization[network[i].p[s_p].aop]++;
+		port_utilization[network[i].aop[s_p]]++;
 }
 
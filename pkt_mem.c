@@ -20,6 +20,7 @@ along with this program; if not, write to the Free Software
 Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
+#include <string.h>
 #include "globals.h"
 #include "packet.h"
 
@@ -50,6 +51,31 @@ long * f_pkt;
 */
 long last;
 
+/**
+* Space for the routing records of the packets, in blocks of #rr_cap longs.
+*
+* There is a block for each packet, plus another one for the routing record being calculated
+* before the packet is taken from pkt_space.
+*
+* @see rr_init
+*/
+long * rr_space;
+
+/**
+* The capacity of each routing record, in longs.
+*/
+long rr_cap;
+
+/**
+* A list with all the free routing records.
+*/
+long ** f_rr;
+
+/**
+* The last position in use on the list of free routing records.
+*/
+long last_rr;
+
 /**
 * Initiates the memory allocation & the free packets structure.
 *
@@ -70,6 +96,64 @@ void pkt_init(){
 	last=pkt_max-1;
 }
 
+/**
+* Initiates the space for the routing records.
+*
+* The capacity of a record is the longest one any routing function can ask for, so it depends on
+* the topology: the number of dimensions in cubes, twice the number of stages in trees, 8 in
+* dragonflies and the routing diameter in graphs. It has to be called once the network is built,
+* as the routing diameter of graphs is known after filling the CAMs.
+*
+* @see rr_alloc
+*/
+void rr_init(){
+	long i;
+
+	rr_cap = 8;								// dragonfly_rr
+	if (ndim + 1 > rr_cap)
+		rr_cap = ndim + 1;					// cubes, icube
+	if (2 * nstages > rr_cap)
+		rr_cap = 2 * nstages;				// trees
+	if (diameter_r + 2 > rr_cap)
+		rr_cap = diameter_r + 2;			// graphs: NIC, switch ports & destination
+	if (vc_management == SPANNING_TREE_MANAGEMENT && NUMNODES - nprocs > rr_cap)
+		rr_cap = NUMNODES - nprocs;			// spanning_tree_rr
+
+	rr_space=alloc(sizeof(long)*rr_cap*(pkt_max+1));
+	f_rr=alloc(sizeof(long*)*(pkt_max+1));
+
+	for(i=0;i<=pkt_max;i++)
+		f_rr[i]=rr_space+(i*rr_cap);
+	last_rr=pkt_max;
+}
+
+/**
+* Gets a free routing record. Used by the routing functions instead of allocating memory.
+*
+* @param n The number of longs needed.
+* @return The routing record.
+*/
+long * rr_alloc(long n){
+	if (n>rr_cap)
+		panic("Routing record too long");
+	if (last_rr<0)
+		panic("Routing record memory is FULL.");
+	return f_rr[last_rr--];
+}
+
+/**
+* Frees a routing record.
+*
+* @param rr The routing record to free. Nothing is done if NULL.
+*/
+void rr_free(long * rr){
+	if (rr==NULL)
+		return;
+	if (last_rr==pkt_max)
+		panic("Too many free routing records");
+	f_rr[++last_rr]=rr;
+}
+
 /**
 * Frees a packet.
 *
@@ -80,8 +164,7 @@ void pkt_init(){
 void free_pkt(unsigned long n){
 	if (last==pkt_max)
 		panic("Too many free packets");
-	if (pkt_space[n].rr.rr!=NULL)
-		free(pkt_space[n].rr.rr);
+	rr_free(pkt_space[n].rr.rr);
 	f_pkt[++last]=n;
 }
 
@@ -96,9 +179,96 @@ unsigned long get_pkt(){
 	return f_pkt[last--];
 }
 
+/**
+* Gets the number of packets in use, i.e. in the injection queues or in the network.
+*
+* @return The number of packets not in the free list.
+*/
+long pkts_in_use(){
+	return pkt_max - 1 - last;
+}
+
+/**
+* Writes a packet in a checkpoint, or reads it.
+*
+* The routing record is written as its position in #rr_space. Any other pointer, as the one
+* left in a packet that has not been routed yet, is read as NULL.
+*
+* @param f The checkpoint.
+* @param p The packet.
+* @param save TRUE to write the packet, FALSE to read it.
+*/
+void packet_checkpoint(FILE *f, packet_t *p, bool_t save){
+	packet_t c = *p;
+	long k = -1;
+
+	if (save && p->rr.rr >= rr_space && p->rr.rr < rr_space + (rr_cap * (pkt_max + 1)))
+		k = p->rr.rr - rr_space;
+	c.rr.rr = NULL;
+	ckp_var(f, c, save);
+	ckp_var(f, k, save);
+	if (!save){
+		if (k < -1 || k >= rr_cap * (pkt_max + 1))
+			panic("Wrong routing record in checkpoint");
+		c.rr.rr = (k < 0) ? NULL : rr_space + k;
+		*p = c;
+	}
+}
+
+/**
+* Writes the packets and the routing records in a checkpoint, or reads them.
+*
+* The lists of free packets and records are written as they are, so they are taken in the
+* same order when resuming, and then the packets and records in use.
+*
+* @param f The checkpoint.
+* @param save TRUE to write them, FALSE to read them.
+*/
+void pkt_checkpoint(FILE *f, bool_t save){
+	char *used = alloc(pkt_max + 1);
+	long i, k = rr_cap;
+
+	ckp_var(f, k, save);
+	if (k != rr_cap)
+		panic("Checkpoint taken with another size of routing records");
+
+	ckp_var(f, last, save);
+	if (last < -1 || last >= pkt_max)
+		panic("Wrong packet pool in checkpoint");
+	ckp_data(f, f_pkt, sizeof(long) * (last + 1), save);
+	memset(used, 1, pkt_max);
+	for (i=0; i<=last; i++){
+		if (f_pkt[i] < 0 || f_pkt[i] >= pkt_max)
+			panic("Wrong packet pool in checkpoint");
+		used[f_pkt[i]] = 0;
+	}
+	for (i=0; i<pkt_max; i++)
+		if (used[i])
+			packet_checkpoint(f, &pkt_space[i], save);
+
+	ckp_var(f, last_rr, save);
+	if (last_rr < -1 || last_rr > pkt_max)
+		panic("Wrong routing record pool in checkpoint");
+	memset(used, 1, pkt_max + 1);
+	for (i=0; i<=last_rr; i++){
+		k = f_rr[i] - rr_space;
+		ckp_var(f, k, save);
+		if (k < 0 || k >= rr_cap * (pkt_max + 1) || k % rr_cap)
+			panic("Wrong routing record pool in checkpoint");
+		f_rr[i] = rr_space + k;
+		used[k / rr_cap] = 0;
+	}
+	for (i=0; i<=pkt_max; i++)
+		if (used[i])
+			ckp_data(f, rr_space + (i * rr_cap), sizeof(long) * rr_cap, save);
+	free(used);
+}
+
 void pkt_finish(){
     
     free(pkt_space);
     free(f_pkt);
+    free(rr_space);
+    free(f_rr);
 
 }
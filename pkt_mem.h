@@ -9,6 +9,10 @@
 void pkt_init();
 void free_pkt(unsigned long n);
 unsigned long get_pkt();
+long pkts_in_use();
+void rr_init();
+long * rr_alloc(long n);
+void rr_free(long * rr);
 
 #endif /* _pkt_mem */
 
@@ -351,6 +351,8 @@ void print_results(time_t start_time, time_t end_time) {
 	else
 		printf("\nRouting in multistage network:    %s\n", routing_s);
 
+	if (threads)
+		printf("Engine threads:                   %ld\n", threads);
 	printf("Parallel injection:               ");
 	if (parallel_injection)
 		printf("YES\n");
@@ -673,7 +675,7 @@ void print_results(time_t start_time, time_t end_time) {
 					for(e=0;e<p_inj_first;e++){
 						if (e%nchan==0)
 							fprintf(fp, ", ");
-						fprintf(fp, ",%0.5lf", 1.0*network[i].p[e].utilization/copyclock);
+						fprintf(fp, ",%0.5lf", 1.0*network[i].utilization[e]/copyclock);
 					}
 				}
 
@@ -694,7 +696,7 @@ void print_results(time_t start_time, time_t end_time) {
 					i = nprocs;	// Do not print the NICs.
 
                                         for(;i<NUMNODES;i++){
-                                            avg_util[e%nchan] +=  (1.0*network[i].p[e].utilization)/copyclock;
+                                            avg_util[e%nchan] +=  (1.0*network[i].utilization[e])/copyclock;
 					}
 				}
                                 if (NUMNODES==nprocs)
@@ -747,7 +749,7 @@ void print_results(time_t start_time, time_t end_time) {
 					for (e=0; e<=p_inj_last; e++){ // port
 						fprintf(fp, " %8ld, %4ld", i, e);
 						for (c=0; c<=buffer_cap; c++) // occupancy
-							fprintf(fp, ", %"PRINT_CLOCK, network[i].p[e].histo[c]);
+							fprintf(fp, ", %"PRINT_CLOCK, port_histo(i, e)[c]);
 						fprintf(fp, "\n");
 					}
 				fprintf(fp, "\n");
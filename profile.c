@@ -0,0 +1,154 @@
+/**
+* @file
+* @brief	Cycle profiler: where the simulation time goes.
+*
+* The phases are marked with prof_phase() in the data movement functions and in the
+* run_network_* loops. Each mark reads the time stamp counter, so the cost while profiling
+* is a few cycles per router and phase. The marks are only compiled with PROFILE=1, as in the
+* insee_n_dim_sim_prof target; otherwise they are removed altogether.
+
+FSIN Functional Simulator of Interconnection Networks
+Copyright (2003-2011) J. Miguel-Alonso, A. Gonzalez, J. Navaridas
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "globals.h"
+
+#if (PROFILE != 0)
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define read_tsc() __rdtsc()	///< The time stamp counter.
+#else
+/**
+* Without time stamp counter the monotonic clock, in ns, is used instead.
+*/
+static unsigned long long read_tsc(void) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (t.tv_sec * 1000000000ULL) + t.tv_nsec;
+}
+#endif
+
+THREAD_LOCAL bool_t prof_on = B_FALSE;	///< Is this thread profiling? Only the main thread does.
+unsigned long long prof_cycles = 0;	///< Cycles performed, i.e. calls to data_movement().
+unsigned long long prof_visits = 0;	///< Routers visited in the movement phase.
+unsigned long long prof_phits = 0;	///< Phits moved between routers.
+unsigned long long prof_allocs = 0;	///< Calls to alloc().
+unsigned long long prof_events = 0;	///< Trace events done.
+
+static unsigned long long init_allocs;	///< Calls to alloc() before the simulation started.
+static unsigned long long ticks[PROF_PHASES];	///< Ticks spent in each phase.
+static prof_phase_t curr;		///< The phase running.
+static unsigned long long last;	///< Ticks when #curr started.
+static unsigned long long first;	///< Ticks when the simulation started.
+static struct timespec first_ts;	///< Time when the simulation started.
+static double read_ns = -1.0;		///< Time spent reading the trace, negative without trace.
+
+static char * phase_name[PROF_PHASES] = {
+	"Statistics",
+	"Generation",
+	"Injection",
+	"Requests",
+	"Arbitration",
+	"Movement",
+	"Run loop"
+};
+
+/**
+* Finishes the phase running and starts another.
+*
+* @param ph The phase to start.
+*/
+void prof_switch(prof_phase_t ph) {
+	unsigned long long now = read_tsc();
+
+	ticks[curr] += now - last;
+	last = now;
+	curr = ph;
+}
+
+/**
+* Starts counting, so the allocations made while building the network are also counted.
+*/
+void profile_init(void) {
+	prof_on = profile;
+}
+
+/**
+* Starts the clocks. Must be called just before running the simulation.
+*/
+void profile_start(void) {
+	if (!prof_on)
+		return;
+	init_allocs = prof_allocs;
+	clock_gettime(CLOCK_MONOTONIC, &first_ts);
+	first = last = read_tsc();
+	curr = PROF_LOOP;
+}
+
+/**
+* Restarts the clocks once the trace has been read, so the time spent reading it is accounted
+* apart and the allocations made while reading are accounted as made before the simulation.
+*/
+void profile_trace_read(void) {
+	struct timespec now_ts;
+
+	if (!prof_on)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &now_ts);
+	read_ns = ((now_ts.tv_sec - first_ts.tv_sec) * 1e9) + (now_ts.tv_nsec - first_ts.tv_nsec);
+	profile_start();
+}
+
+/**
+* Prints the time spent in each phase and some figures of the work performed.
+*
+* The ticks are converted to ns using the time elapsed since profile_start().
+*/
+void print_profile(void) {
+	struct timespec now_ts;
+	double ns, ns_tick, cycles;
+	long ph;
+
+	if (!prof_on)
+		return;
+	prof_switch(PROF_LOOP);
+	clock_gettime(CLOCK_MONOTONIC, &now_ts);
+	ns = ((now_ts.tv_sec - first_ts.tv_sec) * 1e9) + (now_ts.tv_nsec - first_ts.tv_nsec);
+	ns_tick = (last > first) ? ns / (last - first) : 0.0;
+	cycles = prof_cycles ? (double)prof_cycles : 1.0;
+
+	printf("\nPROFILE\n");
+	printf("Cycles performed:                 %llu\n", prof_cycles);
+	printf("Wall time (s):                    %.3f\n", ns / 1e9);
+	printf("Time per cycle (ns):              %.1f\n", ns / cycles);
+	if (threads)
+		printf("Requests & arbitration are performed in parallel, both are accounted as Requests\n");
+	for (ph = 0; ph < PROF_PHASES; ph++)
+		printf("  %-12s ns/cycle: %12.1f  (%5.1f%%)\n", phase_name[ph],
+				(ticks[ph] * ns_tick) / cycles,
+				(last > first) ? (100.0 * ticks[ph]) / (last - first) : 0.0);
+	printf("Phits moved per second:           %.0f\n", ns > 0 ? prof_phits / (ns / 1e9) : 0.0);
+	printf("Routers visited per cycle:        %.1f\n", prof_visits / cycles);
+	printf("Allocations (init, run):          %llu, %llu\n", init_allocs, prof_allocs - init_allocs);
+	if (read_ns >= 0.0) {
+		printf("Trace read time (s):              %.3f\n", read_ns / 1e9);
+		printf("Trace events done:                %llu\n", prof_events);
+		printf("Trace events per second:          %.0f\n", ns > 0 ? prof_events / (ns / 1e9) : 0.0);
+	}
+}
+
+#endif /* PROFILE */
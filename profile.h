@@ -0,0 +1,76 @@
+/**
+* @file
+* @brief	Declaration of the FSIN cycle profiler.
+*
+* The time of the simulation is split in phases. Every time the main thread starts a
+* phase it reads the time stamp counter, and the time since the previous mark is added
+* to the phase that was running.
+
+FSIN Functional Simulator of Interconnection Networks
+Copyright (2003-2011) J. Miguel-Alonso, A. Gonzalez, J. Navaridas
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _profile
+#define _profile
+
+#include "misc.h"
+
+/**
+* Phases of the simulation accounted by the profiler.
+*/
+typedef enum prof_phase_t {
+	PROF_STATS,			///< stats()
+	PROF_GENERATION,	///< data_generation()
+	PROF_INJECTION,		///< data_injection()
+	PROF_REQUEST,		///< request_port()
+	PROF_ARBITRATION,	///< arbitrate_cons() & arbitrate()
+	PROF_MOVE,			///< consume() & advance()
+	PROF_LOOP,			///< The run_network_* loop, out of data_movement()
+	PROF_PHASES			///< Number of phases
+} prof_phase_t;
+
+#if (PROFILE != 0)
+extern THREAD_LOCAL bool_t prof_on;
+extern unsigned long long prof_cycles;
+extern unsigned long long prof_visits;
+extern unsigned long long prof_phits;
+extern unsigned long long prof_allocs;
+extern unsigned long long prof_events;
+
+void prof_switch(prof_phase_t ph);
+void profile_init(void);
+void profile_start(void);
+void profile_trace_read(void);
+void print_profile(void);
+
+/**
+* Starts a phase. Only the main thread does it, and only when profiling.
+*
+* @param ph The phase.
+*/
+#define prof_phase(ph) do { if (prof_on) prof_switch(ph); } while (0)
+
+/**
+* Increases one of the profiler counters.
+*
+* @param c The counter.
+*/
+#define prof_count(c) do { if (prof_on) (c)++; } while (0)
+#else
+#define prof_phase(ph)
+#define prof_count(c)
+#endif /* PROFILE */
+
+#endif /* _profile */
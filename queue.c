@@ -20,6 +20,13 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "globals.h"
 
+/**
+* Slot of the ring for a position (the ring size #tr_qd is a power of two).
+*/
+#define slot(x) ((x) & (tr_qd-1))
+
+#if (PACKET_QUEUES != 0)
+
 /**
 * Initializes a queue.
 *
@@ -29,6 +36,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 void init_queue (queue *q) {
 	q->head = q->tail = 0;
+	q->len = 0;
 }
 
 /**
@@ -38,12 +46,7 @@ void init_queue (queue *q) {
 * @return The number of phits in the queue.
 */
 long queue_len (queue *q) {
-	long aux;
-
-	aux = q->tail - q->head;
-	if (aux < 0)
-		aux += tr_ql;
-	return aux;
+	return q->len;
 }
 
 /**
@@ -53,34 +56,62 @@ long queue_len (queue *q) {
 * @return the number of phits available in the queue.
 */
 long queue_space (queue *q) {
-	long aux;
-
-	aux = q->tail - q->head;
-	if (aux < 0)
-		aux += tr_ql;
-	aux = (tr_ql-1)-aux;
-	return aux;
+	return (tr_ql-1) - q->len;
 }
 
 /**
 * Looks at the first phit of a queue.
 *
-* Requires a non-empty queue. Otherwise, panics
+* Requires a non-empty queue. Otherwise, panics.
+* The phit is built from the head descriptor, so it is only valid until the queue changes.
 *
 * @param q A queue.
 * @return A pointer to the first phit of the queue.
 */
 phit * head_queue (queue *q) {
-	long aux;
+	pkt_desc *d;
 
-	if (queue_len(q) == 0){
+	if (q->len == 0){
 		panic("Asking for the head of an empty queue");
 		return NULL;
 	}
+	d = &q->pos[slot(q->head)];
+	q->hd.packet = d->packet;
+	q->hd.pclass = desc_pclass(d);
+	return &q->hd;
+}
+
+/**
+* Inserts some phits of a packet in a queue.
+*
+* A header phit opens a new descriptor; the rest are added to the last one, which must
+* belong to the same packet, as the phits of a packet always arrive in order.
+*
+* @param q A queue.
+* @param i The phit to be inserted.
+* @param copies Number of phits inserted.
+*/
+static void ins_desc (queue *q, phit *i, long copies) {
+	pkt_desc *d;
+
+	if (i->pclass == RR || i->pclass == RR_TAIL) {
+		if (q->tail - q->head == tr_qd)
+			panic("Inserting a packet in a queue without free descriptors");
+		d = &q->pos[slot(q->tail++)];
+		d->packet = i->packet;
+		d->size = pkt_space[i->packet].size;
+		d->next = 0;
+		d->n = 0;
+	}
 	else {
-		aux = (q->head + 1)%tr_ql;
-		return &((q->pos)[aux]);
+		d = &q->pos[slot(q->tail-1)];
+		if (q->head == q->tail || d->packet != i->packet)
+			panic("Inserting a phit out of its packet");
 	}
+	if (d->next + d->n + copies > d->size)
+		panic("Inserting more phits than those in the packet");
+	d->n += copies;
+	q->len += copies;
 }
 
 /**
@@ -92,12 +123,10 @@ phit * head_queue (queue *q) {
 * @param i The phit to be inserted.
 */
 void ins_queue (queue *q, phit *i) {
-	if (queue_len(q) == (tr_ql-1))
+	if (q->len == (tr_ql-1))
 		panic("Inserting a phit in a full queue");
-	else {
-		q->tail = (q->tail + 1)%tr_ql;
-		(q->pos)[q->tail] = *i;
-	}
+	else
+		ins_desc(q, i, 1);
 }
 
 /**
@@ -110,15 +139,15 @@ void ins_queue (queue *q, phit *i) {
 * @param copies Number of clones of i.
 */
 void ins_mult_queue (queue *q, phit *i, long copies) {
-	long aux;
-
-	for (aux = 0; aux < copies; aux++)
-		if (queue_len(q) == (tr_ql-1))
-			panic("Inserting multiple phits in a full queue");
-		else {
-			q->tail = (q->tail + 1)%tr_ql;
-			(q->pos)[q->tail] = *i;
-		}
+	if (copies <= 0)
+		return;
+	if (q->len + copies > (tr_ql-1))
+		panic("Inserting multiple phits in a full queue");
+	else if (i->pclass == RR || i->pclass == RR_TAIL)
+		for (; copies > 0; copies--)
+			ins_desc(q, i, 1);	// Each one is a different packet.
+	else
+		ins_desc(q, i, copies);
 }
 
 /**
@@ -126,17 +155,162 @@ void ins_mult_queue (queue *q, phit *i, long copies) {
 *
 * Removes the head phit from queue & returns it via "i"
 * Requires a non-empty queue. Otherwise, panics.
+* The descriptor is kept until the last phit of the packet leaves.
 *
 * @param q A queue.
 * @param i The removed phit is returned here.
 */
 void rem_queue (queue *q, phit *i) {
-	if (queue_len(q) == 0)
+	pkt_desc *d;
+
+	if (q->len == 0)
 		panic("Removing the head of an empty queue");
 	else {
-		q->head = (q->head + 1)%tr_ql;
-		*i = (q->pos)[q->head];
+		d = &q->pos[slot(q->head)];
+		i->packet = d->packet;
+		i->pclass = desc_pclass(d);
+		d->next++;
+		d->n--;
+		q->len--;
+		if (d->next == d->size)
+			q->head++;
+	}
+}
+
+/**
+* Removes the head of queue.
+*
+* Does not return anything. Requires a non-empty queue. Otherwise, panics.
+*
+* @param q A queue.
+*/
+void rem_head_queue (queue *q) {
+	rem_mult_queue(q, 1);
+}
+
+/**
+* Removes some phits from the head of a queue.
+*
+* Requires a queue with, at least, that many phits. Otherwise, panics.
+*
+* @param q A queue.
+* @param n The number of phits to remove.
+*/
+void rem_mult_queue (queue *q, long n) {
+	pkt_desc *d;
+	long k;
+
+	if (q->len < n)
+		panic("Removing more phits than those in the queue");
+	q->len -= n;
+	while (n > 0) {
+		d = &q->pos[slot(q->head)];
+		k = (d->n < n) ? d->n : n;
+		d->next += k;
+		d->n -= k;
+		n -= k;
+		if (d->next == d->size)
+			q->head++;
+	}
+}
+
+#else
+
+/**
+* Initializes a queue.
+*
+* Making it empty.
+*
+* @param q The queue to initialize.
+*/
+void init_queue (queue *q) {
+	q->head = q->tail = 0;
+}
+
+/**
+* Calculates the length of a queue.
+*
+* @param q A queue.
+* @return The number of phits in the queue.
+*/
+long queue_len (queue *q) {
+	return q->tail - q->head;
+}
+
+/**
+* Calculates the free space in a queue.
+*
+* The ring may be larger, but the capacity is still #tr_ql - 1 phits.
+*
+* @param q A queue.
+* @return the number of phits available in the queue.
+*/
+long queue_space (queue *q) {
+	return (tr_ql-1) - (q->tail - q->head);
+}
+
+/**
+* Looks at the first phit of a queue.
+*
+* Requires a non-empty queue. Otherwise, panics
+*
+* @param q A queue.
+* @return A pointer to the first phit of the queue.
+*/
+phit * head_queue (queue *q) {
+	if (q->tail == q->head){
+		panic("Asking for the head of an empty queue");
+		return NULL;
 	}
+	else
+		return &((q->pos)[slot(q->head)]);
+}
+
+/**
+* Inserts a phit in a queue.
+*
+* Requires a buffer with room for the phit. Otherwise, panics
+*
+* @param q A queue.
+* @param i The phit to be inserted.
+*/
+void ins_queue (queue *q, phit *i) {
+	if (q->tail - q->head == (tr_ql-1))
+		panic("Inserting a phit in a full queue");
+	else
+		(q->pos)[slot(q->tail++)] = *i;
+}
+
+/**
+* Inserts many (identical) copies of a phit "i" in queue "q"
+*
+* Requires enough space. Otherwise, panics.
+*
+* @param q A queue.
+* @param i The phit to be cloned & inserted.
+* @param copies Number of clones of i.
+*/
+void ins_mult_queue (queue *q, phit *i, long copies) {
+	if (q->tail - q->head + copies > (tr_ql-1))
+		panic("Inserting multiple phits in a full queue");
+	for (; copies > 0; copies--)
+		(q->pos)[slot(q->tail++)] = *i;
+}
+
+/**
+* Take the first phit in a queue.
+*
+* Removes the head phit from queue & returns it via "i"
+* Requires a non-empty queue. Otherwise, panics.
+*
+* @param q A queue.
+* @param i The removed phit is returned here.
+*/
+void rem_queue (queue *q, phit *i) {
+	if (q->tail == q->head)
+		panic("Removing the head of an empty queue");
+	else
+		*i = (q->pos)[slot(q->head++)];
 }
 
 /**
@@ -147,9 +321,49 @@ void rem_queue (queue *q, phit *i) {
 * @param q A queue.
 */
 void rem_head_queue (queue *q) {
-	if (queue_len(q) == 0)
+	if (q->tail == q->head)
 		panic("Removing the head of an empty queue");
 	else
-		q->head = (q->head + 1)%tr_ql;
+		q->head++;
+}
+
+/**
+* Removes some phits from the head of a queue.
+*
+* Requires a queue with, at least, that many phits. Otherwise, panics.
+*
+* @param q A queue.
+* @param n The number of phits to remove.
+*/
+void rem_mult_queue (queue *q, long n) {
+	if (q->tail - q->head < n)
+		panic("Removing more phits than those in the queue");
+	else
+		q->head += n;
 }
 
+#endif /* PACKET_QUEUES */
+
+/**
+* Writes a queue in a checkpoint, or reads it.
+*
+* Only the slots in use are written.
+*
+* @param f The checkpoint.
+* @param q A queue.
+* @param save TRUE to write the queue, FALSE to read it.
+*/
+void queue_checkpoint (FILE *f, queue *q, bool_t save) {
+	long k;
+
+	ckp_var(f, q->head, save);
+	ckp_var(f, q->tail, save);
+	if (q->tail - q->head < 0 || q->tail - q->head > tr_qd)
+		panic("Wrong queue in checkpoint");
+#if (PACKET_QUEUES != 0)
+	ckp_var(f, q->len, save);
+	ckp_var(f, q->hd, save);
+#endif /* PACKET_QUEUES */
+	for (k = q->head; k < q->tail; k++)
+		ckp_var(f, q->pos[slot(k)], save);
+}
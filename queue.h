@@ -5,27 +5,72 @@
 #ifndef _queue
 #define _queue
 
+#include <stdio.h>
 #include "phit.h"
 #include "misc.h"
 
+#if (PACKET_QUEUES != 0)
+
+/**
+* A packet (or the part of it) stored in a queue.
+*
+* The phits are not stored, their class is given by their position in the packet.
+*/
+typedef struct pkt_desc {
+    unsigned long packet;   ///< The id of the packet.
+    long size;              ///< The size of the packet, in phits.
+    long next;              ///< Position in the packet of the first phit in the queue. The previous ones have left already.
+    long n;                 ///< Number of phits of the packet in the queue.
+} pkt_desc;
+
+/**
+* The class of the first phit in a descriptor.
+*/
+#define desc_pclass(d) ((d)->next == 0 ? ((d)->size == 1 ? RR_TAIL : RR) : ((d)->next == (d)->size-1 ? TAIL : INFO))
+
+/**
+* This structure defines a transit queue.
+*/
+typedef struct queue {
+    long head;      ///< Number of descriptors removed. The head is in slot head & (#tr_qd-1)
+    long tail;      ///< Number of descriptors inserted
+    long len;       ///< Number of phits in the queue
+    pkt_desc * pos; ///< size = #tr_qd
+    phit hd;        ///< The head phit, as returned by head_queue
+} queue;
+
+/**
+* This structure defines an injection queue.
+*/
+typedef struct inj_queue {
+    long head;      ///< Number of descriptors removed. The head is in slot head & (#inj_qd-1)
+    long tail;      ///< Number of descriptors inserted
+    long len;       ///< Number of phits in the queue
+    pkt_desc * pos; ///< size = #inj_qd
+} inj_queue;
+
+#else
+
 /**
 * This structure defines a transit queue.
 */
 typedef struct queue {
-    long head;  ///< Points to the item just before the head
-    long tail;  ///< Points to the last item inserted
-    phit * pos; ///< size = MAX_QUEUE_LEN
+    long head;  ///< Number of phits removed. The head is in slot head & (#tr_qd-1)
+    long tail;  ///< Number of phits inserted
+    phit * pos; ///< size = #tr_qd
 } queue;
 
 /**
 * This structure defines an injection queue.
 */
 typedef struct inj_queue {
-    long head;  ///< Points to the item just before the head
-    long tail;  ///< Points to the last item inserted
-    phit * pos; ///< size = MAX_INJ_QUEUE_LEN
+    long head;  ///< Number of phits removed. The head is in slot head & (#inj_qd-1)
+    long tail;  ///< Number of phits inserted
+    phit * pos; ///< size = #inj_qd
 } inj_queue;
 
+#endif /* PACKET_QUEUES */
+
 // some declarations in queue.c.
 void init_queue (queue *q);
 long queue_len (queue *q);
@@ -35,6 +80,8 @@ void ins_queue (queue *q, phit *i);
 void ins_mult_queue (queue *q, phit *i, long copies);
 void rem_queue (queue *q, phit *i);
 void rem_head_queue (queue *q);
+void rem_mult_queue (queue *q, long n);
+void queue_checkpoint (FILE *f, queue *q, bool_t save);
 
 // some declarations in queue_inj.c.
 void inj_init_queue (inj_queue *q);
@@ -43,8 +90,11 @@ long inj_queue_space (inj_queue *q);
 void inj_ins_queue (inj_queue *q, phit *i);
 void inj_ins_mult_queue (inj_queue *q, phit *i, long copies);
 void inj_rem_queue (inj_queue *q, phit *i);
+void inj_move_queue (inj_queue *ib, queue *iq);
+void inj_queue_checkpoint (FILE *f, inj_queue *q, bool_t save);
 
 #endif /* _queue */
 
 
 
+
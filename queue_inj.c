@@ -20,6 +20,13 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "globals.h"
 
+/**
+* Slot of the ring for a position (the ring size #inj_qd is a power of two).
+*/
+#define slot(x) ((x) & (inj_qd-1))
+
+#if (PACKET_QUEUES != 0)
+
 /**
 * Initializes an injection queue.
 *
@@ -29,6 +36,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 void inj_init_queue (inj_queue *q) {
 	q->head = q->tail = 0;
+	q->len = 0;
 }
 
 /**
@@ -38,11 +46,7 @@ void inj_init_queue (inj_queue *q) {
 * @return The number of phits in the injection queue.
 */
 long inj_queue_len (inj_queue *q) {
-	long aux;
-
-	aux = q->tail - q->head;
-	if (aux < 0) aux += inj_ql;
-	return aux;
+	return q->len;
 }
 
 /**
@@ -52,12 +56,39 @@ long inj_queue_len (inj_queue *q) {
 * @return the number of free phits in the injection queue.
 */
 long inj_queue_space (inj_queue *q) {
-	long aux;
+	return (inj_ql-1) - q->len;
+}
 
-	aux = q->tail - q->head;
-	if (aux < 0) aux += inj_ql;
-	aux = (inj_ql-1)-aux;
-	return aux;
+/**
+* Inserts some phits of a packet in an injection queue.
+*
+* A header phit opens a new descriptor; the rest are added to the last one.
+* 
+* @param q An injection queue.
+* @param i The phit to insert.
+* @param copies Number of phits inserted.
+*/
+static void inj_ins_desc (inj_queue *q, phit *i, long copies) {
+	pkt_desc *d;
+
+	if (i->pclass == RR || i->pclass == RR_TAIL) {
+		if (q->tail - q->head == inj_qd)
+			panic("Inserting a packet in an injection queue without free descriptors");
+		d = &q->pos[slot(q->tail++)];
+		d->packet = i->packet;
+		d->size = pkt_space[i->packet].size;
+		d->next = 0;
+		d->n = 0;
+	}
+	else {
+		d = &q->pos[slot(q->tail-1)];
+		if (q->head == q->tail || d->packet != i->packet)
+			panic("Inserting a phit out of its packet in an injection queue");
+	}
+	if (d->next + d->n + copies > d->size)
+		panic("Inserting more phits than those in the packet in an injection queue");
+	d->n += copies;
+	q->len += copies;
 }
 
 /**
@@ -69,12 +100,10 @@ long inj_queue_space (inj_queue *q) {
 * @param i The phit to insert.
 */
 void inj_ins_queue (inj_queue *q, phit *i) {
-	if (inj_queue_len(q) == (inj_ql-1)) 
+	if (q->len == (inj_ql-1)) 
 		panic("Inserting a phit in a full injection queue");
-	else {
-		q->tail = (q->tail + 1)%inj_ql;    
-		(q->pos)[q->tail] = *i;
-	}
+	else
+		inj_ins_desc(q, i, 1);
 }
 
 /**
@@ -87,18 +116,143 @@ void inj_ins_queue (inj_queue *q, phit *i) {
 * @param copies Number of copies of i.
 */
 void inj_ins_mult_queue (inj_queue *q, phit *i, long copies) {
-	long aux;
-
-	for (aux = 0; aux < copies; aux++) {
-		if (inj_queue_len(q) == (inj_ql-1)) 
+	if (copies <= 0)
+		return;
+	if (q->len + copies > (inj_ql-1))
 		panic("Inserting multiple phits in a full injection queue");
-		else {
-			q->tail = (q->tail + 1)%inj_ql;    
-			(q->pos)[q->tail] = *i;
+	else if (i->pclass == RR || i->pclass == RR_TAIL)
+		for (; copies > 0; copies--)
+			inj_ins_desc(q, i, 1);	// Each one is a different packet.
+	else
+		inj_ins_desc(q, i, copies);
+}
+
+/**
+* Take the first phit in an injection queue.
+* 
+* Removes the head phit from the injection queue & returns it.
+* Requires a non-empty queue. Otherwise, panics.
+* 
+* @param q An injection queue.
+* @param i The removed phit is returned here.
+*/
+void inj_rem_queue (inj_queue *q, phit *i) {
+	pkt_desc *d;
+
+	if (q->len == 0) 
+		panic("Removing the head of an empty injection queue");
+	else {
+		d = &q->pos[slot(q->head)];
+		i->packet = d->packet;
+		i->pclass = desc_pclass(d);
+		d->next++;
+		d->n--;
+		q->len--;
+		if (d->next == d->size)
+			q->head++;
+	}
+}
+
+/**
+* Moves phits from an injection queue to a transit queue.
+*
+* As many as those in the injection queue or as fit in the transit queue. The phits are
+* moved a packet at a time.
+*
+* @param ib An injection queue.
+* @param iq A transit queue.
+*/
+void inj_move_queue (inj_queue *ib, queue *iq) {
+	pkt_desc *d;
+	phit ph;
+	long k;
+
+	while (queue_space(iq) && ib->len) {
+		d = &ib->pos[slot(ib->head)];
+		k = queue_space(iq);
+		if (d->n < k)
+			k = d->n;
+		ph.packet = d->packet;
+		ph.pclass = desc_pclass(d);
+		ins_queue(iq, &ph);	// Opens the descriptor in the transit queue if it is the header.
+		if (k > 1) {
+			ph.pclass = INFO;
+			ins_mult_queue(iq, &ph, k-1);
 		}
+		d->next += k;
+		d->n -= k;
+		ib->len -= k;
+		if (d->next == d->size)
+			ib->head++;
 	}
 }
 
+#else
+
+/**
+* Initializes an injection queue.
+*
+* Making it empty.
+* 
+* @param q The injection queue to be initialized.
+*/
+void inj_init_queue (inj_queue *q) {
+	q->head = q->tail = 0;
+}
+
+/**
+* Calculates the length of an injection queue.
+* 
+* @param q An injection queue.
+* @return The number of phits in the injection queue.
+*/
+long inj_queue_len (inj_queue *q) {
+	return q->tail - q->head;
+}
+
+/**
+* Calculates the free space in an injection queue.
+*
+* The ring may be larger, but the capacity is still #inj_ql - 1 phits.
+* 
+* @param q An injection queue.
+* @return the number of free phits in the injection queue.
+*/
+long inj_queue_space (inj_queue *q) {
+	return (inj_ql-1) - (q->tail - q->head);
+}
+
+/**
+* Inserts a phit in an injection queue.
+*
+* Requires a buffer with room for the phit. Otherwise, panics
+* 
+* @param q An injection queue.
+* @param i The phit to insert.
+*/
+void inj_ins_queue (inj_queue *q, phit *i) {
+	if (q->tail - q->head == (inj_ql-1)) 
+		panic("Inserting a phit in a full injection queue");
+	else
+		(q->pos)[slot(q->tail++)] = *i;
+}
+
+/**
+* Inserts some clones of a phit in an injection queue.
+* 
+* Requires enough space. Otherwise, panics.
+* 
+* @param q An injection queue.
+* @param i The phit to be inserted.
+* @param copies Number of copies of i.
+*/
+void inj_ins_mult_queue (inj_queue *q, phit *i, long copies) {
+	if (q->tail - q->head + copies > (inj_ql-1)) 
+		panic("Inserting multiple phits in a full injection queue");
+	for (; copies > 0; copies--)
+		(q->pos)[slot(q->tail++)] = *i;
+}
+
 /**
 * Take the first phit in an injection queue.
 * 
@@ -109,11 +263,50 @@ void inj_ins_mult_queue (inj_queue *q, phit *i, long copies) {
 * @param i The removed phit is returned here.
 */
 void inj_rem_queue (inj_queue *q, phit *i) {
-	if (inj_queue_len(q) == 0) 
+	if (q->tail == q->head) 
 		panic("Removing the head of an empty injection queue");
-	else {
-		q->head = (q->head + 1)%inj_ql;
-		*i = (q->pos)[q->head];
+	else
+		*i = (q->pos)[slot(q->head++)];
+}
+
+/**
+* Moves phits from an injection queue to a transit queue.
+*
+* As many as those in the injection queue or as fit in the transit queue.
+*
+* @param ib An injection queue.
+* @param iq A transit queue.
+*/
+void inj_move_queue (inj_queue *ib, queue *iq) {
+	phit ph;
+
+	while (queue_space(iq) && inj_queue_len(ib)) {
+		inj_rem_queue(ib, &ph);
+		ins_queue(iq, &ph);
 	}
 }
 
+#endif /* PACKET_QUEUES */
+
+/**
+* Writes an injection queue in a checkpoint, or reads it.
+*
+* Only the slots in use are written.
+*
+* @param f The checkpoint.
+* @param q An injection queue.
+* @param save TRUE to write the queue, FALSE to read it.
+*/
+void inj_queue_checkpoint (FILE *f, inj_queue *q, bool_t save) {
+	long k;
+
+	ckp_var(f, q->head, save);
+	ckp_var(f, q->tail, save);
+	if (q->tail - q->head < 0 || q->tail - q->head > inj_qd)
+		panic("Wrong injection queue in checkpoint");
+#if (PACKET_QUEUES != 0)
+	ckp_var(f, q->len, save);
+#endif /* PACKET_QUEUES */
+	for (k = q->head; k < q->tail; k++)
+		ckp_var(f, q->pos[slot(k)], save);
+}
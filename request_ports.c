@@ -26,18 +26,21 @@
 static bool_t check_rr_fully(packet_t * pkt);
 static bool_t check_restrictions (long i, port_type s_p, port_type d_p, bool_t chkbub);
 static void extract_packet (long i, port_type injector);
+static void update_used_chan(long nvc);
+static void add_request(long i, port_type o_p, port_type s_p);
 static bool_t preliminary_check(long i, port_type s_p, bool_t fully_check);
 
-static queue *q;			///< An auxiliary queue that simplifies the code.
-static phit *ph;			///< An auxiliary phit.
-static dim d_d;				///< Destination dim.
-static way d_w;				///< Destination way.
-static port_type d_p;		///< Id of destination port.
-static port_type curr_p;	///< Id of the current port.
-static long id;				///< The id of the switching element.
+static THREAD_LOCAL queue *q;			///< An auxiliary queue that simplifies the code.
+static THREAD_LOCAL phit *ph;			///< An auxiliary phit.
+static THREAD_LOCAL dim d_d;				///< Destination dim.
+static THREAD_LOCAL way d_w;				///< Destination way.
+static THREAD_LOCAL port_type d_p;		///< Id of destination port.
+static THREAD_LOCAL port_type curr_p;	///< Id of the current port.
+static THREAD_LOCAL long id;				///< The id of the switching element.
 
-static bool_t * mt;			///< A Matrix indicating all profitable directions/ways.
-static bool_t * candidates;	///< An array containig all profitable output ports for a given input.
+static THREAD_LOCAL bool_t * mt;			///< A Matrix indicating all profitable directions/ways.
+static THREAD_LOCAL bool_t * candidates;	///< An array containig all profitable output ports for a given input.
+static THREAD_LOCAL port_type * cam_cand;	///< The best ports found by the adaptive CAM selection, to pick one at random.
 
 /**
  * Prepare arrays mt and candidates.
@@ -49,14 +52,22 @@ static bool_t * candidates;	///< An array containig all profitable output ports
  *
  * candidates extends that list, and contains all profitable output ports for a given input.
  *
+ * cam_cand holds the best ports to a destination when the CAMs select them adaptively.
+ *
+ * These arrays, as the rest of the scratch variables of this file, are thread-local: each worker
+ * of the multi-threaded engine calls this function to get its own copy.
+ *
  * @see mt.
  * @see candidates.
+ * @see cam_cand.
  */
 void request_ports_init(void) {
     if (topo<DIRECT){
         mt = alloc(sizeof(bool_t) * nways * ndim);
         candidates = alloc(sizeof(bool_t) * n_ports);
     }
+    if (routing == CAM_ROUTING && cam_ports == CAM_ADAPTIVE)
+        cam_cand = alloc(sizeof(port_type) * radix);
 }
 
 void request_ports_finish(void) {
@@ -64,6 +75,55 @@ void request_ports_finish(void) {
         free(mt);
         free(candidates);
     }
+    if (routing == CAM_ROUTING && cam_ports == CAM_ADAPTIVE)
+        free(cam_cand);
+}
+
+/**
+ * Keeps track of the highest VC used so far.
+ *
+ * Several workers may be requesting at the same time, so the maximum is read and updated atomically.
+ *
+ * @param nvc The VC that is going to be used.
+ */
+static void update_used_chan(long nvc) {
+#if (THREADS != 0)
+    long curr;
+
+    while (nvc > (curr = __atomic_load_n(&used_chan, __ATOMIC_RELAXED)) &&
+            !__sync_bool_compare_and_swap(&used_chan, curr, nvc))
+        ;
+#else
+    if (nvc > used_chan)
+        used_chan = nvc;
+#endif
+}
+
+/**
+ * Annotates the request of an input port for an output port.
+ *
+ * The table of requests is not cleared every cycle: the bitmap of requesting ports is cleared
+ * here when it belongs to an older generation, the first time the output port is requested.
+ * The value stored is the time of the request, as the FIFO arbitration needs it. A time 0
+ * means no request, so requests done at cycle 0 are ignored.
+ *
+ * @param i The node in which the request is performed.
+ * @param o_p The requested output port.
+ * @param s_p The input port which is requesting.
+ */
+static void add_request(long i, port_type o_p, port_type s_p) {
+    port *o = &network[i].p[o_p];
+    long k;
+
+    if (o->req_gen != network[i].req_gen) {
+        for (k = 0; k < REQ_WORDS; k++)
+            o->reqm[k] = 0;
+        o->req_gen = network[i].req_gen;
+    }
+    if (network[i].tor[s_p] == 0)
+        return;
+    o->reqm[s_p / WORD_BITS] |= 1UL << (s_p % WORD_BITS);
+    o->req[s_p] = network[i].tor[s_p];
 }
 
 /**
@@ -94,7 +154,7 @@ void request_port_double_oblivious(long i, port_type s_p) {
         d_c = port_coord_channel[s_p];
     else
         // This is a first attempt of injection. We need to choose a VC at random
-        d_c = (channel)(1.0*nchan*rand()/(RAND_MAX+1.0));
+        d_c = (channel)(1.0*nchan*sim_rand()/(RAND_MAX+1.0));
 
     j = d_c;
     for (ji = 0; ji < nchan; ji++) {
@@ -109,7 +169,7 @@ void request_port_double_oblivious(long i, port_type s_p) {
                     return;
                 }
                 else {
-                    network[i].p[d_p].req[s_p] = network[i].p[s_p].tor;
+                    add_request(i, d_p, s_p);
                     return;
                 }
             }
@@ -144,7 +204,7 @@ void request_port_double_adaptive (long i, port_type s_p) {
         d_c = port_coord_channel[s_p];
     else
         // This is a first attempt of injection. We need to choose a VC at random
-        d_c = (channel)(1.0*nchan*rand()/(RAND_MAX+1.0));
+        d_c = (channel)(1.0*nchan*sim_rand()/(RAND_MAX+1.0));
     bets = 1;
 
 another_attempt:
@@ -170,7 +230,7 @@ another_attempt:
                 }
                 else {
                     // Make reservation
-                    network[i].p[d_p].req[s_p] = network[i].p[s_p].tor;
+                    add_request(i, d_p, s_p);
                     return;
                 }
             }
@@ -212,7 +272,7 @@ void request_port_hexa_oblivious(long i, port_type s_p) {
     else{
         // This is a first attempt of injection. We need to choose a VC at random
         j = INJ;
-        d_c = (channel)(1.0*nchan*rand()/(RAND_MAX+1.0));
+        d_c = (channel)(1.0*nchan*sim_rand()/(RAND_MAX+1.0));
     }
 
     for (ji = 0; ji < ndim; ji++){
@@ -231,7 +291,7 @@ void request_port_hexa_oblivious(long i, port_type s_p) {
                     return;
                 }
                 else{
-                    network[i].p[d_p].req[s_p] = network[i].p[s_p].tor;
+                    add_request(i, d_p, s_p);
                     return;
                 }
             }
@@ -278,7 +338,7 @@ void request_port_hexa_adaptive(long i, port_type s_p) {
     if (j != INJ)
         d_c = l;
     else // This is a first attempt of injection. We need to choose a VC at random
-        d_c = (channel)(1.0*nchan*rand()/(RAND_MAX+1.0));
+        d_c = (channel)(1.0*nchan*sim_rand()/(RAND_MAX+1.0));
 
 
     for(bets=0; bets<nchan; bets++){
@@ -296,7 +356,7 @@ void request_port_hexa_adaptive(long i, port_type s_p) {
                     if (!check_restrictions(i, s_p, d_p, B_TRUE))
                         d_c = (d_c + 1) % nchan;
                     else{
-                        network[i].p[d_p].req[s_p] = network[i].p[s_p].tor;
+                        add_request(i, d_p, s_p);
                         return;
                     }
                 }
@@ -349,7 +409,7 @@ void request_port_bimodal_random (long i, port_type s_p){
                 extract_packet(i, s_p);
             return;
         }
-        network[i].p[d_p].req[s_p] = network[i].p[s_p].tor;
+        add_request(i, d_p, s_p);
     }
     else
         panic("Should not be here in request_port_bimodal_random");
@@ -387,7 +447,7 @@ void request_port_bubble_oblivious (long i, port_type s_p) {
         d_c = l;
     else
         // This is a first attempt of injection. We need to choose a VC at random
-        d_c = (channel)(1.0*nchan*rand()/(RAND_MAX+1.0));
+        d_c = (channel)(1.0*nchan*sim_rand()/(RAND_MAX+1.0));
 
     d_p = port_address(dir(d_d, d_w), d_c);
 
@@ -396,7 +456,7 @@ void request_port_bubble_oblivious (long i, port_type s_p) {
             extract_packet(i, s_p);
         return;
     }
-    network[i].p[d_p].req[s_p] = network[i].p[s_p].tor;
+    add_request(i, d_p, s_p);
 }
 
 /**
@@ -423,7 +483,7 @@ void request_port_bubble_adaptive_smart(long i, port_type s_p) {
     if (!preliminary_check(i, s_p, B_TRUE)) return;
 
     // Packet is in transit
-    bt = network[i].p[s_p].bet;
+    bt = network[i].bet[s_p];
     if (s_p < p_inj_first) {
         j = port_coord_dim[s_p];
         k = port_coord_way[s_p];
@@ -450,14 +510,14 @@ void request_port_bubble_adaptive_smart(long i, port_type s_p) {
         // destination dim d_d and way d_w already selected. Let us select channel
         if ((s_p >= p_inj_first) || (l == ESCAPE))
             // s_p is either a ESCAPE channel or the INJECTION port; select adaptive channel at random
-            d_c = 1 + (rand()%(nchan-1)); // Candidate destination adaptive channel selected
+            d_c = 1 + (sim_rand()%(nchan-1)); // Candidate destination adaptive channel selected
         else {
             // s_p is an ADAPTIVE channel
             if ((j == d_d) && (k == d_w))
                 // Continue in same adaptive channel
                 d_c = l;
             else
-                d_c = 1 + (rand()%(nchan-1));
+                d_c = 1 + (sim_rand()%(nchan-1));
         }
         d_p = port_address(dir(d_d, d_w), d_c);
 
@@ -472,11 +532,11 @@ void request_port_bubble_adaptive_smart(long i, port_type s_p) {
             continue;
         }
 
-        network[i].p[d_p].req[s_p] = network[i].p[s_p].tor;
+        add_request(i, d_p, s_p);
         if (bt < (ndim-1))
-            network[i].p[s_p].bet = bt+1;
+            network[i].bet[s_p] = bt+1;
         else
-            network[i].p[s_p].bet = B_ESCAPE;
+            network[i].bet[s_p] = B_ESCAPE;
         return;
     }
 
@@ -485,14 +545,14 @@ void request_port_bubble_adaptive_smart(long i, port_type s_p) {
     if (bt == B_ESCAPE) {
         check_rr(&pkt_space[ph->packet], &d_d, &d_w);
         d_p = port_address(dir(d_d, d_w), ESCAPE);
-        network[i].p[s_p].bet = B_TRIAL_0;
+        network[i].bet[s_p] = B_TRIAL_0;
         if (!check_restrictions(i, s_p, d_p, B_TRUE)) {
             // Cannot request ESCAPE -- even this is full!!
             if (extract && s_p >= p_inj_first)
                 extract_packet(i, s_p);
             return;
         }
-        network[i].p[d_p].req[s_p] = network[i].p[s_p].tor;
+        add_request(i, d_p, s_p);
         // If not successful, next time we will start the round again
         return;
     }
@@ -543,7 +603,7 @@ void request_port_bubble_adaptive_shortest (long i, port_type s_p) {
     }
     if (s_d_p != -1) {
         // Let us make the request
-        network[i].p[d_p].req[s_p] = network[i].p[s_p].tor;
+        add_request(i, d_p, s_p);
         return;
     }
 
@@ -556,7 +616,7 @@ void request_port_bubble_adaptive_shortest (long i, port_type s_p) {
             extract_packet(i, s_p);
         return;
     }
-    network[i].p[d_p].req[s_p] = network[i].p[s_p].tor;
+    add_request(i, d_p, s_p);
 }
 
 /**
@@ -606,16 +666,16 @@ void request_port_bubble_adaptive_random (long i, port_type s_p) {
                 extract_packet(i, s_p);
             return;
         }
-        network[i].p[d_p].req[s_p] = network[i].p[s_p].tor;
+        add_request(i, d_p, s_p);
         return;
     }
 
-    rp = (long)(1.0*ncand*rand()/(RAND_MAX+1.0));
+    rp = (long)(1.0*ncand*sim_rand()/(RAND_MAX+1.0));
     for (d_p=0; d_p<p_inj_first; d_p++) {
         if (!candidates[d_p])
             continue;
         if (rp == 0) {
-            network[i].p[d_p].req[s_p] = network[i].p[s_p].tor;
+            add_request(i, d_p, s_p);
             return;
         }
         else
@@ -668,7 +728,7 @@ void request_port_dally_trc(long i, port_type s_p) {
             extract_packet(i, s_p);
         return;
     }
-    network[i].p[d_p].req[s_p] = network[i].p[s_p].tor;
+    add_request(i, d_p, s_p);
 }
 
 /**
@@ -708,7 +768,7 @@ void request_port_dally_basic (long i, port_type s_p) {
             extract_packet(i, s_p);
         return;
     }
-    network[i].p[d_p].req[s_p] = network[i].p[s_p].tor;
+    add_request(i, d_p, s_p);
 }
 
 /**
@@ -737,7 +797,7 @@ void request_port_dally_improved(long i, port_type s_p) {
             (network[i].rcoord[d_d] + pkt_space[ph->packet].rr.rr[d_d] >= nodes_per_dim[d_d]))
         d_c = 0;
     else {
-        if (rand() >= (RAND_MAX/2))
+        if (sim_rand() >= (RAND_MAX/2))
             d_c = 1;
         else
             d_c = 0;
@@ -756,7 +816,7 @@ void request_port_dally_improved(long i, port_type s_p) {
             extract_packet(i, s_p);
         return;
     }
-    network[i].p[d_p].req[s_p] = network[i].p[s_p].tor;
+    add_request(i, d_p, s_p);
 }
 
 /**
@@ -806,12 +866,12 @@ void request_port_dally_adaptive (long i, port_type s_p) {
         return;
     }
 
-    rp = (long)(1.0*ncand*rand()/(RAND_MAX+1.0));
+    rp = (long)(1.0*ncand*sim_rand()/(RAND_MAX+1.0));
     for (d_p=0; d_p<p_inj_first; d_p++) {
         if (!candidates[d_p])
             continue;
         if (rp == 0) {
-            network[i].p[d_p].req[s_p] = network[i].p[s_p].tor;
+            add_request(i, d_p, s_p);
             return;
         }
         else
@@ -843,23 +903,23 @@ bool_t preliminary_check(long i, port_type s_p, bool_t fully_check) {
         return B_FALSE; // It is NOT a routing record
 
     // At this point, we have something to route
-    if ((d_p = network[i].p[s_p].aop) != P_NULL) {
-        if (network[i].p[d_p].sip != s_p)
+    if ((d_p = network[i].aop[s_p]) != P_NULL) {
+        if (network[i].sip[d_p] != s_p)
             panic("Output port should be reserved for me");
         return B_FALSE; // I've got the port already assigned
     }
 
-    if (network[i].p[s_p].tor == CLOCK_MAX)
-        network[i].p[s_p].tor = sim_clock; // Time of first reservation attempt
+    if (network[i].tor[s_p] == CLOCK_MAX)
+        network[i].tor[s_p] = sim_clock; // Time of first reservation attempt
 
     if (fully_check){
         if (check_rr_fully(&pkt_space[ph->packet])) {
-            network[i].p[p_con].req[s_p] = network[i].p[s_p].tor;
+            add_request(i, p_con, s_p);
             return B_FALSE;
         }
     } else
         if (check_rr(&pkt_space[ph->packet], &d_d, &d_w)) {
-            network[i].p[p_con].req[s_p] = network[i].p[s_p].tor;
+            add_request(i, p_con, s_p);
             return B_FALSE;
         }
     return B_TRUE;
@@ -875,14 +935,17 @@ bool_t preliminary_check(long i, port_type s_p, bool_t fully_check) {
  * @param injector The injection queue which extract from.
  */
 void extract_packet (long i, port_type injector) {
-    long pl;
     phit *p;
 
-    network[i].p[injector].tor = CLOCK_MAX; // A new packet will be waiting
+    network[i].tor[injector] = CLOCK_MAX; // A new packet will be waiting
     p=head_queue(&(network[i].p[injector].q));
+#if (THREADS != 0)
+    threads_free_pkt(p->packet);
+#else
     free_pkt(p->packet);
-    for (pl = 0; pl < pkt_len; pl++)
-        rem_head_queue(&(network[i].p[injector].q));
+#endif
+    rem_mult_queue(&(network[i].p[injector].q), pkt_len);
+    network[i].pcount -= pkt_len;
 }
 
 /**
@@ -1019,7 +1082,7 @@ bool_t check_restrictions (long i, port_type s_p, port_type d_p, bool_t chkbub)
     l = port_coord_channel[d_p];
     d_n = network[i].nbor[dir(j,k)];
 
-    if (queue_space(&(network[d_n].p[d_p].q)) < pkt_len || network[i].p[d_p].faulty)
+    if (queue_space(&(network[d_n].p[d_p].q)) < pkt_len || network[i].faulty[d_p])
         return B_FALSE; // No space at destination / broken link
 
     if (!chkbub)
@@ -1064,19 +1127,19 @@ bool_t preliminary_check_arbitrary(long i, port_type s_p) {
         return B_FALSE;	// It is NOT a routing record
 
     // At this point, we have something to route
-    if ((d_p = network[i].p[s_p].aop) != P_NULL) {
-        if (network[i].p[d_p].sip != s_p)
+    if ((d_p = network[i].aop[s_p]) != P_NULL) {
+        if (network[i].sip[d_p] != s_p)
             panic("Output port should be reserved for me");
         return B_FALSE; // I've got the port already assigned
     }
 
     id=i;	// The id of the local router/switch :: GLOBAL
-    if (network[i].p[s_p].tor == CLOCK_MAX)
-        network[i].p[s_p].tor = sim_clock; // Time of first reservation attempt
+    if (network[i].tor[s_p] == CLOCK_MAX)
+        network[i].tor[s_p] = sim_clock; // Time of first reservation attempt
 
     curr_p=s_p;	//source port :: GLOBAL
     if ( check_rr(&pkt_space[ph->packet], &d_d, &d_w) ){
-        network[i].p[p_con].req[s_p] = network[i].p[s_p].tor;
+        add_request(i, p_con, s_p);
         return B_FALSE;
     }
     return B_TRUE;
@@ -1092,11 +1155,9 @@ bool_t preliminary_check_arbitrary(long i, port_type s_p) {
  * @param injector The injection queue which extract from.
  */
 void extract_packet_arbitrary (long i, port_type injector) {
-    long pl;
-
-    network[i].p[injector].tor = CLOCK_MAX; // A new packet will be waiting
-    for (pl = 0; pl < pkt_len; pl++)
-        rem_head_queue(&(network[i].p[injector].q));
+    network[i].tor[injector] = CLOCK_MAX; // A new packet will be waiting
+    rem_mult_queue(&(network[i].p[injector].q), pkt_len);
+    network[i].pcount -= pkt_len;
 }
 
 /**
@@ -1164,7 +1225,7 @@ void request_port_arbitrary (long i, port_type s_p) {
             extract_packet_arbitrary(i, s_p);
         return;
     }
-    network[i].p[d_p].req[s_p] = network[i].p[s_p].tor;
+    add_request(i, d_p, s_p);
 }
 
 /**
@@ -1193,7 +1254,7 @@ port_type min_queue_occupation(port_type first, port_type last){
         if (ql==min)
             nbp[nm++]=p;
     }
-    return nbp[rand()%nm];
+    return nbp[sim_rand()%nm];
 }
 
 /**
@@ -1249,7 +1310,7 @@ bool_t check_rr_fattree_arithmetic(packet_t * pkt, dim *d, way *w) {
 
     // in a fattree: stDown == k == stUp;
     if (pkt->n_hops==0)	// NIC
-        *d=rand()%nchan;
+        *d=sim_rand()%nchan;
     else if (pkt->n_hops < pkt->rr.size /2) //going Up
         *d=((((pkt->from / (long)pow(stDown, network[id].rcoord[STAGE]))+(curr_p%nchan)) % stDown)*nchan) + (curr_p%nchan) ;
     else	// going down static.
@@ -1308,7 +1369,7 @@ bool_t check_rr_thintree_arithmetic(packet_t * pkt, dim *d, way *w) {
     *w=0;	// Way has no sense in multistage.
 
     if (pkt->n_hops==0) // NIC
-        *d=rand()%nchan;
+        *d=sim_rand()%nchan;
     else if (pkt->n_hops < pkt->rr.size /2) //going Up, (adaptive)
         *d=((((pkt->to/(long)pow(stDown, network[id].rcoord[STAGE]))+(curr_p%nchan))%stUp)*nchan) + (curr_p%nchan);
     else // going down static.
@@ -1405,11 +1466,9 @@ bool_t check_rr_slimtree_arithmetic(packet_t * pkt, dim *d, way *w) {
  * @param injector The injection queue which extract from.
  */
 void extract_packet_icube (long i, port_type injector) {
-    long pl;
-
-    network[i].p[injector].tor = CLOCK_MAX; // A new packet will be waiting
-    for (pl = 0; pl < pkt_len; pl++)
-        rem_head_queue(&(network[i].p[injector].q));
+    network[i].tor[injector] = CLOCK_MAX; // A new packet will be waiting
+    rem_mult_queue(&(network[i].p[injector].q), pkt_len);
+    network[i].pcount -= pkt_len;
 }
 
 /**
@@ -1430,20 +1489,20 @@ bool_t preliminary_check_icube(long i, port_type s_p) {
     if ((ph->pclass != RR) && (ph->pclass != RR_TAIL)) return B_FALSE;	// It is NOT a routing record
 
     // At this point, we have something to route
-    if ((d_p = network[i].p[s_p].aop) != P_NULL) {
-        if (network[i].p[d_p].sip != s_p)
+    if ((d_p = network[i].aop[s_p]) != P_NULL) {
+        if (network[i].sip[d_p] != s_p)
             panic("Output port should be reserved for me");
         return B_FALSE; // I've got the port already assigned
     }
 
-    if (network[i].p[s_p].tor == CLOCK_MAX)
-        network[i].p[s_p].tor = sim_clock; // Time of first reservation attempt
+    if (network[i].tor[s_p] == CLOCK_MAX)
+        network[i].tor[s_p] = sim_clock; // Time of first reservation attempt
 
     id=i; 		//id of the switch. GLOBAL
     curr_p=s_p;	//source port.     GLOBAL
 
     if (check_rr(&pkt_space[ph->packet], &d_d, &d_w)) {
-        network[i].p[p_con].req[s_p] = network[i].p[s_p].tor;
+        add_request(i, p_con, s_p);
         return B_FALSE;
     }
     return B_TRUE;
@@ -1534,7 +1593,7 @@ bool_t check_rr_icube_adaptive(packet_t * pkt, dim *d, way *w) {
         if (nm<1)
             *d = NULL_PORT;
         else
-            *d = nbp[rand()%nm];
+            *d = nbp[sim_rand()%nm];
         return B_FALSE;
     }
 
@@ -1553,7 +1612,7 @@ bool_t check_rr_icube_adaptive(packet_t * pkt, dim *d, way *w) {
         if (nm<1)
             *d = NULL_PORT;
         else
-            *d = nbp[rand()%nm];
+            *d = nbp[sim_rand()%nm];
         return B_FALSE;
     }
 
@@ -1595,7 +1654,7 @@ bool_t check_rr_icube_adaptive(packet_t * pkt, dim *d, way *w) {
         }
     }
     if(nm>0)
-        *d = nbp[rand()%nm];
+        *d = nbp[sim_rand()%nm];
     else
         *d = NULL_PORT;
     return B_FALSE;
@@ -1687,7 +1746,7 @@ void request_port_icube (long i, port_type s_p) {
         return;
     }
     else
-        network[i].p[d_p].req[s_p] = network[i].p[s_p].tor;
+        add_request(i, d_p, s_p);
 }
 
 /**
@@ -1710,20 +1769,20 @@ bool_t preliminary_check_icube_IB (long i, port_type s_p) {
         return B_FALSE;	// It is NOT a routing record
 
     // At this point, we have something to route
-    if ((d_p = network[i].p[s_p].aop) != P_NULL) {
-        if (network[i].p[d_p].sip != s_p)
+    if ((d_p = network[i].aop[s_p]) != P_NULL) {
+        if (network[i].sip[d_p] != s_p)
             panic("Output port should be reserved for me");
         return B_FALSE; // I've got the port already assigned
     }
 
-    if (network[i].p[s_p].tor == CLOCK_MAX)
-        network[i].p[s_p].tor = sim_clock; // Time of first reservation attempt
+    if (network[i].tor[s_p] == CLOCK_MAX)
+        network[i].tor[s_p] = sim_clock; // Time of first reservation attempt
 
     id=i; 		//id of the switch. GLOBAL
     curr_p=s_p;	//source port.     GLOBAL
 
     if (check_rr(&pkt_space[ph->packet], &d_d, &d_w)) {
-        network[i].p[p_con].req[s_p] = network[i].p[s_p].tor;
+        add_request(i, p_con, s_p);
         return B_FALSE;
     }
     return B_TRUE;
@@ -1840,7 +1899,7 @@ void request_port_icube_IB (long i, port_type s_p) {
         return;
     }
     else
-        network[i].p[d_p].req[s_p] = network[i].p[s_p].tor;
+        add_request(i, d_p, s_p);
 }
 
 long get_first_vc(long length){
@@ -1864,10 +1923,9 @@ long get_first_vc(long length){
         else
             nvc = diameter_r - (length - 2);
 
-        nvc = rand() % (nvc + 1);
+        nvc = sim_rand() % (nvc + 1);
     }
-    if(nvc > used_chan)
-        used_chan = nvc;
+    update_used_chan(nvc);
     if (nvc == nchan)
         panic("Number of virtual channels exceeded during deadlock avoidance!");
 
@@ -1914,8 +1972,7 @@ bool_t check_rr_arbitrary_node(packet_t * pkt, dim *d, way *w) {
         n_id = network[id].nbor[nd];
         if ((n_id < id) && (n_id != pkt->to)){
             nvc++;
-            if(nvc > used_chan)
-                used_chan = nvc;
+            update_used_chan(nvc);
             if (nvc == nchan)
                 panic("Number of virtual channels exceeded during deadlock avoidance!");
         }
@@ -1967,8 +2024,7 @@ bool_t check_rr_arbitrary_port(packet_t * pkt, dim *d, way *w) {
         n_id = network[id].nbor[nd];
         if ((nd <= fp) && (n_id != pkt->to)){// could check the node as well and save a few vc changes...
             nvc++;
-            if(nvc > used_chan)
-                used_chan = nvc;
+            update_used_chan(nvc);
             if (nvc == nchan)
                 panic("Number of virtual channels exceeded during deadlock avoidance!");
         }
@@ -2019,8 +2075,7 @@ bool_t check_rr_arbitrary_node_port(packet_t * pkt, dim *d, way *w) {
         n_id = network[id].nbor[nd];
         if ((((n_id < id) && (nd == fp)) || (nd < fp)) && (n_id != pkt->to)){// could check the node as well and save a few vc changes...
             nvc++;
-            if(nvc > used_chan)
-                used_chan = nvc;
+            update_used_chan(nvc);
             if (nvc == nchan)
                 panic("Number of virtual channels exceeded during deadlock avoidance!");
         }
@@ -2041,7 +2096,7 @@ bool_t check_rr_arbitrary_dummy(packet_t * pkt, dim *d, way *w) {
 
     if (curr_p>=p_inj_first)    // injection
     {
-        *d=(get_next_hop(pkt)*nchan) + rand()%nchan; // inject in  random VC
+        *d=(get_next_hop(pkt)*nchan) + sim_rand()%nchan; // inject in  random VC
     }
     else { // keep the VC number
         nd=get_next_hop(pkt);//next port to calculate next node
@@ -2071,8 +2126,7 @@ bool_t check_rr_arbitrary_inc_hop(packet_t * pkt, dim *d, way *w) {
         n_id = network[id].nbor[nd];
         if(n_id != pkt->to){
             nvc++;
-            if(nvc > used_chan)
-                used_chan = nvc;
+            update_used_chan(nvc);
             if (nvc == nchan)
                 panic("Number of virtual channels exceeded during deadlock avoidance!");
         }
@@ -2095,8 +2149,7 @@ bool_t check_rr_arbitrary_voq(packet_t * pkt, dim *d, way *w) {
     nd=get_next_hop(pkt);//next port to calculate next node
     nvc=get_next_router_hop(pkt);// current vc
 
-    if(nvc > used_chan)
-        used_chan = nvc;
+    update_used_chan(nvc);
     if (nvc>=nchan)
         panic("not enough virtual channels for VOQ!");
     *d=(nd*nchan)+nvc;//compute next port to be used
@@ -2114,7 +2167,7 @@ long get_next_router_hop_rr(packet_t*pkt) {
         return (pkt->rr.rr[(pkt->n_hops)+1]);
     }
     else
-        return rand()%nchan;
+        return sim_rand()%nchan;
 }
 
 long get_next_router_hop_cam(packet_t*pkt) {
@@ -2148,7 +2201,7 @@ long get_cam_port_rr(packet_t*pkt){
     src = ((pkt->from / stDown) + nprocs);
     dst = (pkt->to / stDown);
 
-    np = network[src].cam[dst].ports[pkt->path_id][pkt->n_hops];
+    np = cam_path(network[src].cam, dst, pkt->path_id)[pkt->n_hops - 1];
 
     return(np);
 }
@@ -2168,22 +2221,24 @@ long get_cam_port_rr(packet_t*pkt){
 long get_cam_port_adaptive_node(packet_t*pkt){
 
     long min, min_d;		                // Minimum value
-    long i, d, ql, dst, n_paths, nvc_aux, n_id;							// Queue length
-    long *nbp;
+    long i, d, lim, ql, dst, n_paths, nvc_aux, n_id;							// Queue length
+    cam_t *c = network[id].cam;
     port_type p, nm=0;	// Neighbor port
     min = tr_ql;
     min_d = nswitches;
     dst = (pkt->to / stDown);
-    n_paths = network[id].cam[dst].n_paths;
-    nbp = alloc(n_paths * sizeof(long));
+    n_paths = cam_entries(c, dst);
 
     if(pkt->n_hops != pkt->rr.size){
         pkt->rr.size = pkt->n_hops; // Ther packet has advanced
     }
+    lim = pkt->rr.rr[pkt->rr.size - 1]; // Only the ports that get closer are candidates
 
-    i = 0;
-    while(i < n_paths){
-        p = network[id].cam[dst].ports[0][i];
+    for(i = 0; i < n_paths; i++){
+        d = cam_dist(c, dst, i);
+        if(d >= lim)
+            continue;
+        p = cam_port(c, dst, i);
         nvc_aux = curr_p % nchan;
         n_id = network[id].nbor[p];
         if(pkt->n_hops != 1){
@@ -2191,22 +2246,19 @@ long get_cam_port_adaptive_node(packet_t*pkt){
                 nvc_aux++;
             }
         }
-        d = network[id].cam[dst].ports[1][i];
-        ql = queue_len(&network[n_id].p[(network[id].nborp[p] * nchan)+ nvc_aux].q);
+        ql = queue_len(&c->next[p][nvc_aux].q);
 
-        if ((d < pkt->rr.rr[pkt->rr.size - 1]) && (ql < min || ((ql == min) && d < min_d))){
+        if (ql < min || ((ql == min) && d < min_d)){
             min = ql;
             min_d = d;
             nm = 1;
-            nbp[0] = p;
+            cam_cand[0] = p;
         }
-        else if ((d < pkt->rr.rr[pkt->rr.size - 1]) && ql == min && d == min_d){
-            nbp[nm++]=p;
+        else if (ql == min && d == min_d){
+            cam_cand[nm++]=p;
         }
-        i++;
     }
-    p = nbp[rand() % nm];
-    free(nbp);
+    p = cam_cand[sim_rand() % nm];
 
     pkt->rr.rr[pkt->rr.size] = min_d;
 
@@ -2216,23 +2268,24 @@ long get_cam_port_adaptive_node(packet_t*pkt){
 long get_cam_port_adaptive_port(packet_t*pkt){
 
     long min, min_d;		                // Minimum value
-    long i, d, ql, dst, n_paths, nvc_aux, n_id, cp, fp;							// Queue length
-    long *nbp;
+    long i, d, lim, ql, dst, n_paths, nvc_aux, n_id, cp, fp;							// Queue length
+    cam_t *c = network[id].cam;
     port_type p, nm=0;	// Neighbor port
     min = tr_ql;
     min_d = nswitches;
     dst = (pkt->to / stDown);
-    n_paths = network[id].cam[dst].n_paths;
-    nbp = alloc(n_paths * sizeof(long));
+    n_paths = cam_entries(c, dst);
 
     if(pkt->n_hops != pkt->rr.size){
         pkt->rr.size = pkt->n_hops; // Ther packet has advanced
     }
+    lim = pkt->rr.rr[pkt->rr.size - 1]; // Only the ports that get closer are candidates
 
-    i = 0;
-    while(i < n_paths){
-        p = network[id].cam[dst].ports[0][i];
-
+    for(i = 0; i < n_paths; i++){
+        d = cam_dist(c, dst, i);
+        if(d >= lim)
+            continue;
+        p = cam_port(c, dst, i);
         cp = curr_p / nchan; // current port
         fp = network[id].nborp[cp]; // from port
 
@@ -2244,22 +2297,19 @@ long get_cam_port_adaptive_port(packet_t*pkt){
                 nvc_aux++;
             }
         }
-        d = network[id].cam[dst].ports[1][i];
-        ql = queue_len(&network[n_id].p[(network[id].nborp[p] * nchan)+ nvc_aux].q);
+        ql = queue_len(&c->next[p][nvc_aux].q);
 
-        if ((d < pkt->rr.rr[pkt->rr.size - 1]) && (ql < min || ((ql == min) && d < min_d))){
+        if (ql < min || ((ql == min) && d < min_d)){
             min = ql;
             min_d = d;
             nm = 1;
-            nbp[0] = p;
+            cam_cand[0] = p;
         }
-        else if ((d < pkt->rr.rr[pkt->rr.size - 1]) && ql == min && d == min_d){
-            nbp[nm++]=p;
+        else if (ql == min && d == min_d){
+            cam_cand[nm++]=p;
         }
-        i++;
     }
-    p = nbp[rand() % nm];
-    free(nbp);
+    p = cam_cand[sim_rand() % nm];
 
     pkt->rr.rr[pkt->rr.size] = min_d;
 
@@ -2269,22 +2319,24 @@ long get_cam_port_adaptive_port(packet_t*pkt){
 long get_cam_port_adaptive_node_port(packet_t*pkt){
 
     long min, min_d;		                // Minimum value
-    long i, d, ql, dst, n_paths, nvc_aux, n_id, cp, fp;							// Queue length
-    long *nbp;
+    long i, d, lim, ql, dst, n_paths, nvc_aux, n_id, cp, fp;							// Queue length
+    cam_t *c = network[id].cam;
     port_type p, nm=0;	// Neighbor port
     min = tr_ql;
     min_d = nswitches;
     dst = (pkt->to / stDown);
-    n_paths = network[id].cam[dst].n_paths;
-    nbp = alloc(n_paths * sizeof(long));
+    n_paths = cam_entries(c, dst);
 
     if(pkt->n_hops != pkt->rr.size){
         pkt->rr.size = pkt->n_hops; // Ther packet has advanced
     }
+    lim = pkt->rr.rr[pkt->rr.size - 1]; // Only the ports that get closer are candidates
 
-    i = 0;
-    while(i < n_paths){
-        p = network[id].cam[dst].ports[0][i];
+    for(i = 0; i < n_paths; i++){
+        d = cam_dist(c, dst, i);
+        if(d >= lim)
+            continue;
+        p = cam_port(c, dst, i);
         nvc_aux = curr_p % nchan;
         n_id = network[id].nbor[p];
         cp = curr_p / nchan; // current port
@@ -2295,22 +2347,19 @@ long get_cam_port_adaptive_node_port(packet_t*pkt){
                 nvc_aux++;
             }
         }
-        d = network[id].cam[dst].ports[1][i];
-        ql = queue_len(&network[n_id].p[(network[id].nborp[p] * nchan)+ nvc_aux].q);
+        ql = queue_len(&c->next[p][nvc_aux].q);
 
-        if ((d < pkt->rr.rr[pkt->rr.size - 1]) && (ql < min || ((ql == min) && d < min_d))){
+        if (ql < min || ((ql == min) && d < min_d)){
             min = ql;
             min_d = d;
             nm = 1;
-            nbp[0] = p;
+            cam_cand[0] = p;
         }
-        else if ((d < pkt->rr.rr[pkt->rr.size - 1]) && ql == min && d == min_d){
-            nbp[nm++]=p;
+        else if (ql == min && d == min_d){
+            cam_cand[nm++]=p;
         }
-        i++;
     }
-    p = nbp[rand() % nm];
-    free(nbp);
+    p = cam_cand[sim_rand() % nm];
 
     pkt->rr.rr[pkt->rr.size] = min_d;
 
@@ -2338,7 +2387,7 @@ bool_t check_rr_dragonfly_arithmetic(packet_t * pkt, dim *d, way *w) {
     *w=0;	// Way has no sense in multistage.
 
     if (pkt->n_hops==0)	// NIC, just choose a VC at random
-        *d=rand()%nchan;
+        *d=sim_rand()%nchan;
     else
         *d=(route_dragonfly(id,pkt->to,pkt->rr.size)*nchan) + (curr_p%nchan) ; // Remember rr.size stores the proxy group for simplicity
     return B_FALSE;
@@ -2377,8 +2426,7 @@ bool_t check_rr_dragonfly_dally(packet_t * pkt, dim *d, way *w) {
         nd = get_next_hop(pkt);
         if(nd >= param_p + intra_ports){
             nvc++;
-            if(nvc > used_chan)
-                used_chan = nvc;
+            update_used_chan(nvc);
             if (nvc == nchan)
                 panic("Number of virtual channels exceeded during deadlock avoidance!");
         }
@@ -18,6 +18,8 @@ along with this program; if not, write to the Free Software
 Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
+#include <string.h>
+
 #include "globals.h"
 #include "router.h"
 #include "misc.h"
@@ -48,7 +50,11 @@ void router_init(void) {
 		if (i<nprocs) { // Injection queues only in processors
 			network[i].qi = alloc(sizeof(inj_queue) * ninj);
 			for (j=0; j<ninj; j++)
-				network[i].qi[j].pos = alloc(sizeof(phit) * inj_ql);
+#if (PACKET_QUEUES != 0)
+				network[i].qi[j].pos = alloc(sizeof(pkt_desc) * inj_qd);
+#else
+				network[i].qi[j].pos = alloc(sizeof(phit) * inj_qd);
+#endif
 		}
 		else {
 			network[i].qi=NULL;
@@ -56,11 +62,22 @@ void router_init(void) {
 		}
 
 		network[i].p = alloc(sizeof(port) * (n_ports+1));
+		network[i].bet = alloc(sizeof(bet_type) * (n_ports+1));
+		network[i].aop = alloc(sizeof(port_type) * (n_ports+1));
+		network[i].tor = alloc(sizeof(CLOCK_TYPE) * (n_ports+1));
+		network[i].sip = alloc(sizeof(port_type) * (n_ports+1));
+		network[i].faulty = alloc(sizeof(bool_t) * (n_ports+1));
+		network[i].utilization = alloc(sizeof(CLOCK_TYPE) * (n_ports+1));
+		network[i].histo = alloc(sizeof(CLOCK_TYPE) * (buffer_cap + 1) * (n_ports+1));
+		// The tables of requests of all the ports in two slabs, freed through port 0.
+		network[i].p[0].req = alloc(sizeof(CLOCK_TYPE) * (n_ports+1) * (n_ports+1));
+		network[i].p[0].reqm = alloc(sizeof(unsigned long) * REQ_WORDS * (n_ports+1));
+		memset(network[i].p[0].reqm, 0, sizeof(unsigned long) * REQ_WORDS * (n_ports+1));
 		for(j = 0; j < n_ports+1; ++j) {
-			network[i].p[j].req = alloc(sizeof(CLOCK_TYPE) * n_ports+1);
-                        //printf("%ld %ld\n",buffer_cap, n_ports);
-			network[i].p[j].histo = alloc(sizeof(CLOCK_TYPE) * (buffer_cap + 1));
-			network[i].p[j].faulty = 0;
+			network[i].p[j].req = network[i].p[0].req + (j * (n_ports+1));
+			network[i].p[j].reqm = network[i].p[0].reqm + (j * REQ_WORDS);
+			network[i].p[j].req_gen = 0;
+			network[i].faulty[j] = 0;
 		}
         network[i].rcoord = calloc(ndim, sizeof(long));
 		network[i].op_i = alloc(sizeof(long) * radix);
@@ -82,9 +99,8 @@ void router_init(void) {
 
 		network[i].injecting_port = NULL_PORT;
 		network[i].next_port = 0;
-#if (PCOUNT!=0)
 		network[i].pcount = 0;
-#endif
+		network[i].req_gen = 0;
 		// Congestion with timeouts.
 		network[i].timeout_counter = (CLOCK_TYPE) 0L;
 		network[i].timeout_packet = NULL_PACKET;
@@ -92,19 +108,9 @@ void router_init(void) {
 
 		network[i].triggered=0;
 
-#if (TRACE_SUPPORT == 1)
-		if (i<nprocs){
-			init_event(&network[i].events);
-			init_occur(&network[i].occurs);
-		}
-		else
-			network[i].source=NO_SOURCE;
-#endif
-
-#if (TRACE_SUPPORT > 1)
+#if (TRACE_SUPPORT != 0)
 		if (i<nprocs){
 			init_event(&network[i].events);
-			network[i].occurs = alloc(sizeof(event_l) * nprocs);
 			init_occur(&network[i].occurs);
 		}
 		else
@@ -142,10 +148,22 @@ void router_init(void) {
 	    for (i=0; i<nprocs; i++)
 	        network[i].source=OTHER_SOURCE; // Bursty Source
 
-	/* Allocates space for transit queues */
-	for(i = 0; i < NUMNODES; ++i)
-		for(j = 0; j < n_ports+1; ++j)
-			network[i].p[j].q.pos = alloc(sizeof(phit) * tr_ql);
+	/* Allocates space for transit queues, a slab for all the ports of a router */
+	for(i = 0; i < NUMNODES; ++i) {
+#if (PACKET_QUEUES != 0)
+		network[i].q_space = alloc(sizeof(pkt_desc) * tr_qd * (n_ports+1));
+#else
+		network[i].q_space = alloc(sizeof(phit) * tr_qd * (n_ports+1));
+#endif
+		for(j = 0; j < n_ports+1; ++j) {
+#if (PACKET_QUEUES != 0)
+			network[i].p[j].q.pos = (pkt_desc *) network[i].q_space + (j * tr_qd);
+#else
+			network[i].p[j].q.pos = (phit *) network[i].q_space + (j * tr_qd);
+#endif
+			init_queue(&network[i].p[j].q);	// Consumption & dropping queues are never used, but stats() looks at them.
+		}
+	}
 }
 
 /**
@@ -162,20 +180,20 @@ void init_ports(long i){
 
 	for (e=0; e<p_con; e++) {
 		init_queue(&network[i].p[e].q);
-		network[i].p[e].utilization = (CLOCK_TYPE) 0L;
-		network[i].p[e].bet = B_TRIAL_0;
-		network[i].p[e].aop = P_NULL;
-		network[i].p[e].tor = CLOCK_MAX;
+		network[i].utilization[e] = (CLOCK_TYPE) 0L;
+		network[i].bet[e] = B_TRIAL_0;
+		network[i].aop[e] = P_NULL;
+		network[i].tor[e] = CLOCK_MAX;
 
-		network[i].p[e].sip = P_NULL;
+		network[i].sip[e] = P_NULL;
 		network[i].p[e].ri = P_NULL;
 
 		if(plevel & 8)
 			for (f=0; f<buffer_cap+1; f++)
-				network[i].p[e].histo[f] = (CLOCK_TYPE) 0L;
+				port_histo(i, e)[f] = (CLOCK_TYPE) 0L;
 	}
 	/* Init consumption port */
-	network[i].p[p_con].sip = P_NULL;
+	network[i].sip[p_con] = P_NULL;
 	network[i].p[p_con].ri = P_NULL;
 	/* Number of pending packets */
 	network[i].pending_packet = 0;
@@ -294,16 +312,71 @@ void init_network(void) {
 		do{
 			n=rand()%NUMNODES;
 			p=rand()%radix;
-		}while (network[n].p[p].faulty!=0);
+		}while (network[n].faulty[p]!=0);
 		nr=network[n].nbor[p];
 		if (p%2)
 			np=p-1;
 		else
 			np=p+1;
 		printf("breaking link %ld.%ld->%ld.%ld\n",n,p,nr,np);
-		network[n].p[p].faulty=1;
-		//network[nr].p[np].faulty=1; // Broken link means two direction malfunction.
+		network[n].faulty[p]=1;
+		//network[nr].faulty[np]=1; // Broken link means two direction malfunction.
+	}
+}
+
+/**
+* Writes the state of a router in a checkpoint, or reads it.
+*
+* Only the times of the requests in the bitmaps are written, as the rest are not valid.
+* The event queues are written with the trace.
+*
+* @param f The checkpoint.
+* @param i The router.
+* @param save TRUE to write the state, FALSE to read it.
+*
+* @see trace_checkpoint
+*/
+void router_checkpoint(FILE *f, long i, bool_t save) {
+	router *r = &network[i];
+	port_type e, s;
+	long j;
+
+	for (e = 0; e < n_ports+1; e++) {
+		queue_checkpoint(f, &r->p[e].q, save);
+		ckp_data(f, r->p[e].reqm, sizeof(unsigned long) * REQ_WORDS, save);
+		for (s = 0; s < n_ports+1; s++)
+			if ((r->p[e].reqm[s / WORD_BITS] >> (s % WORD_BITS)) & 1UL)
+				ckp_var(f, r->p[e].req[s], save);
+		ckp_var(f, r->p[e].req_gen, save);
+		ckp_var(f, r->p[e].ri, save);
 	}
+	ckp_data(f, r->bet, sizeof(bet_type) * (n_ports+1), save);
+	ckp_data(f, r->aop, sizeof(port_type) * (n_ports+1), save);
+	ckp_data(f, r->tor, sizeof(CLOCK_TYPE) * (n_ports+1), save);
+	ckp_data(f, r->sip, sizeof(port_type) * (n_ports+1), save);
+	ckp_data(f, r->faulty, sizeof(bool_t) * (n_ports+1), save);
+	ckp_data(f, r->utilization, sizeof(CLOCK_TYPE) * (n_ports+1), save);
+	ckp_data(f, r->histo, sizeof(CLOCK_TYPE) * (buffer_cap + 1) * (n_ports+1), save);
+	ckp_data(f, r->op_i, sizeof(long) * radix, save);
+	if (i >= nprocs && routing == CAM_ROUTING && cam_ports != CAM_ADAPTIVE)
+		ckp_data(f, r->cam->l_path, sizeof(uint32_t) * nswitches, save);
+	if (i < nprocs)
+		for (j = 0; j < ninj; j++)
+			inj_queue_checkpoint(f, &r->qi[j], save);
+	ckp_var(f, r->injecting_port, save);
+	ckp_var(f, r->next_port, save);
+	packet_checkpoint(f, &r->saved_packet, save);
+	ckp_var(f, r->pending_packet, save);
+	ckp_var(f, r->triggered, save);
+	ckp_var(f, r->pcount, save);
+	ckp_var(f, r->req_gen, save);
+	ckp_var(f, r->timeout_counter, save);
+	ckp_var(f, r->timeout_packet, save);
+	ckp_var(f, r->congested, save);
+	ckp_var(f, r->source, save);
+#if (TRACE_SUPPORT != 0)
+	ckp_var(f, r->appid, save);
+#endif
 }
 
 void router_finish(){
@@ -321,21 +394,26 @@ void router_finish(){
                         free(network[i].qi);
 		}
 
-		for(j = 0; j < n_ports+1; ++j) {
-                    free(network[i].p[j].req);
-                    free(network[i].p[j].histo);
-                    free(network[i].p[j].q.pos);
-		}
+                free(network[i].p[0].req);
+                free(network[i].p[0].reqm);
+                free(network[i].q_space);
                 free(network[i].p);
+                free(network[i].bet);
+                free(network[i].aop);
+                free(network[i].tor);
+                free(network[i].sip);
+                free(network[i].faulty);
+                free(network[i].utilization);
+                free(network[i].histo);
 
                 free(network[i].op_i);
                 free(network[i].nbor);
                 free(network[i].nborp);
 
 
-#if (TRACE_SUPPORT > 1)
+#if (TRACE_SUPPORT != 0)
 		if (i<nprocs){
-                        free(network[i].occurs);
+                        finish_occur(&network[i].occurs);
 		}
 #endif
 	}
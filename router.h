@@ -31,6 +31,7 @@
 
 #define ESCAPE 0	///< The Escape VC is always #0
 #define NULL_PORT -1	///< A way to denote "no port"
+#define REQ_WORDS ((n_ports + WORD_BITS) / WORD_BITS)	///< Words in the request bitmap of a port (n_ports+1 bits).
 #define NULL_PACKET 0xffffffff	///< A way to denote "no packet"
 
 /**
@@ -90,25 +91,30 @@ typedef long port_type;
 
 /**
 * Structure that defines a pair of input - output ports.
+*
+* The fields used every cycle by requesting & arbitration (aop, sip, bet, tor, faulty) are not here, but in
+* arrays of the router, indexed by port, so a pass over the ports of a router goes through contiguous memory.
+* The same for the statistics (utilization, histo), that are rarely used.
 */
 typedef struct port {
 	// Input section
 	queue q;		///< Associated queue -- useless for consumption
-	bet_type bet;	///< Which output port will I try to reserve?
-	port_type aop;	///< Assigned output port for this queue
-	CLOCK_TYPE tor;		///< Time of last request for output
 
 	// Output section
-	CLOCK_TYPE *req;		///< Table of requests
+	CLOCK_TYPE *req;		///< Table of requests (time of request of each input port). Only valid for the ports in #reqm
+	unsigned long *reqm;	///< Bitmap of the input ports requesting. Only valid when #req_gen is the one of the router
+	unsigned long req_gen;	///< Generation of the requests in #reqm
 	port_type ri;	///< Last request attended
-	port_type sip;	///< Input port using this output port
-
-	// Others
-	CLOCK_TYPE * histo;		///< size = MAX_QUEUE_LEN
-	CLOCK_TYPE utilization;	///< Utilization of this port
-	bool_t faulty;		///< Is there any problem with the link
 } port;
 
+/**
+* Queue occupation histogram of a port.
+*
+* @param i The node.
+* @param e The port.
+*/
+#define port_histo(i,e) (network[i].histo + ((e) * (buffer_cap + 1)))
+
 /**
 * Structure that defines a network router. Includes input buffer, transit queues
 * and many auxiliary data structures.
@@ -121,6 +127,18 @@ typedef struct router {
 
 	// Ports
 	port * p;		///< All the node's ports
+	void * q_space;	///< Storage of the transit queues of all the ports.
+
+	// Hot fields of the ports, one entry per port.
+	bet_type * bet;			///< Which output port will each input port try to reserve?
+	port_type * aop;		///< Assigned output port of each input port
+	CLOCK_TYPE * tor;		///< Time of last request for output of each input port
+	port_type * sip;		///< Input port using each output port
+	bool_t * faulty;		///< Is there any problem with the link of each port
+
+	// Statistics of the ports.
+	CLOCK_TYPE * utilization;	///< Utilization of each port
+	CLOCK_TYPE * histo;		///< Queue occupation histograms of all the ports, buffer_cap+1 entries each. See #port_histo
 	long * op_i;	///< Indices to assign output port
 
 	// Injection
@@ -131,13 +149,13 @@ typedef struct router {
 	long pending_packet;		///< Number of packets awaiting
 	long triggered;				///< Number of packets triggered by incoming packets - Reactive traffic.
 
-#if (PCOUNT!=0)
 	/**
 	* Total phits within the router.
 	* If this value is 0 the router ports wont be checked to for requesting, arbitrating or moving.
 	*/
 	long pcount;
-#endif
+
+	unsigned long req_gen;	///< Generation of the requests, increased every cycle the router is routed. Older requests are void.
 
 	// Congestion with timeouts.
 	CLOCK_TYPE timeout_counter;	///< This counts the number of cycles a packet is in the router or the number of cycles without a new packet arrival.
@@ -148,14 +166,9 @@ typedef struct router {
 	source_t source;           ///< The source type. May be independent, no source or other.
 
 	// Ports and injectors
-#if (TRACE_SUPPORT == 1)
-	event_q events;		///< A Queue with events to occur
-	event_l occurs;	///< Lists with occurred events (one for each messsage source)
-#endif /* TRACE */
-
-#if (TRACE_SUPPORT > 1)
+#if (TRACE_SUPPORT != 0)
 	event_q events;		///< A Queue with events to occur
-	event_l *occurs;	///< Lists with occurred events (one for each messsage source)
+	event_h occurs;		///< Table of occurred events
 	long appid;         ///< Id of app (only used with APPMIX tpattern)
 #endif /* TRACE */
 
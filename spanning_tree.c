@@ -45,7 +45,7 @@ routing_r spanning_tree_rr(long source, long destination){
     long length = NUMNODES - nprocs;
     routing_r res;
 
-    res.rr = alloc(length * sizeof(long));
+    res.rr = rr_alloc(length);
     start_switch = source / s_t_routing_table->n_servers;
     end_switch = destination / s_t_routing_table->n_servers;
 
@@ -80,7 +80,7 @@ routing_r spinnaker_rr (long source, long destination) {
     static long rx, ry, rz, dist;
     routing_r res;
 
-    res.rr=alloc(ndim*sizeof(long));
+    res.rr=rr_alloc(ndim);
 
     if (source == destination)
        panic("Self-sent packet");
@@ -43,7 +43,7 @@ void stats(long i) {
 		}
 		if (ql_m > buffer_cap + 1)
 			panic("Too many packets");
-		pt->histo[ql_m]++;
+		port_histo(i, e)[ql_m]++;
 	}
 }
 
@@ -86,12 +86,12 @@ void reset_stats(void) {
 
 		for (i=0; i<NUMNODES; i++){
 			for (e=0; e<p_inj_first; e++)
-				network[i].p[e].utilization = (CLOCK_TYPE) 0L;
+				network[i].utilization[e] = (CLOCK_TYPE) 0L;
 
 			if(plevel & 8)
 				for (e=0; e<n_ports; e++)
 					for (j=0; j<buffer_cap+1; j++)
-						network[i].p[e].histo[j] = (CLOCK_TYPE) 0L;
+						port_histo(i, e)[j] = (CLOCK_TYPE) 0L;
 		}
 #if (BIMODAL_SUPPORT != 0)
 		for (k=SHORT_MSG; k<=LONG_LAST_MSG; k++){
@@ -123,11 +123,11 @@ void reset_stats(void) {
 
 	for (i=0; i<NUMNODES; i++){
 		for (e=0; e<p_inj_first; e++)
-			network[i].p[e].utilization = (CLOCK_TYPE) 0L;
+			network[i].utilization[e] = (CLOCK_TYPE) 0L;
 		if(plevel & 8)
 			for (e=0; e<n_ports; e++)
 				for (j=0; j<buffer_cap+1; j++)
-					network[i].p[e].histo[j] = (CLOCK_TYPE) 0L;
+					port_histo(i, e)[j] = (CLOCK_TYPE) 0L;
 	}
 #endif
 	reseted++;
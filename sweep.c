@@ -0,0 +1,255 @@
+/**
+* @file
+* @brief	Parallel sweeps: many simulations of the same network, one for each value of a parameter.
+*
+* The network, with its routing tables, is built once and then a process is forked for each
+* point of the sweep, so all of them share its memory (copy on write) instead of building
+* it again. Optionally, the warm-up is also done once, before forking.
+*
+* Each point writes the usual report in its own file, and sends the averages of its batches
+* to the parent, which prints them all together.
+
+FSIN Functional Simulator of Interconnection Networks
+Copyright (2003-2011) J. Miguel-Alonso, A. Gonzalez, J. Navaridas
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "globals.h"
+
+/**
+* What a point of the sweep has done, as sent to the parent.
+*/
+typedef enum sweep_status_t {
+	SWEEP_FAILED=0, SWEEP_COMPLETED=1, SWEEP_INTERRUPTED=2, SWEEP_ABORTED=3
+} sweep_status_t;
+
+/**
+* The results of a point of the sweep: the averages of its batches.
+*/
+typedef struct sweep_res_t {
+	sweep_status_t status;	///< How the simulation of the point finished.
+	CLOCK_TYPE clock;		///< Simulation clock at the end.
+	long samples;			///< Number of batches (or shots).
+	double inj_load;		///< Averaged injected load.
+	double acc_load;		///< Averaged accepted load.
+	double avg_delay;		///< Averaged delay.
+	double stDev_delay;		///< Averaged standard deviation of delay.
+	double max_delay;		///< Averaged maximum delay.
+	double avg_inj_delay;	///< Averaged injection delay.
+} sweep_res_t;
+
+/**
+* A point of the sweep.
+*/
+typedef struct sweep_point_t {
+	char *value;		///< The value of #sweep_param.
+	pid_t pid;			///< The process simulating it, 0 if not started.
+	int fd;				///< The pipe to receive its results.
+	sweep_res_t res;	///< Its results.
+} sweep_point_t;
+
+static int res_fd = -1;	///< In the process of a point, the pipe to send the results.
+
+/**
+* Starts the process of a point of the sweep.
+*
+* The child sets the value of the point & its own output files, and returns to simulate it.
+*
+* @param k The number of the point.
+* @param pt The point.
+* @return TRUE in the child, FALSE in the parent.
+*/
+static bool_t start_point(long k, sweep_point_t *pt) {
+	char pt_file[sizeof(file)], name[FILENAME_MAX];
+	int fds[2];
+
+	// Checked before forking: a truncated name could overwrite the files of another point.
+	if (snprintf(pt_file, sizeof(pt_file), "%s.%ld", file, k) >= (int)sizeof(pt_file))
+		panic("Output file name too long for the points of the sweep");
+	if (pipe(fds) != 0)
+		panic("Cannot create a pipe for a point of the sweep");
+	fflush(NULL);	// Or the output buffered until now would be written by both processes.
+	if ((pt->pid = fork()) < 0)
+		panic("Cannot fork the process of a point of the sweep");
+	if (pt->pid > 0) {
+		close(fds[1]);
+		pt->fd = fds[0];
+		return B_FALSE;
+	}
+
+	close(fds[0]);
+	res_fd = fds[1];
+	strcpy(file, pt_file);
+	snprintf(name, FILENAME_MAX, "%s.out", file);
+	if (freopen(name, "w", stdout) == NULL)
+		panic("Cannot create the output file of a point of the sweep");
+	if ((pheaders & 1024) && monitored >= 0) {
+		snprintf(name, FILENAME_MAX, "%s.mon", file);
+		if ((fp = freopen(name, "w", fp)) == NULL)
+			panic("Can not create monitorized output file");
+	}
+
+	set_sweep_point(pt->value);
+	if (sweep_param == SWEEP_PATTERN) {
+		injection_finish();
+		init_injection();
+	}
+	return B_TRUE;
+}
+
+/**
+* Waits for the process of any point of the sweep, and gets its results.
+*
+* @param points All the points.
+* @param n The number of points.
+*/
+static void wait_point(sweep_point_t *points, long n) {
+	pid_t pid;
+	long k;
+
+	while ((pid = wait(NULL)) < 0)
+		if (errno != EINTR)
+			panic("Lost the processes of the sweep");
+	for (k = 0; k < n && points[k].pid != pid; k++);
+	if (k == n)
+		return;
+	// A point that panics exits without sending anything: it stays as failed.
+	if (read(points[k].fd, &points[k].res, sizeof(sweep_res_t)) != sizeof(sweep_res_t))
+		points[k].res.status = SWEEP_FAILED;
+	close(points[k].fd);
+}
+
+/**
+* Prints the results of all the points of the sweep.
+*
+* @param points All the points.
+* @param n The number of points.
+*/
+static void print_sweep(sweep_point_t *points, long n) {
+	char *name;
+	static char *status_s[] = {"failed", "completed", "interrupted", "aborted"};
+	long k;
+
+	literal_name(sweep_param_l, &name, sweep_param);
+	printf("\n===============================================================================================================================================================\n\n");
+	printf("Sweep of %s: %ld points. Reports in %s.<point>.out\n\n", name, n, file);
+	printf("  point, %10s,      clock,    samples,    InjLoad,    AccLoad,   AvgDelay, StDevDelay,   MaxDelay,  InjAvgDel,     status\n", name);
+	for (k = 0; k < n; k++) {
+		printf("%7ld, %10s", k, points[k].value);
+		if (points[k].res.status == SWEEP_FAILED || points[k].res.samples == 0)
+			printf(", %10s, %10s, %10s, %10s, %10s, %10s, %10s, %10s", "-", "-", "-", "-", "-", "-", "-", "-");
+		else
+			printf(", %10"PRINT_CLOCK", %10ld, %10.5f, %10.5f, %10.2f, %10.2f, %10.2f, %10.2f", points[k].res.clock,
+					points[k].res.samples, points[k].res.inj_load, points[k].res.acc_load, points[k].res.avg_delay,
+					points[k].res.stDev_delay, points[k].res.max_delay, points[k].res.avg_inj_delay);
+		printf(", %10s\n", status_s[points[k].res.status]);
+	}
+	if (interrupted)
+		printf("** Sweep interrupted **\n");
+}
+
+/**
+* Runs a sweep: simulates a point for each value in #sweep_values.
+*
+* The network has to be built, but not simulated. Up to #sweep_jobs points are simulated
+* at a time, each one in a forked process. With #sweep_warmup, the warm-up is done before
+* forking, with the load & pattern of the configuration.
+*
+* @return TRUE in the process of a point, that has to simulate it & call sweep_done().
+* FALSE in the parent, when all the points have finished & their results have been printed.
+*/
+bool_t run_sweep(void) {
+	sweep_point_t *points;
+	char *value;
+	long n, k, jobs, running;
+
+	points = alloc(sizeof(sweep_point_t) * (strlen(sweep_values) / 2 + 1));
+	n = 0;
+	for (value = strtok(sweep_values, ","); value; value = strtok(NULL, ",")) {
+		points[n].value = value;
+		points[n].pid = 0;
+		points[n].res.status = SWEEP_FAILED;
+		points[n].res.samples = 0;
+		n++;
+	}
+	jobs = (sweep_jobs > 0) ? sweep_jobs : sysconf(_SC_NPROCESSORS_ONLN);
+	if (jobs < 1)
+		jobs = 1;
+
+	if (sweep_warmup) {
+		if (pheaders > 0)
+			print_headers();
+		warm_up();
+	}
+
+	running = 0;
+	for (k = 0; k < n && !interrupted && !aborted; k++) {
+		if (running == jobs) {
+			wait_point(points, n);
+			running--;
+		}
+		if (start_point(k, &points[k]))
+			return B_TRUE;	// The child; its points are not needed.
+		running++;
+	}
+	for (; running > 0; running--)
+		wait_point(points, n);
+
+	print_sweep(points, n);
+	free(points);
+	return B_FALSE;
+}
+
+/**
+* Sends the results of a point of the sweep to the parent.
+*
+* Does nothing if this is not the process of a point.
+*/
+void sweep_done(void) {
+	sweep_res_t res;
+	long i;
+
+	if (res_fd < 0)
+		return;
+	memset(&res, 0, sizeof(res));
+	res.status = interrupted ? SWEEP_INTERRUPTED : (aborted ? SWEEP_ABORTED : SWEEP_COMPLETED);
+	res.clock = sim_clock;
+	res.samples = reseted;
+	for (i = 0; i < reseted; i++) {
+		res.inj_load += batch[i].inj_load;
+		res.acc_load += batch[i].acc_load;
+		res.avg_delay += batch[i].avg_delay;
+		res.stDev_delay += batch[i].stDev_delay;
+		res.max_delay += batch[i].max_delay;
+		res.avg_inj_delay += batch[i].avg_inj_delay;
+	}
+	if (reseted > 0) {
+		res.inj_load /= reseted;
+		res.acc_load /= reseted;
+		res.avg_delay /= reseted;
+		res.stDev_delay /= reseted;
+		res.max_delay /= reseted;
+		res.avg_inj_delay /= reseted;
+	}
+	if (write(res_fd, &res, sizeof(res)) != sizeof(res))
+		fprintf(stderr, "WARNING: Cannot send the results of the point of the sweep\n");
+	close(res_fd);
+	res_fd = -1;
+}
@@ -0,0 +1,368 @@
+/**
+* @file
+* @brief	Multi-threaded cycle engine.
+*
+* Each cycle is split in three steps:
+* - Generation & injection of packets. Performed by the main thread, as it
+*   uses the packet pool, the global random generator and the statistics.
+* - Requests & arbitration. Only touches the router it is performed in, so the
+*   routers are split in contiguous ranges and each range is assigned to a worker
+*   thread pinned to a CPU.
+* - Consumption & advance. Phits move between routers, so it is serial.
+*
+* The random numbers used in the parallel step come from a private stream of each
+* router, so the results are the same whatever the number of threads.
+
+FSIN Functional Simulator of Interconnection Networks
+Copyright (2003-2011) J. Miguel-Alonso, A. Gonzalez, J. Navaridas
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "globals.h"
+
+#if (THREADS != 0)
+
+/**
+* A worker of the multi-threaded engine.
+*/
+typedef struct worker_t {
+	pthread_t th;		///< The thread of this worker. Worker 0 is the main thread.
+	long id;			///< Id of the worker.
+	long first;			///< First router assigned to this worker.
+	long last;			///< Next router after the last assigned to this worker.
+	long * freed;		///< Packets extracted during the parallel step, returned to the pool afterwards.
+	long nfreed;		///< Number of packets in #freed.
+} worker_t;
+
+static worker_t * workers;		///< All the workers.
+static THREAD_LOCAL worker_t * self = NULL;	///< The worker of this thread, only while in the parallel step.
+
+static pthread_barrier_t start_b;	///< Waits for the serial step before routing.
+static pthread_barrier_t end_b;		///< Waits for all the routers to be routed.
+static bool_t quit = B_FALSE;		///< Tells the workers to finish.
+
+static void (*route)(long i);		///< Requests & arbitration of a router.
+static void (*move)(void);			///< Consumption & advance of all the routers.
+
+static unsigned long long * rng;	///< The random stream of each router.
+static THREAD_LOCAL unsigned long long * curr_rng = NULL;	///< The stream in use, NULL for the global rand().
+
+/**
+* Gets a random number in [ 0, RAND_MAX ].
+*
+* Outside the parallel step it is rand(). Inside it, the number comes from the stream
+* of the router being routed (xorshift64*).
+*
+* @return A random number.
+*/
+long sim_rand(void) {
+	unsigned long long x;
+
+	if (curr_rng == NULL)
+		return rand();
+	x = *curr_rng;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*curr_rng = x;
+	return (long)(((x * 2685821657736338717ULL) >> 33) % ((unsigned long long)RAND_MAX + 1));
+}
+
+/**
+* Takes the random numbers of sim_rand() from the stream of a router, or from rand().
+*
+* The serial engines route each router with its stream, as the workers do, so the results
+* are the same with any number of threads, 0 included.
+*
+* @param i The router, or -1 for rand().
+*/
+void sim_rand_router(long i) {
+	curr_rng = (i < 0) ? NULL : &rng[i];
+}
+
+/**
+* Seeds a random stream (splitmix64), so that close seeds give unrelated streams.
+*
+* @param z The seed.
+* @return The initial state of the stream, never 0.
+*/
+static unsigned long long seed_rng(unsigned long long z) {
+	z += 0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	z ^= z >> 31;
+	return z ? z : 1;
+}
+
+/**
+* An estimation of the work needed to route a router: the number of ports requesting.
+*
+* @param i The router.
+* @return The cost of the router.
+*/
+static long router_cost(long i) {
+	if (topo<DIRECT)
+		return p_con;
+	if (i < nprocs)
+		return (nchan * nnics) + (p_con - p_inj_first);
+	return p_inj_last + 1;
+}
+
+/**
+* Pins the calling thread to a CPU. Failures are ignored, pinning is just an optimization.
+*
+* @param id The worker id.
+*/
+static void pin_worker(long id) {
+	cpu_set_t cpus;
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (ncpus < 1)
+		return;
+	CPU_ZERO(&cpus);
+	CPU_SET(id % ncpus, &cpus);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus);
+}
+
+/**
+* Requests & arbitration of all the routers of a worker.
+*
+* @param w The worker.
+*/
+static void route_range(worker_t * w) {
+	long i;
+
+	self = w;
+	if (worklist)
+		for (i = next_active_router(w->first); i < w->last; i = next_active_router(i + 1)) {
+			curr_rng = &rng[i];
+			route(i);
+		}
+	else
+		for (i = w->first; i < w->last; i++) {
+			curr_rng = &rng[i];
+			route(i);
+		}
+	curr_rng = NULL;
+	self = NULL;
+}
+
+/**
+* Main loop of the workers, but the main thread.
+*
+* @param arg The worker.
+* @return Nothing.
+*/
+static void * run_worker(void * arg) {
+	worker_t * w = arg;
+
+	pin_worker(w->id);
+	request_ports_init();
+	while (B_TRUE) {
+		pthread_barrier_wait(&start_b);
+		if (quit)
+			break;
+		route_range(w);
+		pthread_barrier_wait(&end_b);
+	}
+	request_ports_finish();
+	return NULL;
+}
+
+/**
+* Returns a packet to the pool.
+*
+* In the parallel step the packet is kept by the worker, and it is returned after the
+* step, in router order, so the packet pool is the same whatever the number of threads.
+*
+* @param n The id of the packet to free.
+*/
+void threads_free_pkt(unsigned long n) {
+	if (self == NULL)
+		free_pkt(n);
+	else
+		self->freed[self->nfreed++] = n;
+}
+
+/**
+* Performs the movement of the data using several threads.
+*
+* @param inject If TRUE new data generation is performed.
+*
+* @see threads_init
+* @see data_movement
+*/
+void data_movement_threads(bool_t inject) {
+	long i, t;
+
+	if (worklist) {	// Only the nodes of the injection pending set & the active routers.
+		if (plevel & 8) {
+			prof_phase(PROF_STATS);
+			for (i=0; i<NUMNODES; i++)
+				stats(i);
+		}
+		if (inject) {
+			prof_phase(PROF_GENERATION);
+			generate_pending_sources();
+		}
+		prof_phase(PROF_INJECTION);
+		for (i=next_active_router(0); i<nprocs; i=next_active_router(i+1))
+			data_injection(i);
+	}
+	else
+		for (i=0; i<NUMNODES; i++) {
+			if (plevel & 8) {
+				prof_phase(PROF_STATS);
+				stats(i);
+			}
+			if (i<nprocs){
+				if (inject) {
+					prof_phase(PROF_GENERATION);
+					data_generation(i);
+				}
+				prof_phase(PROF_INJECTION);
+				data_injection(i);
+			}
+		}
+
+	// The parallel step is accounted as a whole, up to the end of the slowest worker.
+	prof_phase(PROF_REQUEST);
+#if (PROFILE != 0)
+	prof_on = B_FALSE;
+#endif
+	pthread_barrier_wait(&start_b);
+	route_range(&workers[0]);
+	pthread_barrier_wait(&end_b);
+#if (PROFILE != 0)
+	prof_on = profile;
+#endif
+	prof_phase(PROF_MOVE);
+
+	for (t=0; t<threads; t++) {
+		for (i=0; i<workers[t].nfreed; i++)
+			free_pkt(workers[t].freed[i]);
+		workers[t].nfreed = 0;
+	}
+	if (worklist)
+		move_active_routers();
+	else
+		move();
+	prof_phase(PROF_LOOP);
+	prof_count(prof_cycles);
+}
+
+/**
+* Seeds the random streams of the routers.
+*
+* The serial engines use them too, so this is done before simulating anything, even with
+* threads=0 and before the warm-up of a sweep.
+*/
+void rng_streams_init(void) {
+	long i;
+
+	rng = alloc(sizeof(unsigned long long) * NUMNODES);
+	for (i=0; i<NUMNODES; i++)
+		rng[i] = seed_rng(((unsigned long long)r_seed << 32) ^ (unsigned long long)i);
+}
+
+/**
+* Starts the workers and replaces the data movement function.
+*
+* Must be called once the network and the virtual functions are ready.
+*/
+void threads_init(void) {
+	long i, t, cost, acum, total;
+
+	if (threads == 0)
+		return;
+	if (threads > NUMNODES)
+		threads = NUMNODES;
+
+	if (topo<DIRECT) {
+		route = route_router_direct;
+		move = move_phits_direct;
+	}
+	else {
+		route = route_router_indirect;
+		move = move_phits_indirect;
+	}
+	data_movement = data_movement_threads;
+
+	// Contiguous ranges of routers with about the same cost.
+	total = 0;
+	for (i=0; i<NUMNODES; i++)
+		total += router_cost(i);
+	workers = alloc(sizeof(worker_t) * threads);
+	acum = 0;
+	i = 0;
+	for (t=0; t<threads; t++) {
+		workers[t].id = t;
+		workers[t].first = i;
+		cost = 0;
+		while (i < NUMNODES - (threads - t - 1) && (t == threads - 1 || acum + cost < (total * (t + 1)) / threads))
+			cost += router_cost(i++);
+		acum += cost;
+		workers[t].last = i;
+		workers[t].freed = alloc(sizeof(long) * ((workers[t].last - workers[t].first) * n_ports + 1));
+		workers[t].nfreed = 0;
+	}
+
+	if (pthread_barrier_init(&start_b, NULL, threads) || pthread_barrier_init(&end_b, NULL, threads))
+		panic("threads_init: Cannot create barriers");
+	pin_worker(0);
+	for (t=1; t<threads; t++)
+		if (pthread_create(&workers[t].th, NULL, run_worker, &workers[t]))
+			panic("threads_init: Cannot create worker thread");
+}
+
+/**
+* Writes the random streams of the routers in a checkpoint, or reads them.
+*
+* The streams do not depend on the number of threads, so it may change when resuming.
+*
+* @param f The checkpoint.
+* @param save TRUE to write the streams, FALSE to read them.
+*/
+void threads_checkpoint(FILE *f, bool_t save) {
+	ckp_data(f, rng, sizeof(unsigned long long) * NUMNODES, save);
+}
+
+/**
+* Stops the workers and frees their structures.
+*/
+void threads_finish(void) {
+	long t;
+
+	if (threads == 0) {
+		free(rng);
+		return;
+	}
+	quit = B_TRUE;
+	pthread_barrier_wait(&start_b);
+	for (t=1; t<threads; t++)
+		pthread_join(workers[t].th, NULL);
+	pthread_barrier_destroy(&start_b);
+	pthread_barrier_destroy(&end_b);
+	for (t=0; t<threads; t++)
+		free(workers[t].freed);
+	free(workers);
+	free(rng);
+}
+
+#endif /* THREADS */
@@ -0,0 +1,189 @@
+/**
+* @file
+* @brief	Microbenchmark of the FSIN queues.
+*
+* Compares the queues of the simulator (queue.c, as configured by PACKET_QUEUES) with the
+* former implementation: a ring of phits indexed with a modulo of the queue length.
+* The work mimics a transit port: every cycle the length, space and head are looked at,
+* a phit leaves and, if there is room for it, a new packet enters phit by phit.
+*
+* Build & run from this directory:
+*	gcc -O2 -fno-inline -I../.. queue_bench.c -o queue_bench && ./queue_bench [pkt_len] [buffer_cap] [cycles]
+* -fno-inline keeps the calls, as in the simulator, where the queues are in their own translation unit.
+* Add -DPACKET_QUEUES=0 to measure the ring of phits instead of the packet descriptors.
+
+FSIN Functional Simulator of Interconnection Networks
+Copyright (2003-2011) J. Miguel-Alonso, A. Gonzalez, J. Navaridas
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <time.h>
+
+#include "../../queue.c"
+
+long pkt_len, buffer_cap, tr_ql, tr_qd;
+packet_t * pkt_space;
+
+void panic(char *mes) {
+	fprintf(stderr, "PANIC: %s\n", mes);
+	exit(-1);
+}
+
+void ckp_data(FILE *f, void *data, size_t size, bool_t save) {
+	panic("The bench does not take checkpoints");	// Only for queue_checkpoint().
+}
+
+/**
+* The former transit queue: a ring of phits, the head points to the item just before it.
+*/
+typedef struct mod_queue {
+	long head;
+	long tail;
+	phit * pos;
+} mod_queue;
+
+static long mod_queue_len (mod_queue *q) {
+	long aux;
+
+	aux = q->tail - q->head;
+	if (aux < 0)
+		aux += tr_ql;
+	return aux;
+}
+
+static long mod_queue_space (mod_queue *q) {
+	return (tr_ql-1) - mod_queue_len(q);
+}
+
+static phit * mod_head_queue (mod_queue *q) {
+	if (mod_queue_len(q) == 0)
+		panic("Asking for the head of an empty queue");
+	return &((q->pos)[(q->head + 1)%tr_ql]);
+}
+
+static void mod_ins_queue (mod_queue *q, phit *i) {
+	if (mod_queue_len(q) == (tr_ql-1))
+		panic("Inserting a phit in a full queue");
+	q->tail = (q->tail + 1)%tr_ql;
+	(q->pos)[q->tail] = *i;
+}
+
+static void mod_rem_queue (mod_queue *q, phit *i) {
+	if (mod_queue_len(q) == 0)
+		panic("Removing the head of an empty queue");
+	q->head = (q->head + 1)%tr_ql;
+	*i = (q->pos)[q->head];
+}
+
+/**
+* Gets the phit of a packet in a position.
+*/
+static phit packet_phit(unsigned long packet, long k) {
+	phit p;
+
+	p.packet = packet;
+	if (pkt_len == 1)
+		p.pclass = RR_TAIL;
+	else if (k == 0)
+		p.pclass = RR;
+	else if (k == pkt_len-1)
+		p.pclass = TAIL;
+	else
+		p.pclass = INFO;
+	return p;
+}
+
+static double now(void) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+	long cycles = 50000000, c, k = 0, npkt = 64;
+	unsigned long packet = 0, check = 0;
+	double t, t_mod, t_new;
+	mod_queue mq;
+	queue nq;
+	phit ph, *h;
+
+	pkt_len = (argc > 1) ? atol(argv[1]) : 16;
+	buffer_cap = (argc > 2) ? atol(argv[2]) : 4;
+	if (argc > 3)
+		cycles = atol(argv[3]);
+	tr_ql = buffer_cap * pkt_len + 1;
+#if (PACKET_QUEUES != 0)
+	for (tr_qd = 1; tr_qd < buffer_cap + 1; tr_qd <<= 1);
+	nq.pos = malloc(sizeof(pkt_desc) * tr_qd);
+#else
+	for (tr_qd = 1; tr_qd < tr_ql - 1; tr_qd <<= 1);
+	nq.pos = malloc(sizeof(phit) * tr_qd);
+#endif
+	mq.pos = malloc(sizeof(phit) * tr_ql);
+	pkt_space = malloc(sizeof(packet_t) * npkt);
+	for (c = 0; c < npkt; c++)
+		pkt_space[c].size = pkt_len;
+
+	mq.head = mq.tail = 0;
+	t = now();
+	for (c = 0; c < cycles; c++) {
+		if (mod_queue_len(&mq)) {
+			h = mod_head_queue(&mq);
+			check += h->pclass;
+			mod_rem_queue(&mq, &ph);
+		}
+		if (k > 0 || mod_queue_space(&mq) >= pkt_len) {
+			ph = packet_phit(packet, k);
+			mod_ins_queue(&mq, &ph);
+			if (++k == pkt_len) {
+				k = 0;
+				packet = (packet + 1) % npkt;
+			}
+		}
+	}
+	t_mod = now() - t;
+
+	init_queue(&nq);
+	k = 0;
+	packet = 0;
+	t = now();
+	for (c = 0; c < cycles; c++) {
+		if (queue_len(&nq)) {
+			h = head_queue(&nq);
+			check -= h->pclass;
+			rem_queue(&nq, &ph);
+		}
+		if (k > 0 || queue_space(&nq) >= pkt_len) {
+			ph = packet_phit(packet, k);
+			ins_queue(&nq, &ph);
+			if (++k == pkt_len) {
+				k = 0;
+				packet = (packet + 1) % npkt;
+			}
+		}
+	}
+	t_new = now() - t;
+
+	if (check != 0)
+		panic("The queues do not give the same phits");
+	printf("pkt_len %ld, buffer_cap %ld, %ld cycles\n", pkt_len, buffer_cap, cycles);
+	printf("modulo ring:   %8.3f ns/cycle\n", 1e9 * t_mod / cycles);
+	printf("%s %8.3f ns/cycle (x%.2f)\n", PACKET_QUEUES ? "packet queue: " : "masked ring:  ",
+			1e9 * t_new / cycles, t_mod / t_new);
+	free(mq.pos);
+	free(nq.pos);
+	free(pkt_space);
+	return 0;
+}
@@ -0,0 +1,359 @@
+/**
+* @file
+* @brief	Throughput benchmark of the trace replay.
+*
+* Runs the simulator on every case of a suite, with profile=1, and records for each one the
+* cycles simulated, the time spent reading the trace, the time spent simulating, the trace events
+* and phits done per second and the peak resident memory of the run. The results are written
+* as a table of tab separated values which, when saved, serves as the baseline of later runs:
+* a run fails when any case fails or is worse than its baseline by more than a threshold.
+*
+* Each line of the suite is a case: its name, the directory to run it in and the options given
+* to the simulator. Lines starting with '#' are comments.
+*
+* Build & run from the root of the repo (cmake adds the targets bench and bench-baseline):
+*	gcc -O2 tools/trace-bench/trace_bench.c -o trace_bench
+*	./trace_bench -x <simulator built with PROFILE=1> [-s suite] [-b baseline] [-o results] [-t percent] [-m seconds] [-r runs]
+* -t is the regression threshold, 10% by default. Times, and the rates computed from them, are
+* not compared when both are below the -m seconds (0.1 by default), as they are mostly noise.
+* -r runs each case several times and keeps the best figures.
+
+FSIN Functional Simulator of Interconnection Networks
+Copyright (2003-2011) J. Miguel-Alonso, A. Gonzalez, J. Navaridas
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define MAX_ARGS 64		///< Options of a case.
+#define MAX_NAME 64		///< Length of the name of a case.
+
+/**
+* The figures of a case.
+*/
+typedef struct result_t {
+	char name[MAX_NAME];	///< Name of the case.
+	long long cycles;		///< Cycles simulated.
+	double read_s;			///< Time reading the trace, in seconds.
+	double sim_s;			///< Time simulating, in seconds.
+	double events_s;		///< Trace events done per second.
+	double phits_s;			///< Phits moved per second.
+	long rss_kb;			///< Peak resident memory, in KB.
+	int ok;					///< Did the run finish and print its profile?
+} result_t;
+
+static char * simulator = NULL;		///< Absolute path of the simulator.
+static double threshold = 10.0;		///< Regression threshold, in percentage.
+static double min_s = 0.1;			///< Times below this are not compared.
+
+/**
+* Gets a number printed by the profiler.
+*
+* @param out The output of the simulator.
+* @param label The label before the number.
+* @param v The number, not modified when the label is missing.
+* @return 1 if the number has been found.
+*/
+static int get_figure(char *out, char *label, double *v) {
+	char *p = strstr(out, label);
+
+	return (p != NULL && sscanf(p + strlen(label), "%lf", v) == 1);
+}
+
+/**
+* Runs a case once.
+*
+* @param dir The directory to run it in.
+* @param argv The options, with room for one more and NULL terminated.
+* @param r The figures of the run.
+*/
+static void run_case(char *dir, char **argv, result_t *r) {
+	int fd[2], status;
+	pid_t pid;
+	struct rusage ru;
+	char *out = NULL;
+	size_t len = 0, cap = 0;
+	ssize_t n;
+	double v;
+
+	r->ok = 0;
+	if (pipe(fd) != 0 || (pid = fork()) < 0) {
+		perror("trace_bench");
+		exit(-1);
+	}
+	if (pid == 0) {
+		close(fd[0]);
+		dup2(fd[1], STDOUT_FILENO);
+		dup2(fd[1], STDERR_FILENO);
+		if (chdir(dir) != 0) {
+			perror(dir);
+			_exit(127);
+		}
+		execv(simulator, argv);
+		perror(simulator);
+		_exit(127);
+	}
+	close(fd[1]);
+	do {
+		if (len + 4096 > cap) {
+			cap = cap ? 2 * cap : 65536;
+			if ((out = realloc(out, cap + 1)) == NULL) {
+				fprintf(stderr, "trace_bench: Unable to allocate memory\n");
+				exit(-1);
+			}
+		}
+		n = read(fd[0], out + len, cap - len);
+		if (n > 0)
+			len += n;
+	} while (n > 0);
+	close(fd[0]);
+	out[len] = '\0';
+	if (wait4(pid, &status, 0, &ru) < 0) {
+		perror("trace_bench");
+		exit(-1);
+	}
+
+	r->rss_kb = ru.ru_maxrss;
+	r->read_s = 0.0;
+	r->events_s = 0.0;
+	if (WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+			get_figure(out, "Cycles performed:", &v) &&
+			get_figure(out, "Wall time (s):", &r->sim_s) &&
+			get_figure(out, "Phits moved per second:", &r->phits_s)) {
+		r->cycles = (long long)v;
+		get_figure(out, "Trace read time (s):", &r->read_s);
+		get_figure(out, "Trace events per second:", &r->events_s);
+		r->ok = 1;
+	}
+	free(out);
+}
+
+/**
+* Keeps the best figures of two runs of a case.
+*
+* @param best The best figures so far, updated.
+* @param r The figures of another run.
+*/
+static void keep_best(result_t *best, result_t *r) {
+	if (!r->ok)
+		best->ok = 0;
+	if (!best->ok)
+		return;
+	if (r->read_s < best->read_s)
+		best->read_s = r->read_s;
+	if (r->sim_s < best->sim_s)
+		best->sim_s = r->sim_s;
+	if (r->events_s > best->events_s)
+		best->events_s = r->events_s;
+	if (r->phits_s > best->phits_s)
+		best->phits_s = r->phits_s;
+	if (r->rss_kb < best->rss_kb)
+		best->rss_kb = r->rss_kb;
+}
+
+/**
+* Writes the figures of a case as a line of tab separated values.
+*
+* @param f The file.
+* @param r The figures.
+*/
+static void write_result(FILE *f, result_t *r) {
+	fprintf(f, "%s\t%lld\t%.3f\t%.3f\t%.0f\t%.0f\t%ld\t%s\n", r->name, r->cycles, r->read_s,
+			r->sim_s, r->events_s, r->phits_s, r->rss_kb, r->ok ? "ok" : "failed");
+}
+
+/**
+* Looks for a case in a baseline.
+*
+* @param f The baseline, NULL if there is none.
+* @param name The name of the case.
+* @param r The figures of the case in the baseline.
+* @return 1 if the case is in the baseline.
+*/
+static int find_baseline(FILE *f, char *name, result_t *r) {
+	char line[512], status[16];
+
+	if (f == NULL)
+		return 0;
+	rewind(f);
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if (line[0] == '#')
+			continue;
+		if (sscanf(line, "%63s %lld %lf %lf %lf %lf %ld %15s", r->name, &r->cycles, &r->read_s,
+				&r->sim_s, &r->events_s, &r->phits_s, &r->rss_kb, status) == 8 && !strcmp(r->name, name)) {
+			r->ok = !strcmp(status, "ok");
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+* Is a figure worse than in the baseline by more than the threshold?
+*
+* @param now The figure.
+* @param base The figure in the baseline.
+* @param higher Are higher figures better?
+* @return 1 if it is worse.
+*/
+static int worse(double now, double base, int higher) {
+	if (higher)
+		return (now * (1.0 + (threshold / 100.0)) < base);
+	return (now > base * (1.0 + (threshold / 100.0)));
+}
+
+/**
+* Compares the figures of a case with the ones in the baseline, printing the regressions.
+*
+* @param r The figures.
+* @param b The figures in the baseline.
+* @return The number of regressions.
+*/
+static int compare(result_t *r, result_t *b) {
+	int n = 0;
+
+	if (!r->ok)
+		return 1;
+	if (!b->ok)
+		return 0;
+	if (r->cycles != b->cycles)
+		printf("  %s: simulated %lld cycles, %lld in the baseline: the results have changed\n",
+				r->name, r->cycles, b->cycles);
+	if ((r->read_s >= min_s || b->read_s >= min_s) && worse(r->read_s, b->read_s, 0)) {
+		printf("  %s: trace read time %.3f s, %.3f s in the baseline\n", r->name, r->read_s, b->read_s);
+		n++;
+	}
+	if (r->sim_s >= min_s || b->sim_s >= min_s) {
+		if (worse(r->sim_s, b->sim_s, 0)) {
+			printf("  %s: simulation time %.3f s, %.3f s in the baseline\n", r->name, r->sim_s, b->sim_s);
+			n++;
+		}
+		if (worse(r->events_s, b->events_s, 1)) {
+			printf("  %s: %.0f events/s, %.0f in the baseline\n", r->name, r->events_s, b->events_s);
+			n++;
+		}
+		if (worse(r->phits_s, b->phits_s, 1)) {
+			printf("  %s: %.0f phits/s, %.0f in the baseline\n", r->name, r->phits_s, b->phits_s);
+			n++;
+		}
+	}
+	if (worse((double)r->rss_kb, (double)b->rss_kb, 0)) {
+		printf("  %s: peak memory %ld KB, %ld KB in the baseline\n", r->name, r->rss_kb, b->rss_kb);
+		n++;
+	}
+	return n;
+}
+
+/**
+* Runs a benchmark suite.
+*
+* @param argc The number of parameters given in the command line.
+* @param argv The parameters.
+* @return 0 if all the cases have run and none is worse than its baseline, 1 otherwise.
+*/
+int main(int argc, char *argv[]) {
+	char *suite_name = "tools/trace-bench/suite.txt", *base_name = NULL, *out_name = NULL;
+	char line[4096], *args[MAX_ARGS + 2], *tok, *dir, resolved[PATH_MAX];
+	FILE *suite, *base = NULL, *out = NULL;
+	result_t r, best, b;
+	int c, i, n, runs = 1, cases = 0, failed = 0, regressions = 0, k;
+
+	while ((c = getopt(argc, argv, "x:s:b:o:t:m:r:")) != -1) {
+		switch (c) {
+			case 'x': simulator = optarg; break;
+			case 's': suite_name = optarg; break;
+			case 'b': base_name = optarg; break;
+			case 'o': out_name = optarg; break;
+			case 't': threshold = atof(optarg); break;
+			case 'm': min_s = atof(optarg); break;
+			case 'r': runs = atoi(optarg); break;
+			default:
+				fprintf(stderr, "Usage: %s -x simulator [-s suite] [-b baseline] [-o results] [-t percent] [-m seconds] [-r runs]\n", argv[0]);
+				return 1;
+		}
+	}
+	if (simulator == NULL || realpath(simulator, resolved) == NULL) {
+		fprintf(stderr, "trace_bench: the simulator must be given with -x\n");
+		return 1;
+	}
+	simulator = resolved;
+	if ((suite = fopen(suite_name, "r")) == NULL) {
+		fprintf(stderr, "trace_bench: cannot open %s\n", suite_name);
+		return 1;
+	}
+	if (base_name != NULL && (base = fopen(base_name, "r")) == NULL)
+		printf("No baseline in %s, nothing to compare with\n", base_name);
+	if (out_name != NULL && (out = fopen(out_name, "w")) == NULL) {
+		fprintf(stderr, "trace_bench: cannot create %s\n", out_name);
+		return 1;
+	}
+	if (out != NULL)
+		fprintf(out, "#name\tcycles\tread_s\tsim_s\tevents_s\tphits_s\tmax_rss_kb\tstatus\n");
+	printf("%-16s %10s %9s %9s %12s %12s %10s\n", "case", "cycles", "read(s)", "sim(s)", "events/s", "phits/s", "rss(KB)");
+
+	while (fgets(line, sizeof(line), suite) != NULL) {
+		if (line[0] == '#' || (tok = strtok(line, " \t\n")) == NULL)
+			continue;
+		if ((dir = strtok(NULL, " \t\n")) == NULL) {
+			fprintf(stderr, "trace_bench: missing directory for %s\n", tok);
+			return 1;
+		}
+		args[0] = simulator;
+		for (n = 1; n <= MAX_ARGS - 1 && (args[n] = strtok(NULL, " \t\n")) != NULL; n++)
+			;
+		args[n++] = "profile=1";
+		args[n] = NULL;
+
+		for (i = 0; i < runs; i++) {
+			run_case(dir, args, &r);
+			if (i == 0)
+				best = r;
+			else
+				keep_best(&best, &r);
+		}
+		strncpy(best.name, tok, MAX_NAME - 1);
+		best.name[MAX_NAME - 1] = '\0';
+		cases++;
+		if (best.ok)
+			printf("%-16s %10lld %9.3f %9.3f %12.0f %12.0f %10ld\n", best.name, best.cycles,
+					best.read_s, best.sim_s, best.events_s, best.phits_s, best.rss_kb);
+		else {
+			printf("%-16s failed\n", best.name);
+			failed++;
+		}
+		fflush(stdout);
+		if (out != NULL) {
+			write_result(out, &best);
+			fflush(out);
+		}
+		if (find_baseline(base, best.name, &b) && (k = compare(&best, &b)) > 0)
+			regressions += best.ok ? k : 0;
+	}
+	fclose(suite);
+	if (base != NULL)
+		fclose(base);
+	if (out != NULL)
+		fclose(out);
+
+	printf("%d cases, %d failed, %d regressions beyond %.1f%%\n", cases, failed, regressions, threshold);
+	return (failed || regressions) ? 1 : 0;
+}
@@ -0,0 +1,342 @@
+/**
+* @file
+* @brief	Converter of text traces to the FSIN binary trace format.
+*
+* Reads a trace in fsin trc, dimemas or alog format, selected as read_trace() does, and writes
+* it in the binary format of btrace.h, which the simulator maps in memory instead of parsing it.
+* Messages keep their size in bytes, so the same binary trace is valid for any packet size.
+* Computations of trc traces keep their length, to be read in the units of the cpu_units option;
+* the ones of dimemas traces are converted to cycles, as read_dimemas() does. Collectives of trc
+* traces are kept as a record, to be expanded by the simulator with its collective_algorithm.
+*
+* Build & run from this directory:
+*	gcc -O2 -I../.. trc2bin.c -o trc2bin -lm && ./trc2bin <input trace> <output binary trace>
+
+FSIN Functional Simulator of Interconnection Networks
+Copyright (2003-2011) J. Miguel-Alonso, J. Navaridas
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "misc.h"
+#include "dimemas.h"
+#include "btrace.h"
+
+#define op_per_cycle 50		///< As in trace.c: balances the computation time (cpu time/op_per_cycle)==fsin cycles.
+#define cpuspeed  1e6		///< As in trace.c: the cpu speed in Mhz.
+#define BUFSIZE 131072		///< The size of the buffer.
+
+/**
+* The records of a task, while reading.
+*/
+typedef struct task_t {
+	btr_record * r;	///< The records.
+	long n;			///< Number of records.
+	long cap;		///< Room in #r.
+} task_t;
+
+static task_t * tasks = NULL;	///< All the tasks.
+static long ntasks = 0;			///< Number of tasks.
+static long line = 0;			///< Line being read, for the error messages.
+
+/**
+* Prints an error and finishes.
+*
+* @param mes The error message.
+*/
+void panic(char *mes) {
+	fprintf(stderr, "trc2bin: line %ld: %s\n", line, mes);
+	exit(-1);
+}
+
+/**
+* Makes room for some tasks.
+*
+* @param n The number of tasks.
+*/
+static void grow_tasks(long n) {
+	long i;
+
+	if (n <= ntasks)
+		return;
+	if ((tasks = realloc(tasks, sizeof(task_t) * n)) == NULL)
+		panic("Unable to allocate memory");
+	for (i = ntasks; i < n; i++) {
+		tasks[i].r = NULL;
+		tasks[i].n = tasks[i].cap = 0;
+	}
+	ntasks = n;
+}
+
+/**
+* Adds a record to a task, making room for the task if it is the first seen.
+*
+* @param task The task.
+* @param type 'c', 's', 'r' or a collective (BTR_ALLREDUCE...).
+* @param peer The other task, or the root of a broadcast.
+* @param tag The tag of the message.
+* @param value The size of the message or the length of the computation.
+*/
+static void add_record(long task, char type, long peer, long tag, long value) {
+	task_t *t;
+
+	if (task < 0 || peer < 0 || peer > INT32_MAX)
+		panic("Task id out of range");
+	grow_tasks(task + 1);
+	t = &tasks[task];
+	if (t->n == t->cap) {
+		t->cap = t->cap ? 2 * t->cap : 64;
+		if ((t->r = realloc(t->r, sizeof(btr_record) * t->cap)) == NULL)
+			panic("Unable to allocate memory");
+	}
+	t->r[t->n].type = type;
+	t->r[t->n].peer = (int32_t)peer;
+	t->r[t->n].tag = tag;
+	t->r[t->n].value = value;
+	t->n++;
+}
+
+/**
+* Gets the next field of a line as a number.
+*
+* @param sep The separators.
+* @return The number.
+*/
+static long next_long(char *sep) {
+	char *tok = strtok(NULL, sep);
+
+	if (tok == NULL)
+		panic("Missing field");
+	return atol(tok);
+}
+
+/**
+* Reads a fsin trc trace, as read_fsin_trc().
+*
+* @param f The trace.
+*/
+static void read_trc(FILE *f) {
+	char buffer[512], sep[] = " \t\n";
+	char *tok;
+	long n1, n2, tag, size;
+
+	while (fgets(buffer, 512, f) != NULL) {
+		line++;
+		if (buffer[0] == '\n' || buffer[0] == '#' || (tok = strtok(buffer, sep)) == NULL)
+			continue;
+		if (!strcmp(tok, "s") || !strcmp(tok, "r")) {
+			n1 = next_long(sep);	// from
+			n2 = next_long(sep);	// to
+			tag = next_long(sep);
+			size = next_long(sep);
+			if (n1 == n2)
+				continue;
+			if (!strcmp(tok, "s"))
+				add_record(n1, 's', n2, tag, size);
+			else
+				add_record(n2, 'r', n1, tag, size);
+		}
+		else if (!strcmp(tok, "c")) {
+			n1 = next_long(sep);
+			add_record(n1, 'c', n1, 0, next_long(sep));
+		}
+		else if (!strcmp(tok, "allreduce") || !strcmp(tok, "alltoall")) {
+			n1 = next_long(sep);
+			size = next_long(sep);
+			add_record(n1, strcmp(tok, "allreduce") ? BTR_ALLTOALL : BTR_ALLREDUCE, 0, 0, size);
+		}
+		else if (!strcmp(tok, "bcast")) {
+			n1 = next_long(sep);
+			n2 = next_long(sep);	// root
+			size = next_long(sep);
+			add_record(n1, BTR_BCAST, n2, 0, size);
+		}
+		else if (!strcmp(tok, "barrier"))
+			add_record(next_long(sep), BTR_BARRIER, 0, 0, 0);
+	}
+}
+
+/**
+* Reads an alog trace, as read_alog().
+*
+* @param f The trace.
+*/
+static void read_alog(FILE *f) {
+	char buffer[512], sep[] = " \t\n";
+	char *tok;
+	long n1, n2, tag, size;
+
+	while (fgets(buffer, 512, f) != NULL) {
+		line++;
+		if (buffer[0] == '\n' || buffer[0] == '#' || (tok = strtok(buffer, sep)) == NULL)
+			continue;
+		if (strcmp(tok, "-101") && strcmp(tok, "-102"))
+			continue;
+		n1 = next_long(sep);	// Local node
+		next_long(sep);			// Task: Not in Use
+		n2 = next_long(sep);	// Remote node
+		if (n1 == n2)
+			continue;
+		next_long(sep);			// Cycle: Not in Use
+		next_long(sep);			// Timestamp: Not in Use
+		tag = next_long(sep);
+		size = next_long(sep);
+		add_record(n1, strcmp(tok, "-101") ? 'r' : 's', n2, tag, size);
+	}
+}
+
+/**
+* Reads a dimemas trace, as read_dimemas(). Collectives, file I/O and other operations are
+* ignored, as the simulator does by default.
+*
+* @param f The trace.
+*/
+static void read_dimemas(FILE *f) {
+	char buffer[BUFSIZE], sep[] = ":", tsep[] = "(),";
+	char *op_id;
+	long task_id, t_id, size, tag, type, n, length;
+
+	if (fgets(buffer, BUFSIZE, f) == NULL || strncmp("#DIMEMAS", buffer, 8))
+		panic("Header line is missing, maybe not a dimemas file");
+	line++;
+	strtok(buffer, sep);	// Drops the #DIMEMAS.
+	strtok(NULL, sep);		// Drops trace_name.
+	strtok(NULL, sep);		// Offsets are dropped here.
+	n = next_long(tsep);
+	grow_tasks(n);
+
+	while (fgets(buffer, BUFSIZE, f) != NULL) {
+		line++;
+		op_id = strtok(buffer, sep);
+		if (op_id == NULL || !strcmp(op_id, "s") || !strcmp(op_id, "d"))
+			continue;
+		task_id = next_long(sep);
+		next_long(sep);		// Thread id.
+		switch (atol(op_id)) {
+		case CPU:
+			length = (long)ceil((atof(strtok(NULL, sep)) * cpuspeed) / op_per_cycle);
+			if (length > 0)
+				add_record(task_id, 'c', task_id, 0, length);
+			break;
+		case SEND:
+			t_id = next_long(sep);
+			size = next_long(sep);
+			tag = next_long(sep);
+			next_long(sep);		// Communicator.
+			type = next_long(sep);
+			if (type == NONE || type == RENDEZVOUS || type == IMMEDIATE || type == BOTH) {
+				if (task_id != t_id)
+					add_record(task_id, 's', t_id, tag, size);
+			}
+			else
+				fprintf(stderr, "WARNING: Unexpected Send type in line %ld: %ld\n", line, type);
+			break;
+		case RECEIVE:
+			t_id = next_long(sep);
+			size = next_long(sep);
+			tag = next_long(sep);
+			next_long(sep);		// Communicator.
+			type = next_long(sep);
+			if (type == RECV || type == WAIT) {
+				if (task_id != t_id)
+					add_record(task_id, 'r', t_id, tag, size);
+			}
+			else if (type != IRECV)
+				fprintf(stderr, "WARNING: Unexpected Reception type in line %ld: %ld\n", line, type);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/**
+* Converts a text trace to a binary one.
+*
+* @param argc The number of parameters given in the command line.
+* @param argv The input and output traces.
+* @return The finalization code.
+*/
+int main(int argc, char *argv[]) {
+	FILE *in, *out;
+	btr_header h;
+	int64_t pos;
+	long i, c;
+
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <input trace> <output binary trace>\n", argv[0]);
+		return -1;
+	}
+	if ((in = fopen(argv[1], "r")) == NULL) {
+		fprintf(stderr, "trc2bin: cannot open %s\n", argv[1]);
+		return -1;
+	}
+
+	memset(&h, 0, sizeof(h));
+	strcpy(h.magic, BTR_MAGIC);
+	h.order = BTR_ORDER;
+	h.version = BTR_VERSION;
+	h.units = BTR_UNITS_OPTION;
+	c = fgetc(in);
+	ungetc(c, in);
+	switch (c) {
+		case '#':
+			read_dimemas(in);
+			h.units = UNIT_CYCLES;
+			break;
+		case '-':
+			read_alog(in);
+			break;
+		case 'a':
+		case 'b':
+		case 'c':
+		case 's':
+		case 'r':
+			read_trc(in);
+			break;
+		default:
+			panic("Unsupported trace format");
+	}
+	fclose(in);
+
+	h.ntasks = ntasks;
+	for (i = 0; i < ntasks; i++)
+		h.nrecords += tasks[i].n;
+
+	if ((out = fopen(argv[2], "wb")) == NULL) {
+		fprintf(stderr, "trc2bin: cannot create %s\n", argv[2]);
+		return -1;
+	}
+	fwrite(&h, sizeof(h), 1, out);
+	for (i = 0, pos = 0; i <= ntasks; i++) {
+		fwrite(&pos, sizeof(pos), 1, out);
+		if (i < ntasks)
+			pos += tasks[i].n;
+	}
+	for (i = 0; i < ntasks; i++)
+		if (tasks[i].n && fwrite(tasks[i].r, sizeof(btr_record), tasks[i].n, out) != (size_t)tasks[i].n) {
+			fprintf(stderr, "trc2bin: error writing %s\n", argv[2]);
+			return -1;
+		}
+	if (fclose(out)) {
+		fprintf(stderr, "trc2bin: error writing %s\n", argv[2]);
+		return -1;
+	}
+	printf("%ld tasks, %lld records\n", ntasks, (long long)h.nrecords);
+	return 0;
+}
@@ -76,7 +76,7 @@ long torus_neighbor (long ad, dim wd, way ww) {
 routing_r mesh_rr (long source, long destination) {
     int i;
     routing_r res;
-    res.rr = alloc(ndim*sizeof(long));
+    res.rr = rr_alloc(ndim);
 
     if (source == destination)
         panic("Self-sent packet");
@@ -100,7 +100,7 @@ routing_r mesh_rr (long source, long destination) {
 routing_r torus_rr (long source, long destination) {
     routing_r res;
     int i;
-    res.rr = alloc(ndim*sizeof(long));
+    res.rr = rr_alloc(ndim);
 
     if(source == destination)
         panic("Self-sent packet");
@@ -134,7 +134,7 @@ routing_r torus_rr_unidir (long source, long destination) {
 	long sx, sy, sz, dx, dy, dz;
 	routing_r res;
 
-	res.rr=alloc(ndim*sizeof(long));
+	res.rr=rr_alloc(ndim);
 
 	if (source == destination)
 		panic("Self-sent packet");
@@ -25,9 +25,17 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "globals.h"
 #include "dimemas.h"
+#include "btrace.h"
+#if (THREADS != 0)
+#include <pthread.h>
+#endif
 
 #if (TRACE_SUPPORT != 0)
 
@@ -42,6 +50,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 void read_dimemas();
 void read_fsin_trc();
 void read_alog();
+void read_btr();
+static void map_feeds(void);
 
 void random_placement();
 void consecutive_placement();
@@ -53,22 +63,434 @@ void diagonal_placement();
 void icube_placement();
 void circulant_placement();
 void file_placement();
-void apx_placement();
-void apx_traces();
 
 long **translation;	///< A matrix containing the simulation nodes for each trace task.
 
+/**
+* Where the events of a node are taken from: the records of its task in the mapped trace.
+*/
+struct event_feed {
+	btr_record * next;	///< The next record of the task.
+	btr_record * end;	///< The end of the records of the task.
+	long inst;			///< The instance of the task run in the node.
+	long step;			///< Next message of the collective in #next.
+	long colls;			///< Collectives done, to give a tag to the messages of each one.
+};
+
+static void * btr_map = NULL;		///< The binary trace, mapped in memory.
+static size_t btr_size;				///< Size of the binary trace.
+static long btr_units;				///< Units of the computations in the binary trace.
+static struct event_feed * feeds;	///< The feed of each task instance.
+
+#define COLL_TAG (LONG_MIN / 2)	///< Tag of the messages of the first collective of a task. The next ones count down.
+#define COLL_MAX 256		///< Room for the messages of a task in a collective of logarithmic length.
+
+/**
+* Is this type of record a collective?
+*/
+#define is_coll(t) ((t) == BTR_ALLREDUCE || (t) == BTR_ALLTOALL || (t) == BTR_BCAST || (t) == BTR_BARRIER)
+#define SPILL_RECORDS 16	///< Records of each task buffered by each thread before writing them in the spilled trace.
+#define PART_MIN (1<<20)	///< Minimum size of the part of a text trace read by a thread.
+
+/**
+* A part of a text trace, read by one thread.
+*
+* Text traces are read in two passes: the first one counts the records of each task in
+* each part, and the second one writes them in their place, so the records of each task
+* keep the order of the trace whatever the number of parts.
+*/
+typedef struct trace_part {
+#if (THREADS != 0)
+	pthread_t th;		///< The thread reading this part.
+#endif
+	char * start;		///< First line of the part.
+	char * end;			///< End of the part, just after a line.
+	char * buffer;		///< Copy of the line being read.
+	long * next;		///< Records of each task in the part (first pass), position of the next one (second pass).
+	btr_record * spill;	///< #SPILL_RECORDS buffered records per task, when streaming.
+	long * used;		///< Records in the buffer of each task.
+	bool_t write;		///< Is this the second pass?
+} trace_part;
+
+static void (*parse_line)(char *buffer, struct trace_part *p);	///< The reader of a line of the text trace.
+static long line_size;		///< Size of the line buffer of the text trace format.
+static char * text_map;		///< The text trace, mapped in memory.
+static size_t text_size;	///< Size of the text trace.
+static btr_record * image;	///< Records of the text trace, when they are kept in memory.
+static int spill_fd;		///< The file of the spilled trace, when streaming.
+static off_t spill_base;	///< Position of the records in #spill_fd.
+static long dim_tasks;		///< Number of tasks in the header of a dimemas trace.
+
+static void dimemas_line(char *buffer, trace_part *p);
+static void trc_line(char *buffer, trace_part *p);
+static void alog_line(char *buffer, trace_part *p);
+
+#if (SKIP_CPU_BURSTS==1)
+/**
+* A CPU burst in execution.
+*/
+typedef struct burst_t {
+	CLOCK_TYPE end;	///< The cycle in which the burst does its last computation.
+	long node;		///< The node running the burst.
+} burst_t;
+
+static burst_t * bursts = NULL;	///< Min-heap of the CPU bursts in execution, ordered by #burst_t.end.
+static long * burst_pos;		///< Position of each node in #bursts, -1 if it has no burst there.
+static long nbursts = 0;		///< Number of bursts in the heap.
+#endif /* SKIP_CPU_BURSTS */
+
+/**
+* Length in packets of a message.
+*
+* @param size The size of the message in bytes.
+* @return The number of packets, at least 1.
+*/
+CLOCK_TYPE msg_packets(long size) {
+	if (size == 0)
+		size = 1;
+	return (long)ceil((double)size/(pkt_len*phit_len));
+}
+
+/**
+* Length in cycles of a computation.
+*
+* @param length The length of the computation.
+* @param units The units of the length.
+* @return The number of cycles.
+*/
+CLOCK_TYPE cpu_cycles(long length, cpu_units_t units) {
+	switch (units){
+		case UNIT_CYCLES:
+			return (CLOCK_TYPE)length;
+		case UNIT_MILLISECONDS:
+			return (CLOCK_TYPE)((length*1000*link_bw)/(8*phit_len));
+		case UNIT_MICROSECONDS:
+			return (CLOCK_TYPE)((length*link_bw)/(8*phit_len));
+		case UNIT_NANOSECONDS:
+			return (CLOCK_TYPE)((length*link_bw)/(8000*phit_len));
+		default:
+			panic("Unsupported CPU units");
+	}
+	return 0;
+}
+
+/**
+* Converts a record of a task instance to an event.
+*
+* @param task The task.
+* @param inst The instance of the task.
+* @param r The record.
+* @param units The units of the computations.
+* @param ev The event, to be filled.
+* @return FALSE if the record yields no event: a computation with no length or a message to itself.
+*/
+static bool_t record_event(long task, long inst, btr_record *r, cpu_units_t units, event *ev) {
+	if (r->type == 'c'){
+		ev->type=COMPUTATION;
+		ev->length=cpu_cycles((long)r->value, units);
+		if (ev->length<=0)
+			return B_FALSE;
+		ev->pid=translation[task][inst];
+	}
+	else {
+		if (r->peer<0 || r->peer>=trace_nodes)
+			panic("Adding comm event into an undefined task when reading trace");
+		if (r->peer == task)
+			return B_FALSE;
+		ev->type=(r->type == 's') ? SENDING : RECEPTION;
+		ev->task=(long)r->tag; // Type of message
+		ev->length=msg_packets((long)r->value); // Length of message
+		ev->pid=translation[r->peer][inst]; // Destination when sending, origin when receiving
+	}
+	ev->count=0;
+	return B_TRUE;
+}
+
+/**
+* Gets the type of a collective of a fsin trc trace.
+*
+* @param name The name of the collective.
+* @return The type of the record (BTR_ALLREDUCE...), or 0 if it is not a collective.
+*/
+static char coll_type(char *name) {
+	if (!strcmp(name, "allreduce"))
+		return BTR_ALLREDUCE;
+	if (!strcmp(name, "alltoall"))
+		return BTR_ALLTOALL;
+	if (!strcmp(name, "bcast"))
+		return BTR_BCAST;
+	if (!strcmp(name, "barrier"))
+		return BTR_BARRIER;
+	return 0;
+}
+
+/**
+* Appends a message to the expansion of a collective.
+*
+* @param l The messages of the task in the collective.
+* @param n The number of messages in l.
+* @param type 's' or 'r'.
+* @param peer The other task.
+* @param size The size of the message in bytes.
+* @return The new number of messages.
+*/
+static long coll_msg(btr_record *l, long n, char type, long peer, long size) {
+	l[n].type = type;
+	l[n].peer = (int32_t)peer;
+	l[n].tag = 0;
+	l[n].value = size;
+	return n + 1;
+}
+
+/**
+* Appends the messages of a task in a binomial tree broadcast.
+*
+* The parent of the task v (relative to the root) is v without its lowest bit set,
+* and its children are v plus each of the lower bits.
+*
+* @param l The messages of the task in the collective.
+* @param n The number of messages in l.
+* @param task The task.
+* @param root The root of the broadcast.
+* @param size The size of the message in bytes.
+* @return The new number of messages.
+*/
+static long tree_bcast(btr_record *l, long n, long task, long root, long size) {
+	long P = trace_nodes, v = (task - root + P) % P, mask;
+
+	if (v > 0){
+		n = coll_msg(l, n, 'r', ((v - (v & -v)) + root) % P, size);
+		mask = (v & -v) >> 1;
+	}
+	else {
+		for (mask = 1; mask < P; mask <<= 1);
+		mask >>= 1;
+	}
+	for (; mask > 0; mask >>= 1)
+		if (v + mask < P)
+			n = coll_msg(l, n, 's', (v + mask + root) % P, size);
+	return n;
+}
+
+/**
+* Appends the messages of a task in a binomial tree reduction, the reverse of tree_bcast().
+*
+* @param l The messages of the task in the collective.
+* @param n The number of messages in l.
+* @param task The task.
+* @param root The root of the reduction.
+* @param size The size of the message in bytes.
+* @return The new number of messages.
+*/
+static long tree_reduce(btr_record *l, long n, long task, long root, long size) {
+	long P = trace_nodes, v = (task - root + P) % P, mask;
+
+	for (mask = 1; (v == 0 || mask < (v & -v)) && mask < P; mask <<= 1)
+		if (v + mask < P)
+			n = coll_msg(l, n, 'r', (v + mask + root) % P, size);
+	if (v > 0)
+		n = coll_msg(l, n, 's', ((v - (v & -v)) + root) % P, size);
+	return n;
+}
+
+/**
+* Appends the messages of a task in a recursive doubling allreduce.
+*
+* When the number of tasks is not a power of two, the extra tasks first give their data
+* to a partner and get the result from it at the end.
+*
+* @param l The messages of the task in the collective.
+* @param n The number of messages in l.
+* @param task The task.
+* @param size The size of the message in bytes.
+* @return The new number of messages.
+*/
+static long rd_allreduce(btr_record *l, long n, long task, long size) {
+	long P = trace_nodes, p2, k;
+
+	for (p2 = 1; 2 * p2 <= P; p2 <<= 1);
+	if (task >= p2){
+		n = coll_msg(l, n, 's', task - p2, size);
+		return coll_msg(l, n, 'r', task - p2, size);
+	}
+	if (task < P - p2)
+		n = coll_msg(l, n, 'r', task + p2, size);
+	for (k = 1; k < p2; k <<= 1){
+		n = coll_msg(l, n, 's', task ^ k, size);
+		n = coll_msg(l, n, 'r', task ^ k, size);
+	}
+	if (task < P - p2)
+		n = coll_msg(l, n, 's', task + p2, size);
+	return n;
+}
+
+/**
+* Gets a message of a task in a collective, expanded with the algorithm in #coll_alg.
+*
+* - Broadcast: binomial tree (also for recursive doubling), or a chain from the root (ring).
+* - Allreduce: binomial reduction and broadcast from task 0, recursive doubling, or ring
+*   reduce-scatter & allgather, with messages of size/tasks.
+* - Alltoall: Bruck (binomial), pairwise exchange (recursive doubling, only for powers of
+*   two), or ring shifts.
+* - Barrier: binomial reduction and broadcast, dissemination (recursive doubling), or a token
+*   going twice around the ring.
+*
+* The collectives of O(tasks) messages are computed directly, so a collective costs the same
+* whatever the step, and the others are expanded whole for each step.
+*
+* @param c The collective.
+* @param task The task.
+* @param step The number of the message, starting at 0.
+* @param m The message, to be filled. The tag is not set.
+* @return FALSE if the task has no more messages in the collective.
+*/
+static bool_t coll_step(btr_record *c, long task, long step, btr_record *m) {
+	btr_record l[COLL_MAX];
+	long P = trace_nodes, size = (long)c->value, n = 0, i, rounds, to, from;
+
+	if (c->type == BTR_ALLTOALL || (c->type == BTR_ALLREDUCE && coll_alg == COLL_RING)){
+		if (c->type == BTR_ALLTOALL && coll_alg == COLL_BINOMIAL){ // Bruck: round i sends the blocks with bit i set.
+			if (step / 2 >= (long)(8 * sizeof(long)) - 2 || (i = 1L << (step / 2)) >= P)
+				return B_FALSE;
+			size *= ((P / (2 * i)) * i) + ((P % (2 * i) > i) ? (P % (2 * i)) - i : 0);
+			to = (task + i) % P;
+			from = (task - i + P) % P;
+		}
+		else {
+			rounds = (c->type == BTR_ALLTOALL) ? P - 1 : 2 * (P - 1);
+			if (step >= 2 * rounds)
+				return B_FALSE;
+			if (c->type == BTR_ALLTOALL)
+				i = (step / 2) + 1;
+			else {
+				i = 1;
+				size = (size + P - 1) / P;
+			}
+			if (c->type == BTR_ALLTOALL && coll_alg == COLL_RDOUBLING && (P & (P - 1)) == 0)
+				to = from = task ^ i;
+			else {
+				to = (task + i) % P;
+				from = (task - i + P) % P;
+			}
+		}
+		if (step % 2 == 0)
+			coll_msg(m, 0, 's', to, size);
+		else
+			coll_msg(m, 0, 'r', from, size);
+		return B_TRUE;
+	}
+
+	switch (c->type){
+		case BTR_BCAST:
+			if (coll_alg == COLL_RING){
+				i = (task - c->peer + P) % P;
+				if (i > 0)
+					n = coll_msg(l, n, 'r', (task - 1 + P) % P, size);
+				if (i + 1 < P)
+					n = coll_msg(l, n, 's', (task + 1) % P, size);
+			}
+			else
+				n = tree_bcast(l, n, task, c->peer, size);
+			break;
+		case BTR_ALLREDUCE:
+			if (coll_alg == COLL_RDOUBLING)
+				n = rd_allreduce(l, n, task, size);
+			else {
+				n = tree_reduce(l, n, task, 0, size);
+				n = tree_bcast(l, n, task, 0, size);
+			}
+			break;
+		case BTR_BARRIER:
+			if (coll_alg == COLL_RING){
+				for (i = 0; i < 2 && P > 1; i++)
+					if (task == 0){
+						n = coll_msg(l, n, 's', 1, 0);
+						n = coll_msg(l, n, 'r', P - 1, 0);
+					}
+					else {
+						n = coll_msg(l, n, 'r', task - 1, 0);
+						n = coll_msg(l, n, 's', (task + 1) % P, 0);
+					}
+			}
+			else if (coll_alg == COLL_RDOUBLING)
+				for (i = 1; i < P; i <<= 1){
+					n = coll_msg(l, n, 's', (task + i) % P, 0);
+					n = coll_msg(l, n, 'r', (task - i + P) % P, 0);
+				}
+			else {
+				n = tree_reduce(l, n, task, 0, 0);
+				n = tree_bcast(l, n, task, 0, 0);
+			}
+			break;
+		default:
+			panic("Unknown collective");
+	}
+	if (step >= n)
+		return B_FALSE;
+	*m = l[step];
+	return B_TRUE;
+}
+
+/**
+* Writes the buffered records of a task in their place of the spilled trace.
+*
+* @param p The part of the trace being read.
+* @param task The task.
+*/
+static void flush_spill(trace_part *p, long task) {
+	size_t size = p->used[task] * sizeof(btr_record);
+
+	if (pwrite(spill_fd, p->spill + (task * SPILL_RECORDS), size,
+			spill_base + (p->next[task] * sizeof(btr_record))) != (ssize_t)size)
+		panic("Cannot write the temporary file for streaming the trace");
+	p->next[task] += p->used[task];
+	p->used[task] = 0;
+}
+
+/**
+* Adds a record read from a text trace.
+*
+* In the first pass it is only counted. In the second one it is written in its place,
+* in memory or, when streaming, in the spilled trace.
+*
+* @param p The part of the trace being read.
+* @param task The task doing the event.
+* @param type 'c', 's' or 'r'.
+* @param peer The other task: destination when sending, source when receiving.
+* @param tag The tag of the message.
+* @param value The size of the message in bytes, or the length of the computation in cycles.
+*/
+static void add_record(trace_part *p, long task, char type, long peer, long tag, long value) {
+	btr_record *r;
+
+	if (!p->write){
+		p->next[task]++;
+		return;
+	}
+	if (image != NULL)
+		r = image + p->next[task]++;
+	else
+		r = p->spill + (task * SPILL_RECORDS) + p->used[task]++;
+	r->type = type;
+	r->peer = (int32_t)peer;
+	r->tag = tag;
+	r->value = value;
+	if (image == NULL && p->used[task] == SPILL_RECORDS)
+		flush_spill(p, task);
+}
+
 /**
 * The trace reader dispatcher selects the format type and calls to the correct trace read.
 *
 * The selection reads the first character in the file. This could be: '#' for dimemas,
-* 'c', 's' or 'r' for fsin trc, and '-' for alog (in complete trace the header is "-1",
-* or in filtered trace could be "-101" / "-102"). This is a very naive decision, so we
-* probably have to change this, but for the moment it works.
+* 'c', 's', 'r', 'a' or 'b' for fsin trc, '-' for alog (in complete trace the header is "-1",
+* or in filtered trace could be "-101" / "-102") and 'F' for a binary trace. This is a very
+* naive decision, so we probably have to change this, but for the moment it works.
 *
 *@see read_dimemas
 *@see read_fsin_trc
 *@see read_alog
+*@see read_btr
 */
 void read_trace(){
 	FILE * ftrc;
@@ -118,8 +540,7 @@ void read_trace(){
 			break;
 	}
     if(placement==MPA_PLACE){
-        apx_placement();
-        apx_traces();
+        mpa_init();
     }else{
         if((ftrc = fopen(trcfile, "r")) == NULL){
             char message[100];
@@ -139,8 +560,13 @@ void read_trace(){
             case 'c':
             case 's':
             case 'r':
+            case 'a':
+            case 'b':
                 read_fsin_trc();
                 break;
+            case 'F':
+                read_btr();
+                break;
             case -1:
                 printf("WARNING: Trace file is empty!!!\n");
                 break;
@@ -159,8 +585,232 @@ void trace_finish(){
 	for (i=0; i<trace_nodes; i++)
 		free(translation[i]);
         free(translation);
+	free_events();
+	if (pattern==MPA)
+		mpa_finish();
+	if (btr_map != NULL){
+		munmap(btr_map, btr_size);
+		free(feeds);
+		btr_map = NULL;
+	}
+#if (SKIP_CPU_BURSTS==1)
+	if (bursts != NULL){
+		free(bursts);
+		free(burst_pos);
+		bursts = NULL;
+		nbursts = 0;
+	}
+#endif
+}
+
+/**
+* Maps the text trace in memory.
+*
+* @param start The first byte of the trace.
+* @param end The end of the trace.
+*/
+static void map_text(char **start, char **end) {
+	int fd;
+	struct stat st;
+
+	if((fd = open(trcfile, O_RDONLY)) < 0 || fstat(fd, &st) < 0){
+		char message[100];
+		sprintf(message, "Trace file not found in current directory - %s",trcfile);
+		panic(message);
+	}
+	text_size = st.st_size;
+	if ((text_map = mmap(NULL, text_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+		panic("Cannot map the trace file");
+	close(fd);
+	madvise(text_map, text_size, MADV_SEQUENTIAL);
+	*start = text_map;
+	*end = text_map + text_size;
+}
+
+/**
+* Reads the lines of a part of the text trace.
+*
+* @param arg The part.
+* @return NULL.
+*/
+static void * read_part(void *arg) {
+	trace_part *p = arg;
+	char *line, *eol;
+	long len;
+	uintptr_t page = sysconf(_SC_PAGESIZE);
+	char *read = (char *)((uintptr_t)p->start & ~(page - 1));	// Pages before this are already read.
+
+	for (line = p->start; line < p->end; line = eol + 1){
+		if (line - read >= PART_MIN){
+			madvise(read, ((uintptr_t)line & ~(page - 1)) - (uintptr_t)read, MADV_DONTNEED);
+			read = (char *)((uintptr_t)line & ~(page - 1));
+		}
+		if ((eol = memchr(line, '\n', p->end - line)) == NULL)
+			eol = p->end;
+		len = eol - line;
+		if (len >= line_size)
+			len = line_size - 1;
+		memcpy(p->buffer, line, len);
+		p->buffer[len] = '\0';
+		(*parse_line)(p->buffer, p);
+	}
+	return NULL;
+}
+
+/**
+* Reads all the parts of the text trace, each one in its own thread.
+*
+* @param parts The parts.
+* @param nparts The number of parts.
+*/
+static void read_parts(trace_part *parts, long nparts) {
+	long k;
+
+#if (THREADS != 0)
+	for (k=1; k<nparts; k++)
+		if (pthread_create(&parts[k].th, NULL, read_part, &parts[k]))
+			panic("Cannot create the trace reading threads");
+	read_part(&parts[0]);
+	for (k=1; k<nparts; k++)
+		pthread_join(parts[k].th, NULL);
+#else
+	for (k=0; k<nparts; k++)
+		read_part(&parts[k]);
+#endif
 }
 
+/**
+* Reads the records of a text trace and gives each node a feed with the records of its task.
+*
+* The trace is split in parts, one per thread (#trace_threads), at line boundaries. The
+* parts are read twice: the first pass counts the records of each task in each part, which
+* gives the place of every record, and the second pass writes the records there. So the
+* records end up grouped by task in the order of the trace, as in a binary trace, and the
+* threads do not need to share anything. All the instances of a task take their events from
+* the same records, so the events are not replicated when loading.
+*
+* The records are kept in memory. When streaming (#trace_lookahead > 0) they are written
+* instead, buffered per task, to a temporary file in TMPDIR (or /tmp), which is removed at
+* once. The file is mapped and the events are taken from it as the simulation goes on, so
+* only the windows in the event queues and the pages being read are kept in memory.
+*
+* @param start The first line to read.
+* @param end The end of the trace.
+* @param line The reader of a line.
+* @param size Size of the line buffer.
+*
+* @see fill_events
+*/
+static void read_text(char *start, char *end, void (*line)(char *buffer, trace_part *p), long size) {
+	char name[FILENAME_MAX];
+	char * dir;
+	btr_header h;
+	int64_t *index;
+	trace_part *parts;
+	long nparts, k, t, n;
+	size_t head;
+
+	parse_line = line;
+	line_size = size;
+#if (THREADS != 0)
+	nparts = (trace_threads > 0) ? trace_threads : sysconf(_SC_NPROCESSORS_ONLN);
+	if (nparts > ((end - start) / PART_MIN) + 1)
+		nparts = ((end - start) / PART_MIN) + 1;
+#else
+	nparts = 1;
+#endif
+	parts = alloc(sizeof(trace_part) * nparts);
+	for (k=0; k<nparts; k++){
+		parts[k].start = (k == 0) ? start : parts[k-1].end;
+		parts[k].end = start + (((end - start) * (k + 1)) / nparts);
+		if (parts[k].end < parts[k].start)
+			parts[k].end = parts[k].start;
+		while (parts[k].end < end && parts[k].end[-1] != '\n')
+			parts[k].end++;
+		parts[k].buffer = alloc(size);
+		parts[k].next = alloc(sizeof(long) * trace_nodes);
+		for (t=0; t<trace_nodes; t++)
+			parts[k].next[t] = 0;
+		parts[k].write = B_FALSE;
+	}
+	read_parts(parts, nparts);
+
+	// The records of each task go after the ones of the previous task, in the order of the parts.
+	index = alloc(sizeof(int64_t) * (trace_nodes + 1));
+	index[0] = 0;
+	for (t=0; t<trace_nodes; t++){
+		index[t+1] = index[t];
+		for (k=0; k<nparts; k++){
+			n = parts[k].next[t];
+			parts[k].next[t] = index[t+1];
+			index[t+1] += n;
+		}
+	}
+	memset(&h, 0, sizeof(h));
+	strcpy(h.magic, BTR_MAGIC);
+	h.order = BTR_ORDER;
+	h.version = BTR_VERSION;
+	h.units = UNIT_CYCLES;
+	h.ntasks = trace_nodes;
+	h.nrecords = index[trace_nodes];
+	head = sizeof(btr_header) + ((trace_nodes + 1) * sizeof(int64_t));
+	btr_size = head + (h.nrecords * sizeof(btr_record));
+
+	if (trace_lookahead > 0){
+		if ((dir = getenv("TMPDIR")) == NULL)
+			dir = "/tmp";
+		snprintf(name, FILENAME_MAX, "%s/fsin-trace-XXXXXX", dir);
+		if ((spill_fd = mkstemp(name)) < 0)
+			panic("Cannot create a temporary file for streaming the trace");
+		unlink(name);
+		if (pwrite(spill_fd, &h, sizeof(h), 0) != sizeof(h) ||
+				pwrite(spill_fd, index, head - sizeof(h), sizeof(h)) != (ssize_t)(head - sizeof(h)) ||
+				ftruncate(spill_fd, btr_size) < 0)
+			panic("Cannot write the temporary file for streaming the trace");
+		spill_base = head;
+		image = NULL;
+		for (k=0; k<nparts; k++){
+			parts[k].spill = alloc(sizeof(btr_record) * SPILL_RECORDS * trace_nodes);
+			parts[k].used = alloc(sizeof(long) * trace_nodes);
+			for (t=0; t<trace_nodes; t++)
+				parts[k].used[t] = 0;
+		}
+	}
+	else {
+		if ((btr_map = mmap(NULL, btr_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+			panic("Cannot allocate memory for the trace");
+		memcpy(btr_map, &h, sizeof(h));
+		memcpy((btr_header *)btr_map + 1, index, head - sizeof(h));
+		image = (btr_record *)((char *)btr_map + head);
+	}
+	free(index);
+
+	for (k=0; k<nparts; k++)
+		parts[k].write = B_TRUE;
+	read_parts(parts, nparts);
+
+	for (k=0; k<nparts; k++){
+		if (image == NULL){
+			for (t=0; t<trace_nodes; t++)
+				flush_spill(&parts[k], t);
+			free(parts[k].spill);
+			free(parts[k].used);
+		}
+		free(parts[k].buffer);
+		free(parts[k].next);
+	}
+	free(parts);
+	munmap(text_map, text_size);
+
+	if (image == NULL){
+		if ((btr_map = mmap(NULL, btr_size, PROT_READ, MAP_SHARED, spill_fd, 0)) == MAP_FAILED)
+			panic("Cannot map the temporary file for streaming the trace");
+		close(spill_fd);
+	}
+	image = NULL;
+	btr_units = UNIT_CYCLES;
+	map_feeds();
+}
 
 /**
 * Reads a trace from a dimemas file.
@@ -168,15 +818,48 @@ void trace_finish(){
 * Read a trace from a dimemas file whose name is in global variable #trcfile
 * It only consideres events for CPU and point to point operations. File I/O could be
 * considered as a cpu event if FILEIO is defined.
+*
+* @see read_text
 */
 void read_dimemas() {
-	FILE * ftrc;
+	char *start, *end, *eol;
 	char buffer[BUFSIZE];
-	long i, n, inst;	///< The number of nodes is read here.
 	char sep[]=":";		///< Dimemas record separator.
 	char tsep[]="(),";	///< Separators to get the task info.
+	char *save;
+
+	map_text(&start, &end);
+	eol=memchr(start, '\n', end-start);
+	if (eol==NULL || eol-start>=BUFSIZE)
+		panic("Error reading from trace file");
+	memcpy(buffer, start, eol-start);
+	buffer[eol-start]='\0';
+
+	if (strncmp("#DIMEMAS", buffer, 8))
+		/// Could try to open traces in ALOG or FSIN trc format instead of panic....
+		panic("Header line is missing, maybe not a dimemas file");
+
+	strtok_r( buffer, sep, &save );	// Drops the #DIMEMAS.
+	strtok_r( NULL, sep, &save );	// Drops trace_name.
+	strtok_r( NULL, sep, &save );	// Offsets are dropped here.
+	dim_tasks=atol(strtok_r(NULL, tsep, &save));	// task info has diferent separators
+	if (dim_tasks>trace_nodes)
+		panic("Trace has more nodes than stated in trace_nodes");
+
+	read_text(eol+1, end, dimemas_line, BUFSIZE);
+}
+
+/**
+* Reads a line of a dimemas trace.
+*
+* @param buffer The line.
+* @param p The part of the trace being read.
+*/
+static void dimemas_line(char *buffer, trace_part *p) {
+	char sep[]=":";		///< Dimemas record separator.
 
 	char *op_id;		///< Operation id.
+	char *save;			///< State of strtok_r.
 	long type;			///< Global operation id(for collectives), point-to-point type.
 	long task_id;		///< Task id.
 	long th_id;			///< Thread id.
@@ -192,399 +875,344 @@ void read_dimemas() {
 	long rth_id;		///< Root thread in collectives.
 	long bsent;			///< Bytes sent in collectives.
 	long brecv;			///< Bytes received in collectives.
-	event ev;			///< The read event.
-
-	if((ftrc = fopen(trcfile, "r")) == NULL){
-		char message[100];
-		sprintf(message, "Trace file not found in current directory - %s",trcfile);
-		panic(message);
-	}
-
-	if (fgets(buffer,BUFSIZE,ftrc)==NULL)
-		panic("Error reading from trace file");
-
-	if (strncmp("#DIMEMAS", buffer, 8))
-		/// Could try to open traces in ALOG or FSIN trc format instead of panic....
-		panic("Header line is missing, maybe not a dimemas file");
-
-	strtok( buffer, sep );	// Drops the #DIMEMAS.
-	strtok( NULL, sep );	// Drops trace_name.
-	strtok( NULL, sep);		// Offsets are dropped here.
-	n=atol(strtok(NULL, tsep));	// task info has diferent separators
-	if (n>trace_nodes)
-		panic("Trace has more nodes than stated in trace_nodes");
-
-	while(fgets(buffer, BUFSIZE, ftrc) != NULL) {
-		op_id=strtok( buffer, sep);
-		if (!strcmp(op_id,"s")) // Offset
-			// As we parse the whole file, it is not important for us.
-			continue;
-
-		if (!strcmp(op_id,"d")){ // Definitions.
-			type=atol(strtok( NULL, sep));
-			switch (type){
-				case COMMUNICATOR:
-					// Not implemented yet.
-					break;
-				case FILE_IO:
-					// It doesn't care about what files are accessed during the execution of the traces.
-					// It doesn't even if the FILEIO is active.
-					break;
-				case OSWINDOW:
-					// We could treat the one side windows as MPI communicators.
-					break;
-				default:
-				panic("Wrong definition when reading dimemas file");
-			}
-			continue;
-		}
-		task_id=atol(strtok( NULL, sep)); //We have the task id.
-		if ( task_id>n || task_id <0 )
-			panic ("Task id out of range when reading dimemas file");
-		th_id=atol(strtok( NULL, sep)); //We have the thread id.
-		switch (atol(op_id)){
-		case CPU:
-			cpu_burst=atof(strtok( NULL, sep)); //We have the time taken by the CPU.
-			ev.type=COMPUTATION;
-			ev.length=(long)ceil((cpu_burst*cpuspeed)/op_per_cycle); // Computation time.
-			if (ev.length>0){
-                ev.count=0;	// Elapsed time.
-                if (task_id<trace_nodes && task_id>=0)
-                    for (inst=0; inst<trace_instances; inst++){
-                        ev.pid=translation[task_id][inst];
-                        ins_event(&network[ev.pid].events, ev); // Add event to its node event queue
-                    }
-                else
-                    panic("Adding cpu event into an undefined task when reading dimemas file");
-			}
-			break;
-
-		case SEND:
-			t_id=atol(strtok( NULL, sep)); //We have the destination task id.
-			if ( t_id>nprocs || t_id <0 )
-				panic ("Destination task id out of range when reading dimemas file");
-			size=atol(strtok( NULL, sep)); //We have the size.
-			tag=atol(strtok( NULL, sep));  //We have the tag.
-			comm=atol(strtok( NULL, sep)); //We have the communicator id.
-			type=atol(strtok( NULL, sep)); //We have the send type (I, B, S or -).
-			switch (type){
-			case NONE:       // This should be Bsend (buffered)
-			case RENDEZVOUS: // This should be Ssend (synchronized)
-			case IMMEDIATE:  // This should be Isend (inmediate)
-			case BOTH:       // This should be Issend(inmediate & synchronized)
-				ev.type=SENDING;
-				if (task_id !=t_id) { // Valid event
-					ev.task=tag; // Type of message
-					ev.length=size; // Length of message
-					ev.count=0; // Packets sent or received
-					if (ev.length == 0)
-						ev.length=1;
-					ev.length = (long)ceil ( (double)ev.length/(pkt_len*phit_len));
-					if (task_id<trace_nodes && t_id<trace_nodes && task_id>=0 && t_id>=0)
-						for (inst=0; inst<trace_instances; inst++){
-							i=translation[task_id][inst]; // Node to add event
-							ev.pid=translation[t_id][inst]; // event's PID: destination when we are sending
-							ins_event(&network[i].events, ev); // Add event to its node event queue
-						}
-					else
-						panic("Adding comm event into an undefined task when reading dimemas file");
-				}
+	CLOCK_TYPE length;	///< Length of a computation, in cycles.
+
+	op_id=strtok_r(buffer, sep, &save);
+	if (op_id==NULL || !strcmp(op_id,"s")) // Offset
+		// As we parse the whole file, it is not important for us.
+		return;
+
+	if (!strcmp(op_id,"d")){ // Definitions.
+		type=atol(strtok_r(NULL, sep, &save));
+		switch (type){
+			case COMMUNICATOR:
+				// Not implemented yet.
 				break;
-			default:
-				printf("WARNING: Unexpected Send type when reading dimemas file: %ld!!!\n", type);
-				continue;
-			}
-			break;
-
-		case RECEIVE:
-			t_id=atol(strtok( NULL, sep)); //We have the source task id.
-			if ( t_id>nprocs || t_id <0 )
-				panic ("Source task id out of range when reading dimemas file");
-			size=atol(strtok( NULL, sep)); //We have the size.
-			tag=atol(strtok( NULL, sep));  //We have the tag.
-			comm=atol(strtok( NULL, sep)); //We have the communicator id.
-			type=atol(strtok( NULL, sep)); //We have the recv type (Recv, Irecv or Wait).
-			switch (type){
-			case IRECV: // This is not useful for us.
+			case FILE_IO:
+				// It doesn't care about what files are accessed during the execution of the traces.
+				// It doesn't even if the FILEIO is active.
 				break;
-			// A reception and a wait is the same for us.
-			case RECV:
-			case WAIT:
-				ev.type=RECEPTION;
-				if (t_id!=task_id) {// Valid event
-					ev.task=tag; // Type of message
-					ev.length=size; // Length of message
-					ev.count=0; // Packets sent or received
-					if (ev.length == 0)
-						ev.length=1;
-					ev.length = (long)ceil ( (double)ev.length/(pkt_len*phit_len));
-					if (task_id<trace_nodes && t_id<trace_nodes && task_id>=0 && t_id>=0)
-						for (inst=0; inst<trace_instances; inst++){
-							i=translation[task_id][inst]; // Node to add event
-							ev.pid=translation[t_id][inst]; // event's PID: destination when we are sending
-							ins_event(&network[i].events, ev); // Add event to its node event queue
-						}
-					else
-						panic("Adding comm event into an undefined task when reading dimemas file");
-				}
+			case OSWINDOW:
+				// We could treat the one side windows as MPI communicators.
 				break;
 			default:
-				printf("WARNING: Unexpected Reception type when reading dimemas file: %ld!!!\n",type);
-				continue;
+			panic("Wrong definition when reading dimemas file");
+		}
+		return;
+	}
+	task_id=atol(strtok_r(NULL, sep, &save)); //We have the task id.
+	if ( task_id>dim_tasks || task_id <0 )
+		panic ("Task id out of range when reading dimemas file");
+	th_id=atol(strtok_r(NULL, sep, &save)); //We have the thread id.
+	switch (atol(op_id)){
+	case CPU:
+		cpu_burst=atof(strtok_r(NULL, sep, &save)); //We have the time taken by the CPU.
+		length=(long)ceil((cpu_burst*cpuspeed)/op_per_cycle); // Computation time.
+		if (length>0){
+            if (task_id<trace_nodes && task_id>=0)
+                add_record(p, task_id, 'c', task_id, 0, length);
+            else
+                panic("Adding cpu event into an undefined task when reading dimemas file");
+		}
+		break;
+
+	case SEND:
+		t_id=atol(strtok_r(NULL, sep, &save)); //We have the destination task id.
+		if ( t_id>nprocs || t_id <0 )
+			panic ("Destination task id out of range when reading dimemas file");
+		size=atol(strtok_r(NULL, sep, &save)); //We have the size.
+		tag=atol(strtok_r(NULL, sep, &save));  //We have the tag.
+		comm=atol(strtok_r(NULL, sep, &save)); //We have the communicator id.
+		type=atol(strtok_r(NULL, sep, &save)); //We have the send type (I, B, S or -).
+		switch (type){
+		case NONE:       // This should be Bsend (buffered)
+		case RENDEZVOUS: // This should be Ssend (synchronized)
+		case IMMEDIATE:  // This should be Isend (inmediate)
+		case BOTH:       // This should be Issend(inmediate & synchronized)
+			if (task_id !=t_id) { // Valid event
+				if (task_id<trace_nodes && t_id<trace_nodes && task_id>=0 && t_id>=0)
+					add_record(p, task_id, 's', t_id, tag, size);
+				else
+					panic("Adding comm event into an undefined task when reading dimemas file");
 			}
 			break;
-
-		case COLLECTIVE:
-			type=atol(strtok( NULL, sep));     //We have the global operation id.
-			comm=atol(strtok( NULL, sep));     //We have the communicator id.
-			rtask_id=atol(strtok( NULL, sep)); //We have the root task_id.
-			rth_id=atol(strtok( NULL, sep));   //We have the root thread_id.
-			bsent=atol(strtok( NULL, sep));    //We have the sent byte count.
-			brecv=atol(strtok( NULL, sep));    //We have the received byte count.
-			switch (type){
-			case OP_MPI_Barrier:
-				break;
-			case OP_MPI_Bcast:
-				break;
-			case OP_MPI_Gather:
-				break;
-			case OP_MPI_Gatherv:
-				break;
-			case OP_MPI_Scatter:
-				break;
-			case OP_MPI_Scatterv:
-				break;
-			case OP_MPI_Allgather:
-				break;
-			case OP_MPI_Allgatherv:
-				break;
-			case OP_MPI_Alltoall:
-				break;
-			case OP_MPI_Alltoallv:
-				break;
-			case OP_MPI_Reduce:
-				break;
-			case OP_MPI_Allreduce:
-				break;
-			case OP_MPI_Reduce_Scatter:
-				break;
-			case OP_MPI_Scan:
-				break;
-			default:
-				printf("WARNING: Unexpected Collective type when reading dimemas file!!!\n");
-				continue;
+		default:
+			if (!p->write)
+				printf("WARNING: Unexpected Send type when reading dimemas file: %ld!!!\n", type);
+			return;
+		}
+		break;
+
+	case RECEIVE:
+		t_id=atol(strtok_r(NULL, sep, &save)); //We have the source task id.
+		if ( t_id>nprocs || t_id <0 )
+			panic ("Source task id out of range when reading dimemas file");
+		size=atol(strtok_r(NULL, sep, &save)); //We have the size.
+		tag=atol(strtok_r(NULL, sep, &save));  //We have the tag.
+		comm=atol(strtok_r(NULL, sep, &save)); //We have the communicator id.
+		type=atol(strtok_r(NULL, sep, &save)); //We have the recv type (Recv, Irecv or Wait).
+		switch (type){
+		case IRECV: // This is not useful for us.
+			break;
+		// A reception and a wait is the same for us.
+		case RECV:
+		case WAIT:
+			if (t_id!=task_id) {// Valid event
+				if (task_id<trace_nodes && t_id<trace_nodes && task_id>=0 && t_id>=0)
+					add_record(p, task_id, 'r', t_id, tag, size);
+				else
+					panic("Adding comm event into an undefined task when reading dimemas file");
 			}
 			break;
-
-		case EVENT:
-			// This will be useful to generate paraver output files.
+		default:
+			if (!p->write)
+				printf("WARNING: Unexpected Reception type when reading dimemas file: %ld!!!\n",type);
+			return;
+		}
+		break;
+
+	case COLLECTIVE:
+		type=atol(strtok_r(NULL, sep, &save));     //We have the global operation id.
+		comm=atol(strtok_r(NULL, sep, &save));     //We have the communicator id.
+		rtask_id=atol(strtok_r(NULL, sep, &save)); //We have the root task_id.
+		rth_id=atol(strtok_r(NULL, sep, &save));   //We have the root thread_id.
+		bsent=atol(strtok_r(NULL, sep, &save));    //We have the sent byte count.
+		brecv=atol(strtok_r(NULL, sep, &save));    //We have the received byte count.
+		switch (type){
+		case OP_MPI_Barrier:
 			break;
-
-// IO events could be treated as CPU or NETWORK events.
-		case FREAD:
-		case FWRITE:
-#ifdef FILEIO
-			strtok( NULL, sep);       // File Descriptor is dropped here.
-			strtok( NULL, sep);       // Required size is dropped here.
-			cpu_burst=atol(strtok( NULL, sep));   //We have the size.
-			ev.type=COMPUTATION;
-			ev.length=(long)ceil((FILE_TIME+(FILE_SCALE*cpu_burst)/op_per_cycle)); // Computation time.
-			if (ev.length>0){
-                ev.count=0;				// Elapsed time.
-                if (task_id<trace_nodes && task_id>=0)
-                    for (inst=0; inst<trace_instances; inst++){
-                        ev.pid=translation[task_id][inst];
-                        ins_event(&network[ev.pid].events, ev); // Add event to its node event queue
-                    }
-                else
-                    panic("Adding cpu event into an undefined task when reading dimemas file");
-			}
-#endif
+		case OP_MPI_Bcast:
 			break;
-
-		case FOPEN:
-		case FSEEK:
-		case FCLOSE:
-		case FDUP:
-		case FUNLINK:
-#ifdef FILEIO
-			ev.type=COMPUTATION;
-			ev.length=(long)ceil((FILE_TIME)/op_per_cycle); // Computation time.
-			if (ev.length>0){
-                ev.count=0; // Elapsed time.
-                if (task_id<trace_nodes && task_id>=0)
-                    for (inst=0; inst<trace_instances; inst++){
-                        ev.pid=translation[task_id][inst];
-                        ins_event(&network[ev.pid].events, ev); // Add event to its node event queue
-                    }
-                else
-                    panic("Adding cpu event into an undefined task when reading dimemas file");
-			}
-#endif
-
+		case OP_MPI_Gather:
 			break;
-		case IOCOLL:
+		case OP_MPI_Gatherv:
 			break;
-		case IOBLOCKNCOLL:
+		case OP_MPI_Scatter:
 			break;
-		case IOBLOCKCOLL:
+		case OP_MPI_Scatterv:
 			break;
-		case IONBLOCKNCOLLBEGIN:
+		case OP_MPI_Allgather:
 			break;
-		case IONBLOCKNCOLLEND:
+		case OP_MPI_Allgatherv:
 			break;
-		case IONBLOCKCOLLBEGIN:
+		case OP_MPI_Alltoall:
 			break;
-		case IONBLOCKCOLLEND:
+		case OP_MPI_Alltoallv:
 			break;
-		case ONESIDEGENOP:
+		case OP_MPI_Reduce:
 			break;
-		case ONESIDEFENCE:
+		case OP_MPI_Allreduce:
 			break;
-		case ONESIDELOCK:
+		case OP_MPI_Reduce_Scatter:
 			break;
-		case ONESIDEPOST:
+		case OP_MPI_Scan:
 			break;
-		case LAPIOP:
-			/// These are communication with different semantic values of the MPI. In study...
+		default:
+			if (!p->write)
+				printf("WARNING: Unexpected Collective type when reading dimemas file!!!\n");
+			return;
+		}
+		break;
+
+	case EVENT:
+		// This will be useful to generate paraver output files.
+		break;
+
+// IO events could be treated as CPU or NETWORK events.
+	case FREAD:
+	case FWRITE:
+#ifdef FILEIO
+		strtok_r(NULL, sep, &save);       // File Descriptor is dropped here.
+		strtok_r(NULL, sep, &save);       // Required size is dropped here.
+		cpu_burst=atol(strtok_r(NULL, sep, &save));   //We have the size.
+		length=(long)ceil((FILE_TIME+(FILE_SCALE*cpu_burst)/op_per_cycle)); // Computation time.
+		if (length>0){
+            if (task_id<trace_nodes && task_id>=0)
+                add_record(p, task_id, 'c', task_id, 0, length);
+            else
+                panic("Adding cpu event into an undefined task when reading dimemas file");
+		}
+#endif
+		break;
+
+	case FOPEN:
+	case FSEEK:
+	case FCLOSE:
+	case FDUP:
+	case FUNLINK:
+#ifdef FILEIO
+		length=(long)ceil((FILE_TIME)/op_per_cycle); // Computation time.
+		if (length>0){
+            if (task_id<trace_nodes && task_id>=0)
+                add_record(p, task_id, 'c', task_id, 0, length);
+            else
+                panic("Adding cpu event into an undefined task when reading dimemas file");
+		}
+#endif
+
+		break;
+	case IOCOLL:
+		break;
+	case IOBLOCKNCOLL:
+		break;
+	case IOBLOCKCOLL:
+		break;
+	case IONBLOCKNCOLLBEGIN:
+		break;
+	case IONBLOCKNCOLLEND:
+		break;
+	case IONBLOCKCOLLBEGIN:
+		break;
+	case IONBLOCKCOLLEND:
+		break;
+	case ONESIDEGENOP:
+		break;
+	case ONESIDEFENCE:
+		break;
+	case ONESIDELOCK:
+		break;
+	case ONESIDEPOST:
+		break;
+	case LAPIOP:
+		/// These are communication with different semantic values of the MPI. In study...
 #ifdef LAPI
-			type=atol(strtok( NULL, sep));      //We have the LAPI operation.
-			strtok( NULL, sep);                 //Handler dropped here.
-			t_id=atol(strtok( NULL, sep));      //We have the destination task id.
-			if ( t_id>=trace_nodes || t_id <0 ){
-				printf ("Destination task id is not defined (%ld): Aborting!!!\n",task_id);
-				return -1;
-			}
+		type=atol(strtok_r(NULL, sep, &save));      //We have the LAPI operation.
+		strtok_r(NULL, sep, &save);                 //Handler dropped here.
+		t_id=atol(strtok_r(NULL, sep, &save));      //We have the destination task id.
+		if ( t_id>=trace_nodes || t_id <0 ){
+			printf ("Destination task id is not defined (%ld): Aborting!!!\n",task_id);
+			return -1;
+		}
 
-			size=atol(strtok( NULL, sep));      //We have the size.
-
-			switch (type){
-				case LAPI_Init:
-				case LAPI_End:
-					break;
-				case LAPI_Put:
-					break;
-				case LAPI_Get:
-					break;
-				case LAPI_Fence: // Could be a Wait
-					break;
-				case LAPI_Barrier: // Could be a Barrier
-					break;
-				case LAPI_Alltoall: // Could be an Alltoall
-					break;
-				default:
-					printf ("Undefined LAPI operation: %ld\n");
-					break;
-			}
+		size=atol(strtok_r(NULL, sep, &save));      //We have the size.
+
+		switch (type){
+			case LAPI_Init:
+			case LAPI_End:
+				break;
+			case LAPI_Put:
+				break;
+			case LAPI_Get:
+				break;
+			case LAPI_Fence: // Could be a Wait
+				break;
+			case LAPI_Barrier: // Could be a Barrier
+				break;
+			case LAPI_Alltoall: // Could be an Alltoall
+				break;
+			default:
+				printf ("Undefined LAPI operation: %ld\n");
+				break;
+		}
 #endif
-			break;
-		default:
+		break;
+	default:
+		if (!p->write)
 			printf("WARNING: Unexpected operation when reading dimemas file!!!\n");
-		}
 	}
-	fclose(ftrc);
 }
 
 /**
 * Reads a trace from a file.
 *
 * Read a trace from a fsin trc file whose name is in global variable #trcfile
-* This format only takes in account 'c' CPU, 's' SEND, 'r' RECV, events.
+* This format only takes in account 'c' CPU, 's' SEND, 'r' RECV, events, and the collectives
+* of all the tasks, which every task must have in the same order:
+*         allreduce task size
+*         alltoall task size
+*         bcast task root size
+*         barrier task
+* The collectives are expanded into point-to-point messages when the task reaches them,
+* with the algorithm in #coll_alg.
+*
+* @see coll_step
 */
 void read_fsin_trc() {
-	FILE * ftrc;
-	char buffer[512];
+	char *start, *end;
+
+	map_text(&start, &end);
+	read_text(start, end, trc_line, 512);
+}
+
+/**
+* Reads a line of a fsin trc trace.
+*
+* @param buffer The line.
+* @param p The part of the trace being read.
+*/
+static void trc_line(char *buffer, trace_part *p) {
 	char * tok;
+	char * save;
 	char sep[]=" \t";
-	event ev;
-	long i,n1,n2,inst;
+	char type;
+	long n1,n2,tag;
+	CLOCK_TYPE length;
+
+	if (buffer[0] == '#' || (tok = strtok_r(buffer, sep, &save)) == NULL)
+		return;
+
+	if (strcmp(tok, "s")==0 || strcmp(tok, "r")==0) { // Communication.
+		if (strcmp(tok, "s")==0){
+			type='s';
+			tok=strtok_r(NULL, sep, &save); // from
+			n1=atol(tok); // Sendet (Node to add event)
+			tok=strtok_r(NULL, sep, &save);
+			n2=atol(tok); // event's PID: destination when we are sending
+		}
+		else{ // if (strcmp(tok, "r")==0)
+			type='r';
+			tok=strtok_r(NULL, sep, &save); // from
+			n2=atol(tok); // event's PID: origin of the message
+			tok=strtok_r(NULL, sep, &save);
+			n1=atol(tok); // Destination of the message (local node)
+		}
 
-	if((ftrc = fopen(trcfile, "r")) == NULL){
-		char message[100];
-		sprintf(message, "Trace file not found in current directory - %s",trcfile);
-		panic(message);
+		if (n1!=n2) {
+			// Valid event
+			tok=strtok_r(NULL, sep, &save);
+			tag=atol(tok); // Type of message
+			tok=strtok_r(NULL, sep, &save);
+			if (n1<trace_nodes && n2<trace_nodes && n1>=0 && n2>=0)
+				add_record(p, n1, type, n2, tag, atol(tok)); // Size of message
+			else
+				panic("Adding comm event into an undefined task when reading trc");
+		}
 	}
 
-	while(fgets(buffer, 512, ftrc) != NULL) {
-		if(buffer[0] != '\n' && buffer[0] != '#') {
-			if(buffer[strlen(buffer) - 1] == '\n')
-				buffer[strlen(buffer) - 1] = '\0';
-
-			tok = strtok( buffer, sep);
-
-			if (strcmp(tok, "s")==0 || strcmp(tok, "r")==0) { // Communication.
-				if (strcmp(tok, "s")==0){
-					ev.type=SENDING;
-					tok=strtok(NULL, sep); // from
-					n1=atol(tok); // Sendet (Node to add event)
-					tok=strtok(NULL, sep);
-					n2=atol(tok); // event's PID: destination when we are sending
-				}
-				else{ // if (strcmp(tok, "r")==0)
-					ev.type=RECEPTION;
-					tok=strtok(NULL, sep); // from
-					n2=atol(tok); // event's PID: origin of the message
-					tok=strtok(NULL, sep);
-					n1=atol(tok); // Destination of the message (local node)
-				}
-
-				if (n1!=n2) {
-					// Valid event
-					tok=strtok(NULL, sep);
-					ev.task=atol(tok); // Type of message (tag)
-					tok=strtok(NULL, sep);
-					ev.length=atol(tok); // Length of message
-					ev.count=0; // Packets sent or received
-					if (ev.length == 0)
-						ev.length=1;
-					ev.length = (long)ceil ( (double)ev.length/(pkt_len*phit_len));
-					if (n1<trace_nodes && n2<trace_nodes && n1>=0 && n2>=0)
-						for (inst=0; inst<trace_instances; inst++){
-							i=translation[n1][inst]; // Node to add event
-							ev.pid=translation[n2][inst]; // event's PID: destination when we are sending
-							ins_event(&network[i].events, ev); // Add event to its node event queue
-						}
-					else
-						panic("Adding comm event into an undefined task when reading trc");
-				}
-			}
+	else if (strcmp(tok, "c")==0){ // Computation.
+		tok=strtok_r(NULL, sep, &save);
+		n1=atol(tok); // nodeId.
+		tok=strtok_r(NULL, sep, &save);
+		length=cpu_cycles(atol(tok), cpu_units);
+        if (length>0){
+            if (n1<trace_nodes && n1>=0)
+                add_record(p, n1, 'c', n1, 0, length);
+            else
+                panic("Adding cpu event into an undefined task when reading trc");
+        }
+	}
 
-			else if (strcmp(tok, "c")==0){ // Computation.
-				ev.type=COMPUTATION;
-				tok=strtok(NULL, sep);
-				n1=atol(tok); // nodeId.
-				tok=strtok(NULL, sep);
-				switch (cpu_units){
-                    case UNIT_CYCLES:
-                        ev.length=((CLOCK_TYPE)atol(tok));
-                        break;
-                    case UNIT_MILLISECONDS:
-                        ev.length=(CLOCK_TYPE)(((atol(tok))*1000*link_bw)/(8*phit_len));
-                        break;
-                    case UNIT_MICROSECONDS:
-                        ev.length=(CLOCK_TYPE)(((atol(tok))*link_bw)/(8*phit_len));
-                        break;
-                    case UNIT_NANOSECONDS:
-                        ev.length=(CLOCK_TYPE)(((atol(tok))*link_bw)/(8000*phit_len));
-                        break;
-                    default:
-                        panic("Unsupported CPU units");
-
-                }
-                if (ev.length>0){
-                    ev.count=0; // Elapsed time.
-                    if (n1<trace_nodes && n1>=0)
-                        for (inst=0; inst<trace_instances; inst++){
-                            ev.pid=translation[n1][inst]; // Node to add event
-                            ins_event(&network[ev.pid].events, ev); // Add event to its node event queue
-                        }
-                    else
-                        panic("Adding cpu event into an undefined task when reading trc");
-                }
-			}
+	else if ((type=coll_type(tok))!=0){ // Collective.
+		if ((tok=strtok_r(NULL, sep, &save))==NULL)
+			panic("Missing task in a collective when reading trc");
+		n1=atol(tok); // nodeId.
+		n2=0; // root
+		if (type==BTR_BCAST){
+			if ((tok=strtok_r(NULL, sep, &save))==NULL)
+				panic("Missing root in a broadcast when reading trc");
+			n2=atol(tok);
 		}
+		length=0; // Size
+		if (type!=BTR_BARRIER){
+			if ((tok=strtok_r(NULL, sep, &save))==NULL)
+				panic("Missing size in a collective when reading trc");
+			length=atol(tok);
+		}
+		if (n1<trace_nodes && n2<trace_nodes && n1>=0 && n2>=0)
+			add_record(p, n1, type, n2, 0, length);
+		else
+			panic("Adding collective event into an undefined task when reading trc");
 	}
-	fclose(ftrc);
 }
 
 /**
@@ -606,61 +1234,169 @@ void read_fsin_trc() {
 * within the collectives should be used.
 */
 void read_alog() {
-	FILE * ftrc;
-	char buffer[512];
+	char *start, *end;
+
+	map_text(&start, &end);
+	read_text(start, end, alog_line, 512);
+}
+
+/**
+* Reads a line of an alog trace.
+*
+* @param buffer The line.
+* @param p The part of the trace being read.
+*/
+static void alog_line(char *buffer, trace_part *p) {
 	char * tok;
-	event ev;
-	long i,n1,n2,inst;
+	char * save;
+	char type;
+	long n1,n2,tag;
 	char sep[]=" \t";
 
-	if((ftrc = fopen(trcfile, "r")) == NULL){
+	if (buffer[0] == '#' || (tok = strtok_r(buffer, sep, &save)) == NULL)
+		return;
+	if (strcmp(tok, "-101")==0 || strcmp(tok, "-102")==0) {
+		if (strcmp(tok, "-101")==0)
+			type='s';
+		else
+			type='r';
+
+		tok=strtok_r(NULL, sep, &save);
+		n1=atol(tok); // Node to add event
+		tok=strtok_r(NULL, sep, &save); // Task: Not in Use
+		tok=strtok_r(NULL, sep, &save);
+		n2=atol(tok); // event's PID: origin when receiving and destiny when sending
+
+		if (n1!=n2) { // Valid event
+			tok=strtok_r(NULL, sep, &save); // Cycle: Not in Use
+			tok=strtok_r(NULL, sep, &save); // Timestamp: Not in Use
+			tok=strtok_r(NULL, sep, &save);
+			tag=atol(tok); // Type of message
+			tok=strtok_r(NULL, sep, &save);
+			if (n1<trace_nodes && n2<trace_nodes && n1>=0 && n2>=0)
+				add_record(p, n1, type, n2, tag, atol(tok)); // Size of message
+			else
+				panic("Adding comm event into an undefined task when reading alog");
+		}
+	}
+}
+
+/**
+* Reads a trace from a binary file.
+*
+* The file whose name is in global variable #trcfile is mapped in memory, and each node
+* gets a feed with the records of the task placed in it. No event is read here: the
+* event queues are filled from the mapped records when they run out of events.
+*
+* @see btrace.h
+* @see fill_events
+*/
+void read_btr() {
+	int fd;
+	struct stat st;
+	btr_header *h;
+
+	if((fd = open(trcfile, O_RDONLY)) < 0 || fstat(fd, &st) < 0){
 		char message[100];
 		sprintf(message, "Trace file not found in current directory - %s",trcfile);
 		panic(message);
 	}
+	if (st.st_size < (off_t)sizeof(btr_header))
+		panic("Binary trace is truncated");
+	btr_size = st.st_size;
+	if ((btr_map = mmap(NULL, btr_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+		panic("Cannot map the binary trace");
+	close(fd);
+
+	h = btr_map;
+	if (strncmp(h->magic, BTR_MAGIC, sizeof(h->magic)) || h->order != BTR_ORDER)
+		panic("Not a binary trace, or written with another byte order");
+	if (h->version < 1 || h->version > BTR_VERSION)
+		panic("Unsupported version of binary trace");
+	if (h->ntasks > trace_nodes)
+		panic("Trace has more nodes than stated in trace_nodes");
+	if (btr_size < sizeof(btr_header) + ((h->ntasks + 1) * sizeof(int64_t)) + (h->nrecords * sizeof(btr_record)))
+		panic("Binary trace is truncated");
+	btr_units = (h->units == BTR_UNITS_OPTION) ? cpu_units : h->units;
+	map_feeds();
+}
 
-	while(fgets(buffer, 512, ftrc) != NULL) {
-		if(buffer[0] != '\n' && buffer[0] != '#') {
-			if(buffer[strlen(buffer) - 1] == '\n')
-				buffer[strlen(buffer) - 1] = '\0';
+/**
+* Gives each node a feed with the records of the task placed in it, taken from the trace
+* mapped in #btr_map.
+*/
+static void map_feeds(void) {
+	btr_header *h = btr_map;
+	int64_t *index = (int64_t *)(h + 1);
+	btr_record *records = (btr_record *)(index + h->ntasks + 1);
+	long t, inst;
+	struct event_feed *f;
+
+	feeds = alloc(sizeof(struct event_feed) * h->ntasks * trace_instances);
+	f = feeds;
+	for (t=0; t<h->ntasks; t++){
+		if (index[t] > index[t+1] || index[t+1] > h->nrecords)
+			panic("Wrong index in binary trace");
+		for (inst=0; inst<trace_instances; inst++, f++){
+			f->next = records + index[t];
+			f->end = records + index[t+1];
+			f->inst = inst;
+			f->step = 0;
+			f->colls = 0;
+			if (f->next < f->end)
+				network[translation[t][inst]].events.feed = f;
+		}
+	}
+}
 
-			tok = strtok( buffer, sep);
-			if (strcmp(tok, "-101")==0 || strcmp(tok, "-102")==0) {
-				if (strcmp(tok, "-101")==0)
-					ev.type=SENDING;
-				else
-					ev.type=RECEPTION;
-
-				tok=strtok(NULL, sep);
-				n1=atol(tok); // Node to add event
-				tok=strtok(NULL, sep); // Task: Not in Use
-				tok=strtok(NULL, sep);
-				n2=atol(tok); // event's PID: origin when receiving and destiny when sending
-
-				if (n1!=n2) { // Valid event
-					tok=strtok(NULL, sep); // Cycle: Not in Use
-					tok=strtok(NULL, sep); // Timestamp: Not in Use
-					tok=strtok(NULL, sep);
-					ev.task=atol(tok); // Type of message
-					tok=strtok(NULL, sep);
-					ev.length=atol(tok); // Length of message
-					ev.count=0; // Packets sent or received
-					if (ev.length == 0)
-						ev.length=1;
-					ev.length = (long)ceil ( (double)ev.length/(pkt_len*phit_len));
-					if (n1<trace_nodes && n2<trace_nodes && n1>=0 && n2>=0)
-						for (inst=0; inst<trace_instances; inst++){
-							i=translation[n1][inst]; // Node to add event
-							ev.pid=translation[n2][inst]; // event's PID: destination when we are sending
-							ins_event(&network[i].events, ev); // Add event to its node event queue
-						}
-					else
-						panic("Adding comm event into an undefined task when reading alog");
-				}
+/**
+* Fills an event queue with the next events of its feed.
+*
+* Up to #trace_lookahead events (a chunk when it is 0) are taken from the mapped trace,
+* converting them as the text trace readers do. The collectives are expanded here, one
+* message at a time, so only the messages in the window are kept in memory.
+*
+* @param q The queue, which must be empty.
+*
+* @see read_btr
+* @see read_text
+*/
+void fill_events(event_q *q) {
+	struct event_feed *f = q->feed;
+	long task = (f - feeds) / trace_instances;
+	long window = (trace_lookahead > 0) ? trace_lookahead : EVENT_CHUNK;
+	event ev;
+	btr_record m, *r;
+	long n = 0;
+	uintptr_t page = sysconf(_SC_PAGESIZE), from, to;
+
+	from = (uintptr_t)f->next & ~(page - 1);
+	while (n < window && f->next < f->end){
+		r = f->next;
+		if (is_coll(r->type)){
+			if (!coll_step(r, task, f->step++, &m)){
+				f->next++;
+				f->step = 0;
+				f->colls++;
+				continue;
 			}
+			m.tag = COLL_TAG - f->colls;
+			r = &m;
+		}
+		else
+			f->next++;
+		if (record_event(task, f->inst, r, btr_units, &ev)){
+			ins_event(q, ev);
+			n++;
 		}
 	}
-	fclose(ftrc);
+	// When streaming, the pages already read are dropped. If another task or instance still needs one, it is
+	// taken again from the file.
+	to = (uintptr_t)f->next & ~(page - 1);
+	if (trace_lookahead > 0 && to > from)
+		madvise((void *)from, to - from, MADV_DONTNEED);
+	if (f->next == f->end)
+		q->feed = NULL;
 }
 
 /**
@@ -935,192 +1671,159 @@ void file_placement() {
 	}
 }
 
+#if (SKIP_CPU_BURSTS==1)
+CLOCK_TYPE skipped_cycles=0, skipped_periods=0;
+CLOCK_TYPE trace_activity=0;	///< Last cycle in which a task changed its current event or a message was received.
+
 /**
-* Places the apps in a list as defined in #appmix_file.
-* The format of this file is:
-* tracefile_name, num_nodes, node_list
-* separated by: <'_'>
+* Places a burst in a position of the heap.
+*
+* @param k The position.
+* @param b The burst.
 */
-void apx_placement(){
-    FILE *fp;
-    char *buffer[NUMNODES*6];
-    char *name;
-    long *nodelist;
-    long n_nodes;
-    char *sep = "_";
-    int id_t=0;
-    int i;
-    if((fp = fopen(mpa_file, "r"))==NULL) {
-        panic("appmix: appmix_file not found!");
-    }
-    while(fgets(buffer,NUMNODES*8, fp)!=NULL){
-        if(buffer[0]!='\n' && buffer[0] != '#'){
-            if(buffer[strlen(buffer)-1] =='\n')
-                buffer[strlen(buffer)-1] = '\0';
-            name = strtok(buffer,sep);
-            n_nodes = atol(strtok(NULL, sep));
-            nodelist = malloc(n_nodes*sizeof(long));
-            for (i = 0; i <n_nodes ; ++i) {
-                nodelist[i] = atol(strtok(NULL, sep));
-            }
-            head = addapp(head, name, n_nodes, nodelist,id_t);
-            id_t++;
-        }
-    }
+static void burst_set(long k, burst_t b){
+	bursts[k] = b;
+	burst_pos[b.node] = k;
 }
+
 /**
- * TODO
- */
-void apx_traces(){
-    FILE *fd;
-    char buffer[512];
-    char *tok;
-    char sep[]=" \t";
-    event ev;
-    appnode actual;
-    actual=head;
-    char *tracefile;
-    long source, dest;
-    long i;
-    int j;
-    while(actual != NULL){
-        if(actual->running==0){
-            if(check_node_disp(actual->node_list, actual->nodes)==1){
-                return;
-            }
-            actual->running=1;
-            tracefile = actual->filename;
-            if((fd = fopen(tracefile, "r")) == NULL) {
-                char message[100];
-                sprintf(message, "Trace file not found in current directory - %s", tracefile);
-                panic(message);
-            }
-            for(j=0;j<actual->nodes;j++){
-                network[actual->node_list[j]].source=OTHER_SOURCE;
-                network[actual->node_list[j]].appid=actual->id;
-            }
-            //load_app
-            while(fgets(buffer, 512, fd) != NULL) {
-                if(buffer[0] != '\n' && buffer[0] != '#') {
-                    if(buffer[strlen(buffer) - 1] == '\n')
-                        buffer[strlen(buffer) - 1] = '\0';
-
-                    tok = strtok( buffer, sep);
-
-                    if (strcmp(tok, "s")==0 || strcmp(tok, "r")==0) { // Communication.
-                        if (strcmp(tok, "s")==0){
-                            ev.type=SENDING;
-                            ev.app_id=actual->id;
-                            tok=strtok(NULL, sep); // from
-                            source=atol(tok); // Sendet (Node to add event)
-                            tok=strtok(NULL, sep);
-                            dest=atol(tok); // event's PID: destination when we are sending
-                        }
-                        else{ // if (strcmp(tok, "r")==0)
-                            ev.type=RECEPTION;
-                            tok=strtok(NULL, sep); // from
-                            dest=atol(tok); // event's PID: origin of the message
-                            tok=strtok(NULL, sep);
-                            source=atol(tok); // Destination of the message (local node)
-                        }
-                        if (source!=dest) {
-                            // Valid event
-                            tok=strtok(NULL, sep);
-                            ev.task=atol(tok); // Type of message (tag)
-                            tok=strtok(NULL, sep);
-                            ev.length=atol(tok); // Length of message
-                            ev.count=0; // Packets sent or received
-                            if (ev.length == 0)
-                                ev.length=1;
-                            ev.length = (long)ceil ( (double)ev.length/(pkt_len*phit_len));
-                            i = actual->node_list[source]; //Node to add event
-                            ev.pid = actual->node_list[dest]; //Destination node
-                            actual->ini_clock = sim_clock;
-                            ins_event(&network[i].events, ev);
-                            network[i].appid = actual->id;
-                        }
-                    }
-                    else if (strcmp(tok, "c")==0){ // Computation.
-                        ev.type=COMPUTATION;
-                        tok=strtok(NULL, sep);
-                        source=atol(tok); // nodeId.
-                        tok=strtok(NULL, sep);
-                        switch (cpu_units){
-                            case UNIT_CYCLES:
-                                ev.length=((CLOCK_TYPE)atol(tok));
-                                break;
-                            case UNIT_MILLISECONDS:
-                                ev.length=(CLOCK_TYPE)(((atol(tok))*1000*link_bw)/(8*phit_len));
-                                break;
-                            case UNIT_MICROSECONDS:
-                                ev.length=(CLOCK_TYPE)(((atol(tok))*link_bw)/(8*phit_len));
-                                break;
-                            case UNIT_NANOSECONDS:
-                                ev.length=(CLOCK_TYPE)(((atol(tok))*link_bw)/(8000*phit_len));
-                                break;
-                            default:
-                                panic("Unsupported CPU units");
-
-                        }
-                        if (ev.length>0){
-                            ev.count=0; // Elapsed time.
-                            ev.pid = actual->node_list[source];
-                            ins_event(&network[ev.pid].events,ev);
-                            network[ev.pid].source=OTHER_SOURCE;
-                            network[ev.pid].appid=actual->id;
-                        }
-                    }
-                }
-            }
-            fclose(fd);
-        }
-        actual=actual->next;
-    }
+* Moves a burst towards the top of the heap until it is in order.
+*
+* @param k The position of the burst.
+*/
+static void burst_up(long k){
+	burst_t b = bursts[k];
 
+	while (k>0 && bursts[(k-1)/2].end > b.end){
+		burst_set(k, bursts[(k-1)/2]);
+		k = (k-1)/2;
+	}
+	burst_set(k, b);
 }
 
-#if (SKIP_CPU_BURSTS==1)
-CLOCK_TYPE skipped_cycles=0, skipped_periods=0;
+/**
+* Moves a burst towards the bottom of the heap until it is in order.
+*
+* @param k The position of the burst.
+*/
+static void burst_down(long k){
+	burst_t b = bursts[k];
+	long c;
+
+	while ((c = 2*k+1) < nbursts){
+		if (c+1 < nbursts && bursts[c+1].end < bursts[c].end)
+			c++;
+		if (bursts[c].end >= b.end)
+			break;
+		burst_set(k, bursts[c]);
+		k = c;
+	}
+	burst_set(k, b);
+}
 
 /**
-* Looks for the next CPU to finish and skips as many cycles as necessary (if network load is 0). Should speed up the execution of CPU-biased applications)
+* Removes the first burst of the heap.
 */
-void skip_if_cpu_activity_only(){
-    long i;
-    CLOCK_TYPE res=CLOCK_MAX;
-    event e;
+static void burst_pop(){
+	burst_pos[bursts[0].node] = -1;
+	if (--nbursts > 0){
+		burst_set(0, bursts[nbursts]);
+		burst_down(0);
+	}
+}
 
-    if (injected_count - rcvd_count != 0){ // there is traffic going through the network
-        return ;
-    }
+/**
+* Allocates the heap of CPU bursts, empty.
+*/
+static void burst_init(void){
+	long k;
 
-    for (i=0; i<nprocs; i++) {
-        if (network[i].source!=INDEPENDENT_SOURCE && !event_empty(&network[i].events)){
-            e=head_event(&network[i].events);
-            if (e.type==COMPUTATION){
-                if (e.length-e.count<res)
-                    res=e.length-e.count;
-            } else if (e.type==SENDING){
-                return ;
-			}
-		}
-    }
+	bursts = alloc(sizeof(burst_t) * nprocs);
+	burst_pos = alloc(sizeof(long) * nprocs);
+	for (k=0; k<nprocs; k++)
+		burst_pos[k] = -1;
+}
 
-    if (res!=CLOCK_MAX){
-		printf("%11"PRINT_CLOCK":: Skipped %"PRINT_CLOCK" cycles due to CPU-only activity\n",sim_clock,res);
-		skipped_cycles+=res;
-		skipped_periods++;
-
-        sim_clock+=res; // current cycles hasn't been counted yet.
-        for (i=0; i<nprocs; i++) {
-            if (network[i].source!=INDEPENDENT_SOURCE && !event_empty(&network[i].events)){
-                e=head_event(&network[i].events);
-                if (e.type==COMPUTATION){
-                    do_event_n_times (&network[i].events, &e, res);
-				}
-            }
-       }
-    }
+/**
+* Registers the start of a CPU burst, so that the clock can be skipped up to its end.
+*
+* Called when a task does the first cycle of a COMPUTATION event. A node has one burst
+* at most, so the new one replaces any previous.
+*
+* @param node The node running the burst.
+* @param end The cycle in which the burst will do its last computation.
+*/
+void cpu_burst_started(long node, CLOCK_TYPE end){
+	long k;
+
+	if (bursts == NULL)
+		burst_init();
+	if ((k = burst_pos[node]) < 0){
+		k = nbursts++;
+		bursts[k].node = node;
+		bursts[k].end = end;
+		burst_up(k);
+	}
+	else if (end < bursts[k].end){
+		bursts[k].end = end;
+		burst_up(k);
+	}
+	else {
+		bursts[k].end = end;
+		burst_down(k);
+	}
+}
+
+/**
+* Skips the cycles in which all the activity is computation.
+*
+* The clock jumps to the end of the first CPU burst to finish whenever there are no packets
+* in the network nor in the injection queues, there is no background traffic, and no task has
+* changed its current event in the last cycles (which would start a burst not yet registered,
+* or make a task send). The bursts are kept in a min-heap by their end cycle, so there is no
+* need to look at all the tasks every cycle. Bursts already finished are removed lazily.
+*/
+void skip_if_cpu_activity_only(){
+	long i, k, n;
+	CLOCK_TYPE res, end;
+	event e;
+
+	if (nbursts==0 || trace_activity >= sim_clock-1 || aload>0 || global_q_u > congestion_limit || pkts_in_use()>0)
+		return;
+
+	while (nbursts>0){
+		n = bursts[0].node;
+		if (event_empty(&network[n].events) || (e=head_event(&network[n].events)).type!=COMPUTATION)
+			burst_pop();
+		else if ((end = sim_clock + e.length - e.count - 1) != bursts[0].end){
+			bursts[0].end = end; // has been delayed.
+			burst_down(0);
+		}
+		else
+			break;
+	}
+	if (nbursts==0 || (res = bursts[0].end - sim_clock) <= 0)
+		return;
+
+	printf("%11"PRINT_CLOCK":: Skipped %"PRINT_CLOCK" cycles due to CPU-only activity\n",sim_clock,res);
+	skipped_cycles+=res;
+	skipped_periods++;
+
+	k = 0;
+	for (i=0; i<nbursts; i++){
+		n = bursts[i].node;
+		if (!event_empty(&network[n].events) && (e=head_event(&network[n].events)).type==COMPUTATION){
+			bursts[i].end = sim_clock + e.length - e.count - 1;
+			do_event_n_times(&network[n].events, &e, res);
+			burst_set(k++, bursts[i]);
+		}
+		else
+			burst_pos[n] = -1;
+	}
+	nbursts = k;
+	for (i=nbursts/2-1; i>=0; i--)
+		burst_down(i);
+	sim_clock+=res; // current cycles hasn't been counted yet.
 }
 #endif //SKIP_CPU_BURSTS
 
@@ -1189,6 +1892,11 @@ void run_network_trc() {
 	long i;
 
 	read_trace();
+#if (PROFILE != 0)
+	profile_trace_read();
+#endif
+	if (restore_file[0] != '\0')
+		restore_checkpoint();
 
 	do {
 #if (CHECK_TRC_DEADLOCK>0)
@@ -1204,10 +1912,6 @@ void run_network_trc() {
 		skip_if_cpu_activity_only();
 #endif /* SKIP_CPU_BURSTS */
 		data_movement(B_TRUE);
-        /*
-         * AQUI CHECK DE TODAS LAS APPS poner INDEPENDENT_SOURCE en todas los nodos liberados
-         * Luego llamar a print partials
-         */
 		sim_clock++;
 
 		if ((pheaders > 0) && (sim_clock % pinterval == 0)) {
@@ -1225,11 +1929,71 @@ void run_network_trc() {
 				break;
 			}
 		}
+		if (pattern==MPA && !go_on)
+			go_on=mpa_pending(); // The last nodes of an app have not been seen finishing yet.
+		if (go_on)
+			checkpoint_cycle();
 	} while (go_on && !interrupted  && !aborted);
     if(pattern!=MPA)
 	    print_partials();
 	save_batch_results();
 	reset_stats();
 }
+
+/**
+* Writes the state of the trace in a checkpoint, or reads it: the events of each node, the
+* position of the feeds in the trace and the CPU bursts. The trace has to be read before.
+*
+* @param f The checkpoint.
+* @param save TRUE to write the state, FALSE to read it.
+*/
+void trace_checkpoint(FILE *f, bool_t save) {
+	long n = (btr_map != NULL) ? ((btr_header *)btr_map)->ntasks * trace_instances : 0;
+	long i, k = n;
+	struct event_feed *fd;
+
+	ckp_var(f, k, save);
+	if (k != n)
+		panic("Checkpoint taken with another trace");
+	for (fd = feeds; fd < feeds + n; fd++){
+		k = fd->end - fd->next;
+		ckp_var(f, k, save);
+		ckp_var(f, fd->step, save);
+		ckp_var(f, fd->colls, save);
+		if (k < 0)
+			panic("Wrong trace position in checkpoint");
+		fd->next = fd->end - k;
+	}
+	for (i=0; i<nprocs; i++){
+		events_checkpoint(f, &network[i].events, save);
+		occur_checkpoint(f, &network[i].occurs, save);
+		k = (network[i].events.feed != NULL) ? network[i].events.feed - feeds : -1;
+		ckp_var(f, k, save);
+		if (k < -1 || k >= n)
+			panic("Wrong trace position in checkpoint");
+		network[i].events.feed = (k < 0) ? NULL : feeds + k;
+	}
+#if (CHECK_TRC_DEADLOCK>0)
+	ckp_var(f, deadlocked_period, save);
+#endif
+#if (SKIP_CPU_BURSTS==1)
+	ckp_var(f, skipped_cycles, save);
+	ckp_var(f, skipped_periods, save);
+	ckp_var(f, trace_activity, save);
+	k = (bursts != NULL);
+	ckp_var(f, k, save);
+	if (k){
+		if (bursts == NULL)
+			burst_init();
+		ckp_var(f, nbursts, save);
+		if (nbursts < 0 || nbursts > nprocs)
+			panic("Wrong CPU bursts in checkpoint");
+		ckp_data(f, bursts, sizeof(burst_t) * nbursts, save);
+		ckp_data(f, burst_pos, sizeof(long) * nprocs, save);
+	}
+#endif
+	if (pattern==MPA)
+		mpa_checkpoint(f, save);
+}
 #endif
 